@@ -69,6 +69,7 @@
 #endif
 
 #include "libavutil/bprint.h"
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/mem.h"
 #include "libavutil/time.h"
@@ -310,7 +311,11 @@ static void ffmpeg_cleanup(int ret)
 {
     if (do_benchmark) {
         int64_t maxrss = getmaxrss() / 1024;
+        int64_t pool_peak;
         av_log(NULL, AV_LOG_INFO, "bench: maxrss=%"PRId64"KiB\n", maxrss);
+        av_buffer_pool_get_memory(NULL, NULL, &pool_peak);
+        av_log(NULL, AV_LOG_INFO, "bench: buffer_pool_peak=%"PRId64"KiB\n",
+               pool_peak / 1024);
     }
 
     for (int i = 0; i < nb_filtergraphs; i++)
@@ -339,6 +344,7 @@ static void ffmpeg_cleanup(int ret)
     hw_device_free_all();
 
     av_freep(&filter_nbthreads);
+    av_freep(&filter_buffer_pool_flags);
 
     av_freep(&input_files);
     av_freep(&output_files);
@@ -669,6 +675,20 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         av_bprintf(&buf_script, "speed=%4.3gx\n", speed);
     }
 
+    if (latency_stats) {
+        int64_t p50, p99;
+
+        // report the first stream that has any, like the frame counts above
+        for (OutputStream *ost = ost_iter(NULL); ost; ost = ost_iter(ost)) {
+            if (of_stream_latency(ost, &p50, &p99) < 0)
+                continue;
+            av_bprintf(&buf, " latency=%.1f/%.1fms", p50 / 1e3, p99 / 1e3);
+            av_bprintf(&buf_script, "latency_p50_ms=%.3f\n", p50 / 1e3);
+            av_bprintf(&buf_script, "latency_p99_ms=%.3f\n", p99 / 1e3);
+            break;
+        }
+    }
+
     if (print_stats || is_last_report) {
         const char end = is_last_report ? '\n' : '\r';
         if (print_stats==1 && AV_LOG_INFO > av_log_get_level()) {
@@ -703,6 +703,7 @@ extern int copy_ts;
 extern int start_at_zero;
 extern int copy_tb;
 extern int debug_ts;
+extern int latency_stats;
 extern int exit_on_error;
 extern int abort_on_flags;
 extern int print_stats;
@@ -713,6 +714,7 @@ extern float max_error_rate;
 
 extern char *filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern char *filter_buffer_pool_flags;
 extern int vstats_version;
 extern int auto_conversion_filters;
 
@@ -864,6 +866,14 @@ void of_enc_stats_close(void);
 
 int64_t of_filesize(OutputFile *of);
 
+/**
+ * Get the median and 99th percentile of the time between demuxing and
+ * muxing of the packets of an output stream, in microseconds.
+ *
+ * @return 0 on success, a negative error code if no latency was recorded
+ */
+int of_stream_latency(OutputStream *ost, int64_t *p50, int64_t *p99);
+
 int ifile_open(const OptionsContext *o, const char *filename, Scheduler *sch);
 void ifile_close(InputFile **f);
 
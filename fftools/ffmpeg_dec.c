@@ -925,6 +925,12 @@ static int decoder_thread(void *arg)
         int flush_buffers, have_data;
 
         input_status  = sch_dec_receive(dp->sch, dp->sch_idx, dt.pkt);
+        if (input_status < 0 && input_status != AVERROR_EOF) {
+            av_log(dp, AV_LOG_ERROR, "Error receiving a packet for decoding: %s\n",
+                   av_err2str(input_status));
+            ret = input_status;
+            goto finish;
+        }
         have_data     = input_status >= 0 &&
             (dt.pkt->buf || dt.pkt->side_data_elems ||
              (intptr_t)dt.pkt->opaque == PKT_OPAQUE_SUB_HEARTBEAT ||
@@ -885,7 +885,7 @@ int encoder_thread(void *arg)
                 ret = AVERROR(EINVAL);
             } else {
                 av_log(e, AV_LOG_ERROR, "Error receiving a frame for encoding: %s\n",
-                       av_err2str(ret));
+                       av_err2str(input_status));
                 ret = input_status;
             }
             goto finish;
@@ -1890,6 +1890,34 @@ static int graph_is_meta(AVFilterGraph *graph)
 
 static int sub2video_frame(InputFilter *ifilter, AVFrame *frame, int buffer);
 
+typedef struct FilterPoolJobs {
+    AVFilterContext      *ctx;
+    avfilter_action_func *func;
+    void                 *arg;
+    int                  *ret;
+} FilterPoolJobs;
+
+static void filter_pool_job(void *arg, int jobnr, int nb_jobs)
+{
+    FilterPoolJobs *jobs = arg;
+    int ret = jobs->func(jobs->ctx, jobs->arg, jobnr, nb_jobs);
+    if (jobs->ret)
+        jobs->ret[jobnr] = ret;
+}
+
+static int filter_pool_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                               void *arg, int *ret, int nb_jobs)
+{
+    FilterPoolJobs jobs = {
+        .ctx  = ctx,
+        .func = func,
+        .arg  = arg,
+        .ret  = ret,
+    };
+
+    return sch_pool_execute(ctx->graph->opaque, filter_pool_job, &jobs, nb_jobs);
+}
+
 static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
 {
     FilterGraphPriv *fgp = fgp_from_fg(fg);
@@ -1937,6 +1965,19 @@ static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
         fgt->graph->nb_threads = filter_complex_nbthreads;
     }
 
+    if (filter_buffer_pool_flags) {
+        ret = av_opt_set(fgt->graph, "buffer_pool_flags", filter_buffer_pool_flags, 0);
+        if (ret < 0)
+            goto fail;
+    }
+
+    if (sch_pool_threads(fgp->sch)) {
+        fgt->graph->execute = filter_pool_execute;
+        fgt->graph->opaque  = fgp->sch;
+        if (!fgt->graph->nb_threads)
+            fgt->graph->nb_threads = sch_pool_threads(fgp->sch);
+    }
+
     hw_device = hw_device_for_filter();
 
     ret = graph_parse(fg, fgt->graph, graph_desc, &inputs, &outputs, hw_device);
@@ -3004,8 +3045,12 @@ static int filter_thread(void *arg)
             // should only happen when we didn't request any input
             av_assert0(input_idx == fg->nb_inputs);
             goto read_frames;
+        } else if (input_status < 0) {
+            av_log(fg, AV_LOG_ERROR, "Error receiving a frame for filtering: %s\n",
+                   av_err2str(input_status));
+            ret = input_status;
+            goto finish;
         }
-        av_assert0(input_status >= 0);
 
         o = (intptr_t)fgt.frame->opaque;
 
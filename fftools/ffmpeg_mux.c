@@ -16,6 +16,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <math.h>
 #include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
@@ -26,6 +27,7 @@
 #include "sync_queue.h"
 
 #include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
 #include "libavutil/fifo.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/log.h"
@@ -61,19 +63,20 @@ static int64_t filesize(AVIOContext *pb)
     return ret;
 }
 
+static const char *const latency_desc[] = {
+    [LATENCY_PROBE_DEMUX]       = "demux",
+    [LATENCY_PROBE_DEC_PRE]     = "decode",
+    [LATENCY_PROBE_DEC_POST]    = "decode",
+    [LATENCY_PROBE_FILTER_PRE]  = "filter",
+    [LATENCY_PROBE_FILTER_POST] = "filter",
+    [LATENCY_PROBE_ENC_PRE]     = "encode",
+    [LATENCY_PROBE_ENC_POST]    = "encode",
+    [LATENCY_PROBE_NB]          = "mux",
+};
+
 static void mux_log_debug_ts(OutputStream *ost, const AVPacket *pkt)
 {
-    static const char *desc[] = {
-        [LATENCY_PROBE_DEMUX]       = "demux",
-        [LATENCY_PROBE_DEC_PRE]     = "decode",
-        [LATENCY_PROBE_DEC_POST]    = "decode",
-        [LATENCY_PROBE_FILTER_PRE]  = "filter",
-        [LATENCY_PROBE_FILTER_POST] = "filter",
-        [LATENCY_PROBE_ENC_PRE]     = "encode",
-        [LATENCY_PROBE_ENC_POST]    = "encode",
-        [LATENCY_PROBE_NB]          = "mux",
-    };
-
+    const char *const *desc = latency_desc;
     char latency[512];
 
     *latency = 0;
@@ -135,6 +138,128 @@ static void mux_log_debug_ts(OutputStream *ost, const AVPacket *pkt)
            pkt->size, *latency ? latency : "N/A");
 }
 
+static unsigned latency_bucket(int64_t us)
+{
+    int e;
+
+    if (us < 16)
+        return FFMAX(us, 0);
+
+    e = (us >> 32) ? 32 + av_log2(us >> 32) : av_log2(us);
+    return FFMIN(16 + (e - 4) * 8 + ((us >> (e - 3)) & 7), LATENCY_HIST_SIZE - 1);
+}
+
+// middle of the range of values falling into a bucket
+static int64_t latency_bucket_value(unsigned idx)
+{
+    int e;
+
+    if (idx < 16)
+        return idx;
+
+    e = (idx - 16) / 8 + 4;
+    return ((int64_t)(8 + (idx - 16) % 8) << (e - 3)) + (1LL << (e - 4));
+}
+
+static void latency_hist_add(LatencyHist *h, int64_t us)
+{
+    atomic_fetch_add_explicit(&h->count[latency_bucket(us)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->nb_samples, 1, memory_order_relaxed);
+}
+
+static int64_t latency_hist_percentile(LatencyHist *h, double p)
+{
+    uint64_t nb_samples = atomic_load_explicit(&h->nb_samples, memory_order_relaxed);
+    uint64_t target     = FFMAX(ceil(nb_samples * p), 1);
+    uint64_t sum        = 0;
+
+    for (unsigned i = 0; i < LATENCY_HIST_SIZE; i++) {
+        sum += atomic_load_explicit(&h->count[i], memory_order_relaxed);
+        if (sum >= target)
+            return latency_bucket_value(i);
+    }
+    return latency_bucket_value(LATENCY_HIST_SIZE - 1);
+}
+
+static void mux_latency_record(LatencyStats *ls, const AVPacket *pkt)
+{
+    const FrameData *fd;
+    int64_t now;
+    int first = -1, prev = -1;
+
+    if (!pkt->opaque_ref)
+        return;
+    fd  = (const FrameData*)pkt->opaque_ref->data;
+    now = av_gettime_relative();
+
+    for (int i = 0; i <= LATENCY_PROBE_NB; i++) {
+        int64_t val = i < LATENCY_PROBE_NB ? fd->wallclock[i] : now;
+
+        if (val == INT64_MIN)
+            continue;
+
+        if (prev >= 0) {
+            latency_hist_add(&ls->stage[prev], val - fd->wallclock[prev]);
+            atomic_store_explicit(&ls->stage_end[prev], i, memory_order_relaxed);
+        } else if (i < LATENCY_PROBE_NB)
+            first = i;
+        prev = i;
+    }
+
+    if (first >= 0)
+        latency_hist_add(&ls->stage[LATENCY_PROBE_NB], now - fd->wallclock[first]);
+}
+
+int of_stream_latency(OutputStream *ost, int64_t *p50, int64_t *p99)
+{
+    MuxStream *ms = ms_from_ost(ost);
+    LatencyHist *total;
+
+    if (!ms->latency)
+        return AVERROR(EINVAL);
+
+    total = &ms->latency->stage[LATENCY_PROBE_NB];
+    if (!atomic_load_explicit(&total->nb_samples, memory_order_relaxed))
+        return AVERROR(EAGAIN);
+
+    *p50 = latency_hist_percentile(total, 0.5);
+    *p99 = latency_hist_percentile(total, 0.99);
+    return 0;
+}
+
+static void mux_latency_report(Muxer *mux, OutputStream *ost)
+{
+    LatencyStats *ls = ms_from_ost(ost)->latency;
+    AVBPrint bp;
+
+    if (!atomic_load(&ls->stage[LATENCY_PROBE_NB].nb_samples))
+        return;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_AUTOMATIC);
+    av_bprintf(&bp, "total %g/%gms",
+               latency_hist_percentile(&ls->stage[LATENCY_PROBE_NB], 0.5)  / 1e3,
+               latency_hist_percentile(&ls->stage[LATENCY_PROBE_NB], 0.99) / 1e3);
+
+    for (int i = 0; i < LATENCY_PROBE_NB; i++) {
+        int end = atomic_load(&ls->stage_end[i]);
+
+        if (!end)
+            continue;
+
+        if (!strcmp(latency_desc[i], latency_desc[end]))
+            av_bprintf(&bp, ", %s ", latency_desc[i]);
+        else
+            av_bprintf(&bp, ", %s-%s ", latency_desc[i], latency_desc[end]);
+        av_bprintf(&bp, "%g/%gms",
+                   latency_hist_percentile(&ls->stage[i], 0.5)  / 1e3,
+                   latency_hist_percentile(&ls->stage[i], 0.99) / 1e3);
+    }
+
+    av_log(mux, AV_LOG_INFO, "Output stream #%d:%d latency p50/p99: %s\n",
+           mux->of.index, ost->index, bp.str);
+    av_bprint_finalize(&bp, NULL);
+}
+
 static int mux_fixup_ts(Muxer *mux, MuxStream *ms, AVPacket *pkt)
 {
     OutputStream *ost = &ms->ost;
@@ -202,6 +327,8 @@ static int mux_fixup_ts(Muxer *mux, MuxStream *ms, AVPacket *pkt)
 
     if (debug_ts)
         mux_log_debug_ts(ost, pkt);
+    if (ms->latency)
+        mux_latency_record(ms->latency, pkt);
 
     return 0;
 }
@@ -429,6 +556,10 @@ int muxer_thread(void *arg)
             av_log(mux, AV_LOG_VERBOSE, "All streams finished\n");
             ret = 0;
             break;
+        } else if (ret < 0 && ret != AVERROR_EOF) {
+            av_log(mux, AV_LOG_ERROR, "Error receiving a packet for muxing: %s\n",
+                   av_err2str(ret));
+            break;
         }
 
         ost = of->streams[mux->sch_stream_idx[stream_idx]];
@@ -743,6 +874,11 @@ static void mux_final_stats(Muxer *mux)
                  100.0 * (file_size - total_size) / total_size);
     }
 
+    for (int j = 0; j < of->nb_streams; j++) {
+        if (ms_from_ost(of->streams[j])->latency)
+            mux_latency_report(mux, of->streams[j]);
+    }
+
     av_log(of, AV_LOG_INFO,
            "video:%1.0fKiB audio:%1.0fKiB subtitle:%1.0fKiB other streams:%1.0fKiB "
            "global headers:%1.0fKiB muxing overhead: %s\n",
@@ -824,6 +960,7 @@ static void ost_free(OutputStream **post)
     }
 
     avcodec_parameters_free(&ms->par_in);
+    av_freep(&ms->latency);
 
     av_bsf_free(&ms->bsf_ctx);
     av_packet_free(&ms->bsf_pkt);
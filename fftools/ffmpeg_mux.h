@@ -33,6 +33,32 @@
 #include "libavutil/dict.h"
 #include "libavutil/fifo.h"
 
+/**
+ * Number of buckets in a latency histogram: one per microsecond below 16us,
+ * then 8 per power of two.
+ */
+#define LATENCY_HIST_SIZE (16 + 8 * 40)
+
+typedef struct LatencyHist {
+    atomic_uint_least64_t count[LATENCY_HIST_SIZE];
+    atomic_uint_least64_t nb_samples;
+} LatencyHist;
+
+/**
+ * Latency of the packets of one output stream, written by the muxer thread
+ * and read by the main thread for progress reports.
+ */
+typedef struct LatencyStats {
+    /**
+     * Time from each latency probe to the next one the packets went through,
+     * indexed by the first probe. The last entry holds the time from the
+     * first probe to muxing.
+     */
+    LatencyHist         stage[LATENCY_PROBE_NB + 1];
+    // probe that ends each stage, LATENCY_PROBE_NB for muxing, 0 if unseen
+    atomic_int          stage_end[LATENCY_PROBE_NB];
+} LatencyStats;
+
 typedef struct MuxStream {
     OutputStream    ost;
 
@@ -90,6 +116,9 @@ typedef struct MuxStream {
     int             force_fps;
 
     const char     *apad;
+
+    // only allocated with -latency_stats
+    LatencyStats   *latency;
 } MuxStream;
 
 typedef struct Muxer {
@@ -407,6 +407,12 @@ static MuxStream *mux_stream_alloc(Muxer *mux, enum AVMediaType type)
     ms->sch_idx     = -1;
     ms->sch_idx_enc = -1;
 
+    if (latency_stats) {
+        ms->latency = av_mallocz(sizeof(*ms->latency));
+        if (!ms->latency)
+            return NULL;
+    }
+
     snprintf(ms->log_name, sizeof(ms->log_name), "%cost#%d:%d",
              type_str ? *type_str : '?', mux->of.index, ms->ost.index);
 
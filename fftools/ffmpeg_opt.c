@@ -68,6 +68,7 @@ int copy_ts           = 0;
 int start_at_zero     = 0;
 int copy_tb           = -1;
 int debug_ts          = 0;
+int latency_stats     = 0;
 int exit_on_error     = 0;
 int abort_on_flags    = 0;
 int print_stats       = -1;
@@ -75,6 +76,7 @@ int stdin_interaction = 1;
 float max_error_rate  = 2.0/3;
 char *filter_nbthreads;
 int filter_complex_nbthreads = 0;
+char *filter_buffer_pool_flags;
 int vstats_version = 2;
 int auto_conversion_filters = 1;
 int64_t stats_period = 500000;
@@ -423,6 +425,13 @@ static int opt_filter_threads(void *optctx, const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_filter_buffer_pool_flags(void *optctx, const char *opt, const char *arg)
+{
+    av_free(filter_buffer_pool_flags);
+    filter_buffer_pool_flags = av_strdup(arg);
+    return filter_buffer_pool_flags ? 0 : AVERROR(ENOMEM);
+}
+
 static int opt_abort_on(void *optctx, const char *opt, const char *arg)
 {
     static const AVOption opts[] = {
@@ -624,6 +633,41 @@ static int opt_sdp_file(void *optctx, const char *opt, const char *arg)
     return sch_sdp_filename(go->sch, arg);
 }
 
+static int opt_pool_threads(void *optctx, const char *opt, const char *arg)
+{
+    GlobalOptionsContext *go = optctx;
+    double nb_threads;
+    int ret;
+
+    ret = parse_number(opt, arg, OPT_TYPE_INT, 0, INT_MAX, &nb_threads);
+    if (ret < 0)
+        return ret;
+
+    return sch_pool_init(go->sch, nb_threads);
+}
+
+static int opt_low_latency(void *optctx, const char *opt, const char *arg)
+{
+    GlobalOptionsContext *go = optctx;
+
+    sch_set_low_latency(go->sch, 1);
+    return 0;
+}
+
+static int opt_max_memory(void *optctx, const char *opt, const char *arg)
+{
+    GlobalOptionsContext *go = optctx;
+    double max_memory;
+    int ret;
+
+    ret = parse_number(opt, arg, OPT_TYPE_INT64, 0, INT64_MAX, &max_memory);
+    if (ret < 0)
+        return ret;
+
+    sch_set_max_memory(go->sch, max_memory);
+    return 0;
+}
+
 #if CONFIG_VAAPI
 static int opt_vaapi_device(void *optctx, const char *opt, const char *arg)
 {
@@ -1723,6 +1767,12 @@ const OptionDef options[] = {
     { "filter_complex_threads", OPT_TYPE_INT, OPT_EXPERT,
         { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "filter_buffer_pool_flags", OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_filter_buffer_pool_flags },
+        "set the frame buffer allocation policy of all filtergraphs", "flags" },
+    { "pool_threads",           OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_pool_threads },
+        "run slice-threaded filtering on a single pool of threads shared by all filtergraphs", "nb_threads" },
     { "lavfi",               OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
@@ -1751,6 +1801,15 @@ const OptionDef options[] = {
     { "debug_ts",            OPT_TYPE_BOOL, OPT_EXPERT,
         { &debug_ts },
         "print timestamp debugging info" },
+    { "latency_stats",       OPT_TYPE_BOOL, OPT_EXPERT,
+        { &latency_stats },
+        "print percentiles of the time spent by packets in each processing stage" },
+    { "low_latency",         OPT_TYPE_FUNC, OPT_EXPERT,
+        { .func_arg = opt_low_latency },
+        "pass every packet and frame on as soon as possible, with a single slot per queue" },
+    { "max_memory",          OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_max_memory },
+        "hold back the inputs while the frame buffers in use exceed this many bytes", "size" },
     { "max_error_rate",      OPT_TYPE_FLOAT, OPT_EXPERT,
         { &max_error_rate },
         "ratio of decoding errors (0.0: no errors, 1.0: 100% errors) above which ffmpeg returns an error instead of success.", "maximum error rate" },
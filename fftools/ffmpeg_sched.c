@@ -32,7 +32,10 @@
 #include "libavcodec/packet.h"
 
 #include "libavutil/avassert.h"
+#include "libavutil/buffer.h"
+#include "libavutil/cpu.h"
 #include "libavutil/error.h"
+#include "libavutil/executor.h"
 #include "libavutil/fifo.h"
 #include "libavutil/frame.h"
 #include "libavutil/mem.h"
@@ -44,6 +47,12 @@
 // FIXME: some other value? make this dynamic?
 #define SCHEDULE_TOLERANCE (100 * 1000)
 
+#define SCH_POOL_MAX_THREADS 256
+
+// how long a source over the memory limit waits with the whole pipeline idle
+// before concluding that the pipeline needs more input
+#define MEM_STALL_TIMEOUT (100 * 1000)
+
 enum QueueType {
     QUEUE_PACKETS,
     QUEUE_FRAMES,
@@ -75,6 +84,13 @@ typedef struct SchDecOutput {
     SchedulerNode      *dst;
     uint8_t            *dst_finished;
     unsigned         nb_dst;
+
+    // temporary storage used by sch_dec_send() for sharing a frame between
+    // filtergraph inputs, nb_dst entries each
+    ThreadQueue       **shared_tq;
+    unsigned           *shared_stream;
+    unsigned           *shared_dst;
+    int                *shared_ret;
 } SchDecOutput;
 
 typedef struct SchDec {
@@ -311,8 +327,51 @@ struct Scheduler {
     pthread_mutex_t     schedule_lock;
 
     atomic_int_least64_t last_dts;
+
+    // worker pool shared by all the components, see sch_pool_init()
+    AVExecutor         *pool;
+    int                 pool_threads;
+
+    // use single-entry thread queues, see sch_set_low_latency()
+    int                 low_latency;
+
+    // limit on the size of the pooled buffers in use, see sch_set_max_memory()
+    int64_t             max_memory;
+    // the limit actually enforced, raised above max_memory when the pipeline
+    // cannot make progress within it, and lowered back to it once the buffers
+    // in use fit within max_memory again
+    atomic_int_least64_t mem_limit;
+    // incremented whenever a packet or frame is taken off a queue
+    atomic_uint         mem_progress;
+    atomic_int          nb_mem_waiting;
+    // number of running tasks, and of those blocked in waiter_wait()
+    atomic_int          nb_tasks_running;
+    atomic_int          nb_tasks_choked;
+    pthread_mutex_t     mem_lock;
+    pthread_cond_t      mem_cond;
 };
 
+/**
+ * A single sch_pool_execute() call. Lives on the caller's stack, so the caller
+ * must wait for all the tasks it submitted to finish running before returning.
+ */
+typedef struct SchPoolExec {
+    SchPoolFunc         func;
+    void               *arg;
+    int                 nb_jobs;
+    atomic_int          next_job;
+
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    // number of submitted tasks that did not finish running yet
+    int                 tasks_pending;
+} SchPoolExec;
+
+typedef struct SchPoolTask {
+    AVTask              t;
+    SchPoolExec        *exec;
+} SchPoolTask;
+
 /**
  * Wait until this task is allowed to proceed.
  *
@@ -327,10 +386,13 @@ static int waiter_wait(Scheduler *sch, SchWaiter *w)
         return 0;
 
     pthread_mutex_lock(&w->lock);
+    atomic_fetch_add(&sch->nb_tasks_choked, 1);
 
     while (atomic_load(&w->choked) && !atomic_load(&sch->terminate))
         pthread_cond_wait(&w->cond, &w->lock);
 
+    atomic_fetch_sub(&sch->nb_tasks_choked, 1);
+
     terminate = atomic_load(&sch->terminate);
 
     pthread_mutex_unlock(&w->lock);
@@ -388,9 +450,9 @@ static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_si
         // This queue length is used in the decoder code to ensure that
         // there are enough entries in fixed-size frame pools to account
         // for frames held in queues inside the ffmpeg utility.  If this
-        // can ever dynamically change then the corresponding decode
-        // code needs to be updated as well.
-        av_assert0(queue_size == DEFAULT_FRAME_THREAD_QUEUE_SIZE);
+        // can ever grow beyond it then the corresponding decode code
+        // needs to be updated as well.
+        av_assert0(queue_size <= DEFAULT_FRAME_THREAD_QUEUE_SIZE);
     }
 
     op = (type == QUEUE_PACKETS) ? objpool_alloc_packets() :
@@ -409,6 +471,237 @@ static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_si
     return 0;
 }
 
+static void pool_run_jobs(SchPoolExec *exec)
+{
+    int jobnr;
+
+    while ((jobnr = atomic_fetch_add(&exec->next_job, 1)) < exec->nb_jobs)
+        exec->func(exec->arg, jobnr, exec->nb_jobs);
+}
+
+static int pool_task_priority_higher(const AVTask *a, const AVTask *b)
+{
+    // keep submission order
+    return 1;
+}
+
+static int pool_task_ready(const AVTask *t, void *user_data)
+{
+    return 1;
+}
+
+static int pool_task_run(AVTask *t, void *local_context, void *user_data)
+{
+    SchPoolExec *exec = ((SchPoolTask*)t)->exec;
+
+    pool_run_jobs(exec);
+
+    pthread_mutex_lock(&exec->lock);
+    if (!--exec->tasks_pending)
+        pthread_cond_signal(&exec->cond);
+    pthread_mutex_unlock(&exec->lock);
+
+    return 0;
+}
+
+int sch_pool_init(Scheduler *sch, int nb_threads)
+{
+    const AVTaskCallbacks callbacks = {
+        .user_data       = sch,
+        .priority_higher = pool_task_priority_higher,
+        .ready           = pool_task_ready,
+        .run             = pool_task_run,
+    };
+
+    av_executor_free(&sch->pool);
+    sch->pool_threads = 0;
+
+    if (nb_threads <= 0)
+        nb_threads = av_cpu_count();
+    nb_threads = FFMIN(nb_threads, SCH_POOL_MAX_THREADS);
+
+    sch->pool = av_executor_alloc(&callbacks, nb_threads);
+    if (!sch->pool)
+        return AVERROR(ENOMEM);
+    sch->pool_threads = nb_threads;
+
+    av_log(sch, AV_LOG_VERBOSE, "Created a shared pool of %d threads\n",
+           nb_threads);
+
+    return 0;
+}
+
+void sch_set_low_latency(Scheduler *sch, int low_latency)
+{
+    sch->low_latency = low_latency;
+}
+
+void sch_set_max_memory(Scheduler *sch, int64_t max_memory)
+{
+    sch->max_memory = max_memory;
+    atomic_init(&sch->mem_limit, max_memory);
+}
+
+static int mem_over_limit(Scheduler *sch, int64_t *in_use)
+{
+    av_buffer_pool_get_memory(NULL, in_use, NULL);
+    return *in_use >= atomic_load(&sch->mem_limit);
+}
+
+/**
+ * Check whether every running task is blocked waiting for another one, so that
+ * no buffers will be released unless a source is allowed to produce more.
+ * A task busy processing data, however slowly, is not waiting.
+ */
+static int pipeline_idle(Scheduler *sch)
+{
+    int nb_waiting = atomic_load(&sch->nb_mem_waiting) +
+                     atomic_load(&sch->nb_tasks_choked);
+
+    for (unsigned i = 0; i < sch->nb_dec; i++)
+        nb_waiting += tq_nb_waiting(sch->dec[i].queue);
+    for (unsigned i = 0; i < sch->nb_filters; i++)
+        nb_waiting += tq_nb_waiting(sch->filters[i].queue);
+    for (unsigned i = 0; i < sch->nb_enc; i++)
+        nb_waiting += tq_nb_waiting(sch->enc[i].queue);
+    for (unsigned i = 0; i < sch->nb_mux; i++)
+        if (sch->mux[i].queue)
+            nb_waiting += tq_nb_waiting(sch->mux[i].queue);
+
+    return nb_waiting >= atomic_load(&sch->nb_tasks_running);
+}
+
+/**
+ * Wait until the pooled buffers in use fit within the memory limit again.
+ * Called by sources before producing more data.
+ *
+ * @retval 0 the caller should proceed
+ * @retval 1 the caller should terminate
+ */
+static int mem_wait(Scheduler *sch)
+{
+    int64_t in_use;
+    int terminate;
+
+    if (!sch->max_memory)
+        return 0;
+    if (!mem_over_limit(sch, &in_use)) {
+        int64_t limit = atomic_load(&sch->mem_limit);
+
+        // the pipeline fits within the requested limit again
+        if (limit > sch->max_memory && in_use < sch->max_memory &&
+            atomic_compare_exchange_strong(&sch->mem_limit, &limit, sch->max_memory))
+            av_log(sch, AV_LOG_VERBOSE, "Memory use back below the limit, "
+                   "lowering it to %"PRId64" bytes\n", sch->max_memory);
+        return 0;
+    }
+
+    pthread_mutex_lock(&sch->mem_lock);
+    atomic_fetch_add(&sch->nb_mem_waiting, 1);
+
+    while (!atomic_load(&sch->terminate) && mem_over_limit(sch, &in_use)) {
+        unsigned progress = atomic_load(&sch->mem_progress);
+        int64_t  in_use_prev = in_use;
+        int64_t  timeout  = av_gettime() + MEM_STALL_TIMEOUT;
+        struct timespec tv = { .tv_sec  =  timeout / 1000000,
+                               .tv_nsec = (timeout % 1000000) * 1000 };
+
+        if (pthread_cond_timedwait(&sch->mem_cond, &sch->mem_lock, &tv) != ETIMEDOUT)
+            continue;
+
+        // Nothing was taken off a queue or released during the whole wait,
+        // and all the other tasks are blocked as well, so the buffers in use
+        // will not be released until more input arrives. The pipeline needs
+        // more memory than the limit allows; raise it above what is in use.
+        if (atomic_load(&sch->mem_progress) == progress &&
+            mem_over_limit(sch, &in_use) && in_use >= in_use_prev &&
+            pipeline_idle(sch)) {
+            int64_t limit = in_use + in_use / 8;
+            atomic_store(&sch->mem_limit, limit);
+            av_log(sch, AV_LOG_VERBOSE, "Pipeline stalled at the memory "
+                   "limit, raising it to %"PRId64" bytes\n", limit);
+        }
+    }
+
+    atomic_fetch_sub(&sch->nb_mem_waiting, 1);
+    terminate = atomic_load(&sch->terminate);
+    pthread_mutex_unlock(&sch->mem_lock);
+
+    return terminate;
+}
+
+// called whenever a packet or frame is taken off a queue, i.e. whenever the
+// buffers it references may be released soon
+static void mem_progress(Scheduler *sch)
+{
+    if (!sch->max_memory)
+        return;
+
+    atomic_fetch_add(&sch->mem_progress, 1);
+
+    if (atomic_load(&sch->nb_mem_waiting)) {
+        pthread_mutex_lock(&sch->mem_lock);
+        pthread_cond_broadcast(&sch->mem_cond);
+        pthread_mutex_unlock(&sch->mem_lock);
+    }
+}
+
+int sch_pool_threads(const Scheduler *sch)
+{
+    return sch->pool_threads;
+}
+
+int sch_pool_execute(Scheduler *sch, SchPoolFunc func, void *arg, int nb_jobs)
+{
+    SchPoolTask tasks[SCH_POOL_MAX_THREADS];
+    SchPoolExec exec = {
+        .func    = func,
+        .arg     = arg,
+        .nb_jobs = nb_jobs,
+    };
+    int nb_tasks, ret;
+
+    if (nb_jobs <= 0)
+        return 0;
+
+    // the calling thread runs jobs as well, so only hand the rest to the pool
+    nb_tasks = FFMIN(nb_jobs - 1, sch->pool_threads);
+    if (!nb_tasks) {
+        for (int i = 0; i < nb_jobs; i++)
+            func(arg, i, nb_jobs);
+        return 0;
+    }
+
+    atomic_init(&exec.next_job, 0);
+    exec.tasks_pending = nb_tasks;
+
+    ret = pthread_mutex_init(&exec.lock, NULL);
+    if (ret)
+        return AVERROR(ret);
+    ret = pthread_cond_init(&exec.cond, NULL);
+    if (ret) {
+        pthread_mutex_destroy(&exec.lock);
+        return AVERROR(ret);
+    }
+
+    for (int i = 0; i < nb_tasks; i++) {
+        tasks[i].exec = &exec;
+        av_executor_execute(sch->pool, &tasks[i].t);
+    }
+
+    pool_run_jobs(&exec);
+
+    pthread_mutex_lock(&exec.lock);
+    while (exec.tasks_pending)
+        pthread_cond_wait(&exec.cond, &exec.lock);
+    pthread_mutex_unlock(&exec.lock);
+
+    pthread_cond_destroy(&exec.cond);
+    pthread_mutex_destroy(&exec.lock);
+
+    return 0;
+}
+
 static void *task_wrapper(void *arg);
 
 static int task_start(SchTask *task)
@@ -524,6 +817,11 @@ void sch_free(Scheduler **psch)
 
             av_freep(&o->dst);
             av_freep(&o->dst_finished);
+
+            av_freep(&o->shared_tq);
+            av_freep(&o->shared_stream);
+            av_freep(&o->shared_dst);
+            av_freep(&o->shared_ret);
         }
 
         av_freep(&dec->outputs);
@@ -567,6 +865,8 @@ void sch_free(Scheduler **psch)
 
     av_freep(&sch->sdp_filename);
 
+    av_executor_free(&sch->pool);
+
     pthread_mutex_destroy(&sch->schedule_lock);
 
     pthread_mutex_destroy(&sch->mux_ready_lock);
@@ -574,6 +874,9 @@ void sch_free(Scheduler **psch)
     pthread_mutex_destroy(&sch->finish_lock);
     pthread_cond_destroy(&sch->finish_cond);
 
+    pthread_mutex_destroy(&sch->mem_lock);
+    pthread_cond_destroy(&sch->mem_cond);
+
     av_freep(psch);
 }
 
@@ -610,6 +913,14 @@ Scheduler *sch_alloc(void)
     if (ret)
         goto fail;
 
+    ret = pthread_mutex_init(&sch->mem_lock, NULL);
+    if (ret)
+        goto fail;
+
+    ret = pthread_cond_init(&sch->mem_cond, NULL);
+    if (ret)
+        goto fail;
+
     return sch;
 fail:
     sch_free(&sch);
@@ -769,7 +1080,7 @@ int sch_add_dec(Scheduler *sch, SchThreadFunc func, void *ctx, int send_end_ts)
     if (ret < 0)
         return ret;
 
-    ret = queue_alloc(&dec->queue, 1, 0, QUEUE_PACKETS);
+    ret = queue_alloc(&dec->queue, 1, sch->low_latency, QUEUE_PACKETS);
     if (ret < 0)
         return ret;
 
@@ -813,7 +1124,7 @@ int sch_add_enc(Scheduler *sch, SchThreadFunc func, void *ctx,
     if (!enc->send_pkt)
         return AVERROR(ENOMEM);
 
-    ret = queue_alloc(&enc->queue, 1, 0, QUEUE_FRAMES);
+    ret = queue_alloc(&enc->queue, 1, sch->low_latency, QUEUE_FRAMES);
     if (ret < 0)
         return ret;
 
@@ -861,7 +1172,7 @@ int sch_add_filtergraph(Scheduler *sch, unsigned nb_inputs, unsigned nb_outputs,
     if (ret < 0)
         return ret;
 
-    ret = queue_alloc(&fg->queue, fg->nb_inputs + 1, 0, QUEUE_FRAMES);
+    ret = queue_alloc(&fg->queue, fg->nb_inputs + 1, sch->low_latency, QUEUE_FRAMES);
     if (ret < 0)
         return ret;
 
@@ -1494,6 +1805,16 @@ static int start_prepare(Scheduler *sch)
             o->dst_finished = av_calloc(o->nb_dst, sizeof(*o->dst_finished));
             if (!o->dst_finished)
                 return AVERROR(ENOMEM);
+
+            if (o->nb_dst > 1) {
+                o->shared_tq     = av_calloc(o->nb_dst, sizeof(*o->shared_tq));
+                o->shared_stream = av_calloc(o->nb_dst, sizeof(*o->shared_stream));
+                o->shared_dst    = av_calloc(o->nb_dst, sizeof(*o->shared_dst));
+                o->shared_ret    = av_calloc(o->nb_dst, sizeof(*o->shared_ret));
+                if (!o->shared_tq || !o->shared_stream ||
+                    !o->shared_dst || !o->shared_ret)
+                    return AVERROR(ENOMEM);
+            }
         }
     }
 
@@ -1544,7 +1865,8 @@ static int start_prepare(Scheduler *sch)
             }
         }
 
-        ret = queue_alloc(&mux->queue, mux->nb_streams, mux->queue_size,
+        ret = queue_alloc(&mux->queue, mux->nb_streams,
+                          mux->queue_size ? mux->queue_size : sch->low_latency,
                           QUEUE_PACKETS);
         if (ret < 0)
             return ret;
@@ -2044,6 +2366,8 @@ int sch_demux_send(Scheduler *sch, unsigned demux_idx, AVPacket *pkt,
     d = &sch->demux[demux_idx];
 
     terminate = waiter_wait(sch, &d->waiter);
+    if (!terminate)
+        terminate = mem_wait(sch);
     if (terminate)
         return AVERROR_EXIT;
 
@@ -2088,6 +2412,7 @@ int sch_mux_receive(Scheduler *sch, unsigned mux_idx, AVPacket *pkt)
 
     ret = tq_receive(mux->queue, &stream_idx, pkt);
     pkt->stream_index = stream_idx;
+    mem_progress(sch);
     return ret;
 }
 
@@ -2182,6 +2507,7 @@ int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
 
     ret = tq_receive(dec->queue, &dummy, pkt);
     av_assert0(dummy <= 0);
+    mem_progress(sch);
 
     // got a flush packet, on the next call to this function the decoder
     // will give us post-flush end timestamp
@@ -2238,13 +2564,45 @@ finish:
     return AVERROR_EOF;
 }
 
+static void *frame_share_alloc(void)
+{
+    return av_frame_alloc();
+}
+
+static void frame_share_free(void **frame)
+{
+    av_frame_free((AVFrame**)frame);
+}
+
+static int frame_share_ref(void *dst, const void *src)
+{
+    const AVFrame *frame = src;
+
+    // frame may sometimes contain props only,
+    // e.g. to signal EOF timestamp
+    return frame->buf[0] ? av_frame_ref(dst, frame) :
+                           av_frame_copy_props(dst, frame);
+}
+
+static const TQShareCallbacks frame_share_cb = {
+    .alloc = frame_share_alloc,
+    .free  = frame_share_free,
+    .ref   = frame_share_ref,
+};
+
+static int dec_is_shared_dst(const SchDecOutput *o, unsigned nb_shared, unsigned i)
+{
+    return nb_shared && !o->dst_finished[i] &&
+           o->dst[i].type == SCH_NODE_TYPE_FILTER_IN;
+}
+
 int sch_dec_send(Scheduler *sch, unsigned dec_idx,
                  unsigned out_idx, AVFrame *frame)
 {
     SchDec *dec;
     SchDecOutput *o;
     int ret;
-    unsigned nb_done = 0;
+    unsigned nb_done = 0, nb_shared = 0;
 
     av_assert0(dec_idx < sch->nb_dec);
     dec = &sch->dec[dec_idx];
@@ -2252,18 +2610,32 @@ int sch_dec_send(Scheduler *sch, unsigned dec_idx,
     av_assert0(out_idx < dec->nb_outputs);
     o = &dec->outputs[out_idx];
 
+    // when feeding several filtergraph inputs, store the frame once and let
+    // all their queues share it, rather than making a reference for each
+    for (unsigned i = 0; i < o->nb_dst; i++) {
+        if (!dec_is_shared_dst(o, o->nb_dst > 1, i))
+            continue;
+
+        o->shared_tq[nb_shared]     = sch->filters[o->dst[i].idx].queue;
+        o->shared_stream[nb_shared] = o->dst[i].idx_stream;
+        o->shared_dst[nb_shared]    = i;
+        nb_shared++;
+    }
+    if (nb_shared < 2)
+        nb_shared = 0;
+
     for (unsigned i = 0; i < o->nb_dst; i++) {
         uint8_t *finished = &o->dst_finished[i];
         AVFrame *to_send  = frame;
 
+        if (dec_is_shared_dst(o, nb_shared, i))
+            continue;
+
         // sending a frame consumes it, so make a temporary reference if needed
-        if (i < o->nb_dst - 1) {
+        if (nb_shared || i < o->nb_dst - 1) {
             to_send = dec->send_frame;
 
-            // frame may sometimes contain props only,
-            // e.g. to signal EOF timestamp
-            ret = frame->buf[0] ? av_frame_ref(to_send, frame) :
-                                  av_frame_copy_props(to_send, frame);
+            ret = frame_share_ref(to_send, frame);
             if (ret < 0)
                 return ret;
         }
@@ -2279,6 +2651,24 @@ int sch_dec_send(Scheduler *sch, unsigned dec_idx,
         }
     }
 
+    if (nb_shared) {
+        ret = tq_send_shared(o->shared_tq, o->shared_stream, o->shared_ret,
+                             nb_shared, frame, &frame_share_cb);
+        if (ret < 0)
+            return ret;
+
+        for (unsigned i = 0; i < nb_shared; i++) {
+            unsigned dst_idx = o->shared_dst[i];
+
+            ret = o->shared_ret[i];
+            if (ret == AVERROR_EOF) {
+                dec_send_to_dst(sch, o->dst[dst_idx], &o->dst_finished[dst_idx], NULL);
+                nb_done++;
+            } else if (ret < 0)
+                return ret;
+        }
+    }
+
     return (nb_done == o->nb_dst) ? AVERROR_EOF : 0;
 }
 
@@ -2317,6 +2707,7 @@ int sch_enc_receive(Scheduler *sch, unsigned enc_idx, AVFrame *frame)
 
     ret = tq_receive(enc->queue, &dummy, frame);
     av_assert0(dummy <= 0);
+    mem_progress(sch);
 
     return ret;
 }
@@ -2425,6 +2816,8 @@ int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
 
     if (*in_idx == fg->nb_inputs) {
         int terminate = waiter_wait(sch, &fg->waiter);
+        if (!terminate)
+            terminate = mem_wait(sch);
         return terminate ? AVERROR_EOF : AVERROR(EAGAIN);
     }
 
@@ -2432,12 +2825,14 @@ int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
         int ret, idx;
 
         ret = tq_receive(fg->queue, &idx, frame);
+        mem_progress(sch);
         if (idx < 0)
             return AVERROR_EOF;
         else if (ret >= 0) {
             *in_idx = idx;
             return 0;
-        }
+        } else if (ret != AVERROR_EOF)
+            return ret;
 
         // disregard EOFs for specific streams - they should always be
         // preceded by an EOF frame
@@ -2539,7 +2934,9 @@ static void *task_wrapper(void *arg)
     int ret;
     int err = 0;
 
+    atomic_fetch_add(&sch->nb_tasks_running, 1);
     ret = task->func(task->func_arg);
+    atomic_fetch_sub(&sch->nb_tasks_running, 1);
     if (ret < 0)
         av_log(task->func_arg, AV_LOG_ERROR,
                "Task finished with error code: %d (%s)\n", ret, av_err2str(ret));
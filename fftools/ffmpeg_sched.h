@@ -298,6 +298,59 @@ int sch_mux_stream_ready(Scheduler *sch, unsigned mux_idx, unsigned stream_idx);
  */
 int sch_sdp_filename(Scheduler *sch, const char *sdp_filename);
 
+/**
+ * Create a pool of worker threads shared by all the components of the
+ * transcoding pipeline. Components may then offload parallelizable work to it
+ * with sch_pool_execute(), instead of each spawning its own threads.
+ *
+ * @param nb_threads Number of worker threads; 0 means one per available CPU.
+ */
+int sch_pool_init(Scheduler *sch, int nb_threads);
+
+/**
+ * @return number of worker threads in the shared pool, 0 if sch_pool_init()
+ *         was not called
+ */
+int sch_pool_threads(const Scheduler *sch);
+
+typedef void (*SchPoolFunc)(void *arg, int jobnr, int nb_jobs);
+
+/**
+ * Execute func nb_jobs times on the shared pool, possibly in parallel, and
+ * wait for all the invocations to finish. The calling thread takes part in
+ * executing the jobs, so this may be called from any thread, including pool
+ * threads.
+ *
+ * When no pool was created, the jobs are run on the calling thread.
+ */
+int sch_pool_execute(Scheduler *sch, SchPoolFunc func, void *arg, int nb_jobs);
+
+/**
+ * Enable low-latency scheduling. Every thread queue between the components
+ * then holds a single packet or frame, so that each is passed on as soon as
+ * it is produced instead of accumulating between the stages. Thread queue
+ * sizes passed to sch_add_mux() still apply.
+ *
+ * Must be called before any components are added.
+ */
+void sch_set_low_latency(Scheduler *sch, int low_latency);
+
+/**
+ * Limit the memory used by the transcoding pipeline. Once the pooled frame
+ * buffers in use (as reported by av_buffer_pool_get_memory()) reach
+ * max_memory bytes, demuxers and filtergraphs with internal sources are held
+ * back until enough of them are released.
+ *
+ * The limit is soft: when the buffers in use cannot be released without
+ * reading more input, e.g. because an encoder holds more frames than fit
+ * within it, it is raised to accommodate the pipeline. That is only done when
+ * every task is blocked waiting for another one, and the limit is lowered back
+ * to max_memory once the buffers in use fit within it again.
+ *
+ * @param max_memory the limit in bytes, 0 to disable
+ */
+void sch_set_max_memory(Scheduler *sch, int64_t max_memory);
+
 /**
  * Add an encoder to the scheduler.
  *
@@ -16,12 +16,12 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
 
 #include "libavutil/avassert.h"
 #include "libavutil/error.h"
-#include "libavutil/fifo.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
@@ -34,24 +34,91 @@ enum {
     FINISHED_RECV = (1 << 1),
 };
 
-typedef struct FifoElem {
-    void        *obj;
-    unsigned int stream_idx;
-} FifoElem;
+/**
+ * An item stored once and referenced from several queues.
+ */
+typedef struct SharedItem {
+    void                   *obj;
+    atomic_uint             refcount;
+    const TQShareCallbacks *cb;
+} SharedItem;
+
+/**
+ * One entry of the ring buffer.
+ *
+ * The entries are written by any number of senders and read by a single
+ * receiver, using per-entry sequence numbers to hand them over without
+ * locking. Each entry owns a pre-allocated object, so no allocation happens
+ * when sending.
+ */
+typedef struct TQSlot {
+    /**
+     * 2 * position when the slot is free for writing the item at that
+     * position, one more than that once the item has been written
+     *
+     * The position is doubled so that the written state of a lap can not be
+     * mistaken for the free state of the next one, which would happen with
+     * a single-slot ring otherwise.
+     */
+    atomic_size_t seq;
+
+    // obj is always set, shared is set instead of using obj for shared items
+    void         *obj;
+    SharedItem   *shared;
+    unsigned int  stream_idx;
+} TQSlot;
 
 struct ThreadQueue {
-    int              *finished;
+    atomic_int       *finished;
     unsigned int    nb_streams;
 
-    AVFifo  *fifo;
+    TQSlot          *slots;
+    size_t        nb_slots;
+    // next position to write, shared by the senders
+    atomic_size_t    write_pos;
+    // next position to read, only accessed by the receiver
+    size_t           read_pos;
 
     ObjPool *obj_pool;
     void   (*obj_move)(void *dst, void *src);
 
+    /* The lock and the conditions are only used when a sender has to wait
+     * for space or the receiver for data. The waiting counts allow the other
+     * side to skip signalling when nobody is waiting. */
     pthread_mutex_t lock;
-    pthread_cond_t  cond;
+    pthread_cond_t  cond_send;
+    pthread_cond_t  cond_recv;
+    atomic_int   nb_send_waiting;
+    atomic_int   nb_recv_waiting;
 };
 
+static void shared_unref(SharedItem **pshared)
+{
+    SharedItem *shared = *pshared;
+
+    if (atomic_fetch_sub_explicit(&shared->refcount, 1, memory_order_acq_rel) == 1) {
+        shared->cb->free(&shared->obj);
+        av_free(shared);
+    }
+    *pshared = NULL;
+}
+
+static void slot_release(ThreadQueue *tq, TQSlot *slot)
+{
+    int ret;
+
+    if (slot->shared) {
+        shared_unref(&slot->shared);
+        return;
+    }
+
+    // reset the object by cycling it through the pool; the pool is only used
+    // by the receiver after tq_alloc(), so this gets back the same object
+    objpool_release(tq->obj_pool, &slot->obj);
+    ret = objpool_get(tq->obj_pool, &slot->obj);
+    av_assert0(ret >= 0);
+}
+
 void tq_free(ThreadQueue **ptq)
 {
     ThreadQueue *tq = *ptq;
@@ -59,18 +126,22 @@ void tq_free(ThreadQueue **ptq)
     if (!tq)
         return;
 
-    if (tq->fifo) {
-        FifoElem elem;
-        while (av_fifo_read(tq->fifo, &elem, 1) >= 0)
-            objpool_release(tq->obj_pool, &elem.obj);
+    for (size_t i = 0; tq->slots && i < tq->nb_slots; i++) {
+        TQSlot *slot = &tq->slots[i];
+
+        if (slot->shared)
+            shared_unref(&slot->shared);
+        if (slot->obj)
+            objpool_release(tq->obj_pool, &slot->obj);
     }
-    av_fifo_freep2(&tq->fifo);
+    av_freep(&tq->slots);
 
     objpool_free(&tq->obj_pool);
 
     av_freep(&tq->finished);
 
-    pthread_cond_destroy(&tq->cond);
+    pthread_cond_destroy(&tq->cond_recv);
+    pthread_cond_destroy(&tq->cond_send);
     pthread_mutex_destroy(&tq->lock);
 
     av_freep(ptq);
@@ -86,30 +157,51 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
     if (!tq)
         return NULL;
 
-    ret = pthread_cond_init(&tq->cond, NULL);
+    ret = pthread_cond_init(&tq->cond_send, NULL);
+    if (ret) {
+        av_freep(&tq);
+        return NULL;
+    }
+
+    ret = pthread_cond_init(&tq->cond_recv, NULL);
     if (ret) {
+        pthread_cond_destroy(&tq->cond_send);
         av_freep(&tq);
         return NULL;
     }
 
     ret = pthread_mutex_init(&tq->lock, NULL);
     if (ret) {
-        pthread_cond_destroy(&tq->cond);
+        pthread_cond_destroy(&tq->cond_recv);
+        pthread_cond_destroy(&tq->cond_send);
         av_freep(&tq);
         return NULL;
     }
 
+    atomic_init(&tq->write_pos,       0);
+    atomic_init(&tq->nb_send_waiting, 0);
+    atomic_init(&tq->nb_recv_waiting, 0);
+
+    tq->obj_pool = obj_pool;
+    tq->obj_move = obj_move;
+
     tq->finished = av_calloc(nb_streams, sizeof(*tq->finished));
     if (!tq->finished)
         goto fail;
     tq->nb_streams = nb_streams;
+    for (unsigned int i = 0; i < nb_streams; i++)
+        atomic_init(&tq->finished[i], 0);
 
-    tq->fifo = av_fifo_alloc2(queue_size, sizeof(FifoElem), 0);
-    if (!tq->fifo)
+    tq->slots = av_calloc(queue_size, sizeof(*tq->slots));
+    if (!tq->slots)
         goto fail;
+    tq->nb_slots = queue_size;
 
-    tq->obj_pool = obj_pool;
-    tq->obj_move = obj_move;
+    for (size_t i = 0; i < queue_size; i++) {
+        atomic_init(&tq->slots[i].seq, 2 * i);
+        if (objpool_get(obj_pool, &tq->slots[i].obj) < 0)
+            goto fail;
+    }
 
     return tq;
 fail:
@@ -117,73 +209,251 @@ fail:
     return NULL;
 }
 
-int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
+/**
+ * Try to store an item in the queue without blocking. Exactly one of data and
+ * shared must be set.
+ *
+ * @return 1 if the item was stored, 0 if the queue is full
+ */
+static int ring_write(ThreadQueue *tq, unsigned int stream_idx,
+                      void *data, SharedItem *shared)
 {
-    int *finished;
-    int ret;
+    size_t pos = atomic_load_explicit(&tq->write_pos, memory_order_relaxed);
+    TQSlot *slot;
 
-    av_assert0(stream_idx < tq->nb_streams);
-    finished = &tq->finished[stream_idx];
+    while (1) {
+        size_t   seq;
+        intptr_t diff;
+
+        slot = &tq->slots[pos % tq->nb_slots];
+        seq  = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        diff = (intptr_t)(seq - 2 * pos);
+
+        if (!diff) {
+            // the slot is free, try to claim it
+            if (atomic_compare_exchange_weak_explicit(&tq->write_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            // the slot still holds an item from the previous lap
+            return 0;
+        } else
+            pos = atomic_load_explicit(&tq->write_pos, memory_order_relaxed);
+    }
+
+    slot->stream_idx = stream_idx;
+    if (shared)
+        slot->shared = shared;
+    else
+        tq->obj_move(slot->obj, data);
+
+    // publish the item to the receiver
+    atomic_store_explicit(&slot->seq, 2 * pos + 1, memory_order_release);
+
+    return 1;
+}
+
+static int ring_can_write(ThreadQueue *tq)
+{
+    size_t pos = atomic_load_explicit(&tq->write_pos, memory_order_relaxed);
+    TQSlot *slot = &tq->slots[pos % tq->nb_slots];
+
+    return (intptr_t)(atomic_load_explicit(&slot->seq, memory_order_acquire) - 2 * pos) >= 0;
+}
+
+/**
+ * Check that every slot claimed by a sender has been read. Must only be called
+ * by the receiver.
+ */
+static int ring_empty(ThreadQueue *tq)
+{
+    return atomic_load(&tq->write_pos) == tq->read_pos;
+}
+
+/**
+ * Get the next item in the queue, if any. Must only be called by the receiver.
+ */
+static TQSlot *ring_peek(ThreadQueue *tq)
+{
+    TQSlot *slot = &tq->slots[tq->read_pos % tq->nb_slots];
+
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != 2 * tq->read_pos + 1)
+        return NULL;
+    return slot;
+}
+
+/**
+ * Hand the slot returned by ring_peek(), which must have been emptied, back to
+ * the senders.
+ */
+static void ring_advance(ThreadQueue *tq, TQSlot *slot)
+{
+    atomic_store_explicit(&slot->seq, 2 * (tq->read_pos + tq->nb_slots),
+                          memory_order_release);
+    tq->read_pos++;
+
+    // pairs with the fence in send_wait()
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&tq->nb_send_waiting, memory_order_relaxed)) {
+        pthread_mutex_lock(&tq->lock);
+        pthread_cond_broadcast(&tq->cond_send);
+        pthread_mutex_unlock(&tq->lock);
+    }
+}
 
+static void wake_receiver(ThreadQueue *tq)
+{
+    // pairs with the fence in tq_receive()
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&tq->nb_recv_waiting, memory_order_relaxed)) {
+        pthread_mutex_lock(&tq->lock);
+        pthread_cond_broadcast(&tq->cond_recv);
+        pthread_mutex_unlock(&tq->lock);
+    }
+}
+
+/**
+ * Wait until the queue has space or the receiver finished the stream.
+ */
+static void send_wait(ThreadQueue *tq, unsigned int stream_idx)
+{
     pthread_mutex_lock(&tq->lock);
 
-    if (*finished & FINISHED_SEND) {
-        ret = AVERROR(EINVAL);
-        goto finish;
+    atomic_fetch_add_explicit(&tq->nb_send_waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (!(atomic_load(&tq->finished[stream_idx]) & FINISHED_RECV) &&
+        !ring_can_write(tq))
+        pthread_cond_wait(&tq->cond_send, &tq->lock);
+
+    atomic_fetch_sub_explicit(&tq->nb_send_waiting, 1, memory_order_relaxed);
+
+    pthread_mutex_unlock(&tq->lock);
+}
+
+/**
+ * Wait for space in the queue and write the item into it. Exactly one of data
+ * and shared must be set.
+ */
+static int send_item(ThreadQueue *tq, unsigned int stream_idx,
+                     void *data, SharedItem *shared)
+{
+    atomic_int *finished = &tq->finished[stream_idx];
+
+    av_assert0(stream_idx < tq->nb_streams);
+
+    if (atomic_load(finished) & FINISHED_SEND)
+        return AVERROR(EINVAL);
+
+    while (1) {
+        if (atomic_load(finished) & FINISHED_RECV) {
+            atomic_fetch_or(finished, FINISHED_SEND);
+            return AVERROR_EOF;
+        }
+
+        if (ring_write(tq, stream_idx, data, shared))
+            break;
+
+        send_wait(tq, stream_idx);
     }
 
-    while (!(*finished & FINISHED_RECV) && !av_fifo_can_write(tq->fifo))
-        pthread_cond_wait(&tq->cond, &tq->lock);
+    wake_receiver(tq);
+
+    return 0;
+}
+
+int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
+{
+    return send_item(tq, stream_idx, data, NULL);
+}
+
+int tq_send_shared(ThreadQueue * const *tq, const unsigned int *stream_idx,
+                   int *ret, unsigned int nb_tq, void *data,
+                   const TQShareCallbacks *cb)
+{
+    SharedItem *shared;
+
+    shared = av_mallocz(sizeof(*shared));
+    if (!shared)
+        return AVERROR(ENOMEM);
 
-    if (*finished & FINISHED_RECV) {
-        ret = AVERROR_EOF;
-        *finished |= FINISHED_SEND;
-    } else {
-        FifoElem elem = { .stream_idx = stream_idx };
+    shared->obj = cb->alloc();
+    if (!shared->obj) {
+        av_free(shared);
+        return AVERROR(ENOMEM);
+    }
+    shared->cb = cb;
 
-        ret = objpool_get(tq->obj_pool, &elem.obj);
-        if (ret < 0)
-            goto finish;
+    // one reference for each queue, plus one held by us until all the
+    // queues have been written to
+    atomic_init(&shared->refcount, nb_tq + 1);
 
-        tq->obj_move(elem.obj, data);
+    tq[0]->obj_move(shared->obj, data);
 
-        ret = av_fifo_write(tq->fifo, &elem, 1);
-        av_assert0(ret >= 0);
-        pthread_cond_broadcast(&tq->cond);
+    for (unsigned int i = 0; i < nb_tq; i++) {
+        ret[i] = send_item(tq[i], stream_idx[i], NULL, shared);
+        if (ret[i] < 0) {
+            SharedItem *ref = shared;
+            shared_unref(&ref);
+        }
     }
 
-finish:
-    pthread_mutex_unlock(&tq->lock);
+    shared_unref(&shared);
 
-    return ret;
+    return 0;
 }
 
-static int receive_locked(ThreadQueue *tq, int *stream_idx,
-                          void *data)
+static int receive_item(ThreadQueue *tq, int *stream_idx, void *data)
 {
-    FifoElem elem;
     unsigned int nb_finished = 0;
+    TQSlot *slot;
+
+retry:
+    while ((slot = ring_peek(tq))) {
+        unsigned int idx = slot->stream_idx;
+        int ret = 0;
 
-    while (av_fifo_read(tq->fifo, &elem, 1) >= 0) {
-        if (tq->finished[elem.stream_idx] & FINISHED_RECV) {
-            objpool_release(tq->obj_pool, &elem.obj);
+        if (atomic_load(&tq->finished[idx]) & FINISHED_RECV) {
+            slot_release(tq, slot);
+            ring_advance(tq, slot);
             continue;
         }
 
-        tq->obj_move(data, elem.obj);
-        objpool_release(tq->obj_pool, &elem.obj);
-        *stream_idx = elem.stream_idx;
-        return 0;
+        if (!slot->shared)
+            tq->obj_move(data, slot->obj);
+        else if (atomic_load_explicit(&slot->shared->refcount, memory_order_acquire) == 1)
+            // we hold the only remaining reference, take the item over
+            tq->obj_move(data, slot->shared->obj);
+        else
+            ret = slot->shared->cb->ref(data, slot->shared->obj);
+
+        if (slot->shared)
+            shared_unref(&slot->shared);
+        ring_advance(tq, slot);
+
+        *stream_idx = idx;
+        return ret;
     }
 
     for (unsigned int i = 0; i < tq->nb_streams; i++) {
-        if (!tq->finished[i])
+        int finished = atomic_load(&tq->finished[i]);
+
+        if (!finished)
             continue;
 
         /* return EOF to the consumer at most once for each stream */
-        if (!(tq->finished[i] & FINISHED_RECV)) {
-            tq->finished[i] |= FINISHED_RECV;
-            *stream_idx   = i;
+        if (!(finished & FINISHED_RECV)) {
+            // the sender may have written more items before finishing,
+            // which must be returned first; they can also be queued behind
+            // a slot another sender claimed but did not write yet
+            if (ring_peek(tq))
+                goto retry;
+            if (!ring_empty(tq))
+                return AVERROR(EAGAIN);
+
+            atomic_fetch_or(&tq->finished[i], FINISHED_RECV);
+            *stream_idx = i;
             return AVERROR_EOF;
         }
 
@@ -193,32 +463,46 @@ static int receive_locked(ThreadQueue *tq, int *stream_idx,
     return nb_finished == tq->nb_streams ? AVERROR_EOF : AVERROR(EAGAIN);
 }
 
+static int receive_can_progress(ThreadQueue *tq)
+{
+    if (ring_peek(tq))
+        return 1;
+
+    // EOF is only returned once the slots in flight were read; the sender
+    // writing the last of them wakes us up
+    if (!ring_empty(tq))
+        return 0;
+
+    for (unsigned int i = 0; i < tq->nb_streams; i++)
+        if (atomic_load(&tq->finished[i]) == FINISHED_SEND)
+            return 1;
+
+    return 0;
+}
+
 int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
 {
     int ret;
 
     *stream_idx = -1;
 
-    pthread_mutex_lock(&tq->lock);
-
     while (1) {
-        size_t can_read = av_fifo_can_read(tq->fifo);
+        ret = receive_item(tq, stream_idx, data);
+        if (ret != AVERROR(EAGAIN))
+            break;
 
-        ret = receive_locked(tq, stream_idx, data);
+        pthread_mutex_lock(&tq->lock);
 
-        // signal other threads if the fifo state changed
-        if (can_read != av_fifo_can_read(tq->fifo))
-            pthread_cond_broadcast(&tq->cond);
+        atomic_fetch_add_explicit(&tq->nb_recv_waiting, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
 
-        if (ret == AVERROR(EAGAIN)) {
-            pthread_cond_wait(&tq->cond, &tq->lock);
-            continue;
-        }
+        if (!receive_can_progress(tq))
+            pthread_cond_wait(&tq->cond_recv, &tq->lock);
 
-        break;
-    }
+        atomic_fetch_sub_explicit(&tq->nb_recv_waiting, 1, memory_order_relaxed);
 
-    pthread_mutex_unlock(&tq->lock);
+        pthread_mutex_unlock(&tq->lock);
+    }
 
     return ret;
 }
@@ -232,8 +516,8 @@ void tq_send_finish(ThreadQueue *tq, unsigned int stream_idx)
     /* mark the stream as send-finished;
      * next time the consumer thread tries to read this stream it will get
      * an EOF and recv-finished flag will be set */
-    tq->finished[stream_idx] |= FINISHED_SEND;
-    pthread_cond_broadcast(&tq->cond);
+    atomic_fetch_or(&tq->finished[stream_idx], FINISHED_SEND);
+    pthread_cond_broadcast(&tq->cond_recv);
 
     pthread_mutex_unlock(&tq->lock);
 }
@@ -247,8 +531,14 @@ void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx)
     /* mark the stream as recv-finished;
      * next time the producer thread tries to send for this stream, it will
      * get an EOF and send-finished flag will be set */
-    tq->finished[stream_idx] |= FINISHED_RECV;
-    pthread_cond_broadcast(&tq->cond);
+    atomic_fetch_or(&tq->finished[stream_idx], FINISHED_RECV);
+    pthread_cond_broadcast(&tq->cond_send);
 
     pthread_mutex_unlock(&tq->lock);
 }
+
+int tq_nb_waiting(ThreadQueue *tq)
+{
+    return atomic_load_explicit(&tq->nb_send_waiting, memory_order_relaxed) +
+           atomic_load_explicit(&tq->nb_recv_waiting, memory_order_relaxed);
+}
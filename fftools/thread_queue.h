@@ -53,6 +53,44 @@ void         tq_free(ThreadQueue **tq);
  * - AVERROR_EOF the receiving side has marked the given stream as finished
  */
 int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data);
+
+/**
+ * Callbacks for items shared between several queues with tq_send_shared().
+ */
+typedef struct TQShareCallbacks {
+    void* (*alloc)(void);
+    void  (*free)(void **obj);
+    /**
+     * Make dst a new reference to the contents of src, which must be left
+     * untouched.
+     */
+    int   (*ref)(void *dst, const void *src);
+} TQShareCallbacks;
+
+/**
+ * Send a single item to several queues at once.
+ *
+ * The item is stored only once and every queue holds a reference to it. The
+ * receivers obtain their copy through the ref() callback, except for the last
+ * one, to which the item is moved. This moves the reference-making off the
+ * sending thread and avoids it altogether when all but one receiver have
+ * finished.
+ *
+ * @param tq         the queues to send to; the items they store must be of the
+ *                   type handled by cb
+ * @param stream_idx stream index for each of the queues
+ * @param ret        return code for each of the queues, as for tq_send()
+ * @param nb_tq      number of queues
+ * @param data       the item to send; on success its contents are moved into
+ *                   shared storage, on failure it is left untouched
+ * @return
+ * - 0 the item was sent to every queue that did not fail, see ret
+ * - AVERROR(ENOMEM) could not allocate the shared storage
+ */
+int tq_send_shared(ThreadQueue * const *tq, const unsigned int *stream_idx,
+                   int *ret, unsigned int nb_tq, void *data,
+                   const TQShareCallbacks *cb);
+
 /**
  * Mark the given stream finished from the sending side.
  */
@@ -71,6 +109,8 @@ void tq_send_finish(ThreadQueue *tq, unsigned int stream_idx);
  * - AVERROR_EOF When *stream_idx is non-negative, this signals that the sending
  *   side has marked the given stream as finished. This will happen at most once
  *   for each stream. When *stream_idx is -1, all streams are done.
+ * - another negative error code: an item sent with tq_send_shared() for
+ *   *stream_idx could not be referenced and was dropped
  */
 int tq_receive(ThreadQueue *tq, int *stream_idx, void *data);
 /**
@@ -78,4 +118,10 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data);
  */
 void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx);
 
+/**
+ * Return the number of threads currently blocked in tq_send() or tq_receive()
+ * on this queue. The result may be stale as soon as it is returned.
+ */
+int tq_nb_waiting(ThreadQueue *tq);
+
 #endif // FFTOOLS_THREAD_QUEUE_H
@@ -826,6 +826,137 @@ static void copy_input_samples(AACEncContext *s, const AVFrame *frame)
     }
 }
 
+/**
+ * Search the quantizers and TNS of one channel element.
+ * The psy analysis of the element must be done.
+ */
+static void search_channel_element(AVCodecContext *avctx, AACEncContext *s,
+                                   ChannelElement *cpe, int tag)
+{
+    SingleChannelElement *sce;
+    const int chans = tag == TYPE_CPE ? 2 : 1;
+    const int start_ch = cpe->start_ch;
+    int ch;
+
+    s->cur_type = tag;
+    for (ch = 0; ch < chans; ch++) {
+        s->cur_channel = start_ch + ch;
+        if (s->options.pns && s->coder->mark_pns)
+            s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
+        s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
+    }
+    for (ch = 0; ch < chans; ch++) { /* TNS */
+        sce = &cpe->ch[ch];
+        s->cur_channel = start_ch + ch;
+        if (s->options.tns && s->coder->search_for_tns)
+            s->coder->search_for_tns(s, sce);
+        if (s->options.tns && s->coder->apply_tns_filt)
+            s->coder->apply_tns_filt(s, sce);
+    }
+}
+
+/**
+ * Search the remaining coding parameters of one channel element and code it.
+ * The quantizers, TNS and PNS of the element must be searched.
+ */
+static void encode_channel_element(AVCodecContext *avctx, AACEncContext *s,
+                                   ChannelElement *cpe, int tag)
+{
+    SingleChannelElement *sce;
+    const int chans = tag == TYPE_CPE ? 2 : 1;
+    const int start_ch = cpe->start_ch;
+    int ch;
+
+    s->cur_type    = tag;
+    s->cur_channel = start_ch;
+    if (s->options.intensity_stereo) { /* Intensity Stereo */
+        if (s->coder->search_for_is)
+            s->coder->search_for_is(s, avctx, cpe);
+        apply_intensity_stereo(cpe);
+    }
+    if (s->options.pred) { /* Prediction */
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            s->cur_channel = start_ch + ch;
+            if (s->options.pred && s->coder->search_for_pred)
+                s->coder->search_for_pred(s, sce);
+        }
+        if (s->coder->adjust_common_pred)
+            s->coder->adjust_common_pred(s, cpe);
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            s->cur_channel = start_ch + ch;
+            if (s->options.pred && s->coder->apply_main_pred)
+                s->coder->apply_main_pred(s, sce);
+        }
+        s->cur_channel = start_ch;
+    }
+    if (s->options.mid_side) { /* Mid/Side stereo */
+        if (s->options.mid_side == -1 && s->coder->search_for_ms)
+            s->coder->search_for_ms(s, cpe);
+        else if (cpe->common_window)
+            memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
+        apply_mid_side_stereo(cpe);
+    }
+    adjust_frame_information(cpe, chans);
+    if (s->options.ltp) { /* LTP */
+        for (ch = 0; ch < chans; ch++) {
+            sce = &cpe->ch[ch];
+            s->cur_channel = start_ch + ch;
+            if (s->coder->search_for_ltp)
+                s->coder->search_for_ltp(s, sce, cpe->common_window);
+        }
+        s->cur_channel = start_ch;
+        if (s->coder->adjust_common_ltp)
+            s->coder->adjust_common_ltp(s, cpe);
+    }
+    if (chans == 2) {
+        put_bits(&s->pb, 1, cpe->common_window);
+        if (cpe->common_window) {
+            put_ics_info(s, &cpe->ch[0].ics);
+            if (s->coder->encode_main_pred)
+                s->coder->encode_main_pred(s, &cpe->ch[0]);
+            if (s->coder->encode_ltp_info)
+                s->coder->encode_ltp_info(s, &cpe->ch[0], 1);
+            encode_ms_info(&s->pb, cpe);
+        }
+    }
+    for (ch = 0; ch < chans; ch++) {
+        s->cur_channel = start_ch + ch;
+        encode_individual_channel(avctx, s, &cpe->ch[ch], cpe->common_window);
+    }
+}
+
+static int search_element_job(AVCodecContext *avctx, void *arg,
+                              int jobnr, int threadnr)
+{
+    AACEncContext *s    = avctx->priv_data;
+    AACEncContext *js   = s->job_ctx[threadnr];
+    ChannelElement *cpe = &s->cpe[jobnr];
+
+    js->psy.bitres.alloc = cpe->bitres_alloc;
+    search_channel_element(avctx, js, cpe, s->chan_map[jobnr + 1]);
+
+    return 0;
+}
+
+static int encode_element_job(AVCodecContext *avctx, void *arg,
+                              int jobnr, int threadnr)
+{
+    AACEncContext *s    = avctx->priv_data;
+    AACEncContext *js   = s->job_ctx[threadnr];
+    ChannelElement *cpe = &s->cpe[jobnr];
+
+    init_put_bits(&js->pb, cpe->buf, cpe->buf_size);
+
+    encode_channel_element(avctx, js, cpe, s->chan_map[jobnr + 1]);
+
+    cpe->bits = put_bits_count(&js->pb);
+    flush_put_bits(&js->pb);
+
+    return 0;
+}
+
 static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                             const AVFrame *frame, int *got_packet_ptr)
 {
@@ -955,13 +1086,8 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
         return ret;
     frame_bits = its = 0;
     do {
-        init_put_bits(&s->pb, avpkt->data, avpkt->size);
-
-        if ((avctx->frame_num & 0xFF)==1 && !(avctx->flags & AV_CODEC_FLAG_BITEXACT))
-            put_bitstream_info(s, LIBAVCODEC_IDENT);
         start_ch = 0;
         target_bits = 0;
-        memset(chan_el_counter, 0, sizeof(chan_el_counter));
         for (i = 0; i < s->chan_map[0]; i++) {
             FFPsyWindowInfo* wi = windows + start_ch;
             const float *coeffs[2];
@@ -971,8 +1097,6 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             cpe->common_window = 0;
             memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
             memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
-            put_bits(&s->pb, 3, tag);
-            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             for (ch = 0; ch < chans; ch++) {
                 sce = &cpe->ch[ch];
                 coeffs[ch] = sce->coeffs;
@@ -994,13 +1118,7 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                     * (s->lambda / (avctx->global_quality ? avctx->global_quality : 120));
                 s->psy.bitres.alloc /= chans;
             }
-            s->cur_type = tag;
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
-                if (s->options.pns && s->coder->mark_pns)
-                    s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
-                s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
-            }
+            cpe->bitres_alloc = s->psy.bitres.alloc;
             if (chans > 1
                 && wi[0].window_type[0] == wi[1].window_type[0]
                 && wi[0].window_shape   == wi[1].window_shape) {
@@ -1013,80 +1131,55 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                     }
                 }
             }
-            for (ch = 0; ch < chans; ch++) { /* TNS and PNS */
-                sce = &cpe->ch[ch];
-                s->cur_channel = start_ch + ch;
-                if (s->options.tns && s->coder->search_for_tns)
-                    s->coder->search_for_tns(s, sce);
-                if (s->options.tns && s->coder->apply_tns_filt)
-                    s->coder->apply_tns_filt(s, sce);
-                if (sce->tns.present)
-                    tns_mode = 1;
-                if (s->options.pns && s->coder->search_for_pns)
-                    s->coder->search_for_pns(s, avctx, sce);
-            }
-            s->cur_channel = start_ch;
-            if (s->options.intensity_stereo) { /* Intensity Stereo */
-                if (s->coder->search_for_is)
-                    s->coder->search_for_is(s, avctx, cpe);
-                if (cpe->is_mode) is_mode = 1;
-                apply_intensity_stereo(cpe);
-            }
-            if (s->options.pred) { /* Prediction */
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->search_for_pred)
-                        s->coder->search_for_pred(s, sce);
-                    if (cpe->ch[ch].ics.predictor_present) pred_mode = 1;
-                }
-                if (s->coder->adjust_common_pred)
-                    s->coder->adjust_common_pred(s, cpe);
-                for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->options.pred && s->coder->apply_main_pred)
-                        s->coder->apply_main_pred(s, sce);
-                }
-                s->cur_channel = start_ch;
-            }
-            if (s->options.mid_side) { /* Mid/Side stereo */
-                if (s->options.mid_side == -1 && s->coder->search_for_ms)
-                    s->coder->search_for_ms(s, cpe);
-                else if (cpe->common_window)
-                    memset(cpe->ms_mask, 1, sizeof(cpe->ms_mask));
-                apply_mid_side_stereo(cpe);
-            }
-            adjust_frame_information(cpe, chans);
-            if (s->options.ltp) { /* LTP */
+            start_ch += chans;
+        }
+
+        /* The psy model and the PNS search, which draws from one random
+         * sequence, have to see the elements in order, the rest of the
+         * coding of an element only depends on the element itself. */
+        for (i = 1; i < s->nb_jobs; i++) {
+            AACEncContext *js = s->job_ctx[i];
+            js->lambda      = s->lambda;
+            js->psy.bitres  = s->psy.bitres;
+        }
+        avctx->execute2(avctx, search_element_job, NULL, NULL, s->chan_map[0]);
+        if (s->options.pns && s->coder->search_for_pns) {
+            for (i = 0; i < s->chan_map[0]; i++) {
+                chans = s->chan_map[i+1] == TYPE_CPE ? 2 : 1;
+                cpe   = &s->cpe[i];
                 for (ch = 0; ch < chans; ch++) {
-                    sce = &cpe->ch[ch];
-                    s->cur_channel = start_ch + ch;
-                    if (s->coder->search_for_ltp)
-                        s->coder->search_for_ltp(s, sce, cpe->common_window);
-                    if (sce->ics.ltp.present) pred_mode = 1;
-                }
-                s->cur_channel = start_ch;
-                if (s->coder->adjust_common_ltp)
-                    s->coder->adjust_common_ltp(s, cpe);
-            }
-            if (chans == 2) {
-                put_bits(&s->pb, 1, cpe->common_window);
-                if (cpe->common_window) {
-                    put_ics_info(s, &cpe->ch[0].ics);
-                    if (s->coder->encode_main_pred)
-                        s->coder->encode_main_pred(s, &cpe->ch[0]);
-                    if (s->coder->encode_ltp_info)
-                        s->coder->encode_ltp_info(s, &cpe->ch[0], 1);
-                    encode_ms_info(&s->pb, cpe);
-                    if (cpe->ms_mode) ms_mode = 1;
+                    s->cur_channel = cpe->start_ch + ch;
+                    s->coder->search_for_pns(s, avctx, &cpe->ch[ch]);
                 }
             }
+        }
+        avctx->execute2(avctx, encode_element_job, NULL, NULL, s->chan_map[0]);
+
+        init_put_bits(&s->pb, avpkt->data, avpkt->size);
+
+        if ((avctx->frame_num & 0xFF)==1 && !(avctx->flags & AV_CODEC_FLAG_BITEXACT))
+            put_bitstream_info(s, LIBAVCODEC_IDENT);
+        memset(chan_el_counter, 0, sizeof(chan_el_counter));
+        for (i = 0; i < s->chan_map[0]; i++) {
+            tag      = s->chan_map[i+1];
+            chans    = tag == TYPE_CPE ? 2 : 1;
+            cpe      = &s->cpe[i];
+            put_bits(&s->pb, 3, tag);
+            put_bits(&s->pb, 4, chan_el_counter[tag]++);
+            ff_copy_bits(&s->pb, cpe->buf, cpe->bits);
+
             for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
-                encode_individual_channel(avctx, s, &cpe->ch[ch], cpe->common_window);
+                sce = &cpe->ch[ch];
+                if (sce->tns.present)
+                    tns_mode = 1;
+                if ((s->options.pred && sce->ics.predictor_present) ||
+                    (s->options.ltp  && sce->ics.ltp.present))
+                    pred_mode = 1;
             }
-            start_ch += chans;
+            if (s->options.intensity_stereo && cpe->is_mode)
+                is_mode = 1;
+            if (chans == 2 && cpe->common_window && cpe->ms_mode)
+                ms_mode = 1;
         }
 
         if (avctx->flags & AV_CODEC_FLAG_QSCALE) {
@@ -1189,6 +1282,16 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
 
     av_log(avctx, AV_LOG_INFO, "Qavg: %.3f\n", s->lambda_count ? s->lambda_sum / s->lambda_count : NAN);
 
+    if (s->job_ctx) {
+        for (int i = 1; i < s->nb_jobs; i++) {
+            if (!s->job_ctx[i])
+                continue;
+            ff_lpc_end(&s->job_ctx[i]->lpc);
+            av_freep(&s->job_ctx[i]);
+        }
+        av_freep(&s->job_ctx);
+    }
+
     av_tx_uninit(&s->mdct1024);
     av_tx_uninit(&s->mdct128);
     ff_psy_end(&s->psy);
@@ -1196,6 +1299,7 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
     if (s->psypp)
         ff_psy_preprocess_end(s->psypp);
     av_freep(&s->buffer.samples);
+    av_freep(&s->buffer.elements);
     av_freep(&s->cpe);
     av_freep(&s->fdsp);
     ff_af_queue_close(&s->afq);
@@ -1224,8 +1328,9 @@ static av_cold int dsp_init(AVCodecContext *avctx, AACEncContext *s)
 static av_cold int alloc_buffers(AVCodecContext *avctx, AACEncContext *s)
 {
     int ch;
-    if (!FF_ALLOCZ_TYPED_ARRAY(s->buffer.samples, s->channels * 3 * 1024) ||
-        !FF_ALLOCZ_TYPED_ARRAY(s->cpe,            s->chan_map[0]))
+    if (!FF_ALLOCZ_TYPED_ARRAY(s->buffer.samples,  s->channels * 3 * 1024) ||
+        !FF_ALLOCZ_TYPED_ARRAY(s->buffer.elements, s->channels * 8192)     ||
+        !FF_ALLOCZ_TYPED_ARRAY(s->cpe,             s->chan_map[0]))
         return AVERROR(ENOMEM);
 
     for(ch = 0; ch < s->channels; ch++)
@@ -1237,7 +1342,7 @@ static av_cold int alloc_buffers(AVCodecContext *avctx, AACEncContext *s)
 static av_cold int aac_encode_init(AVCodecContext *avctx)
 {
     AACEncContext *s = avctx->priv_data;
-    int i, ret = 0;
+    int i, start_ch, ret = 0;
     const uint8_t *sizes[2];
     uint8_t grouping[AAC_MAX_CHANNELS];
     int lengths[2];
@@ -1379,13 +1484,42 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
                            s->chan_map[0], grouping)) < 0)
         return ret;
     s->psypp = ff_psy_preprocess_init(avctx);
-    ff_lpc_init(&s->lpc, 2*avctx->frame_size, TNS_MAX_ORDER, FF_LPC_TYPE_LEVINSON);
+    if ((ret = ff_lpc_init(&s->lpc, 2*avctx->frame_size, TNS_MAX_ORDER, FF_LPC_TYPE_LEVINSON)) < 0)
+        return ret;
     s->random_state = 0x1f2e3d4c;
 
     ff_aacenc_dsp_init(&s->aacdsp);
 
     ff_af_queue_init(avctx, &s->afq);
 
+    for (i = 0, start_ch = 0; i < s->chan_map[0]; i++) {
+        ChannelElement *cpe = &s->cpe[i];
+        cpe->start_ch     = start_ch;
+        cpe->buf_size     = 8192 * (s->chan_map[i + 1] == TYPE_CPE ? 2 : 1);
+        cpe->buf          = s->buffer.elements + 8192 * start_ch;
+        start_ch += s->chan_map[i + 1] == TYPE_CPE ? 2 : 1;
+    }
+
+    /* Each job codes one channel element with its own copy of the context,
+     * which holds the scratch buffers of the coder. */
+    s->nb_jobs = avctx->active_thread_type & FF_THREAD_SLICE ?
+                 av_clip(avctx->thread_count, 1, s->chan_map[0]) : 1;
+    if (!(s->job_ctx = av_calloc(s->nb_jobs, sizeof(*s->job_ctx))))
+        return AVERROR(ENOMEM);
+    s->job_ctx[0] = s;
+    for (i = 1; i < s->nb_jobs; i++) {
+        AACEncContext *t = av_memdup(s, sizeof(*s));
+        if (!t)
+            return AVERROR(ENOMEM);
+        s->job_ctx[i] = t;
+
+        t->job_ctx = NULL;
+        memset(&t->lpc, 0, sizeof(t->lpc));
+        if ((ret = ff_lpc_init(&t->lpc, 2*avctx->frame_size, TNS_MAX_ORDER,
+                               FF_LPC_TYPE_LEVINSON)) < 0)
+            return ret;
+    }
+
     return 0;
 }
 
@@ -1424,7 +1558,8 @@ const FFCodec ff_aac_encoder = {
     .p.type         = AVMEDIA_TYPE_AUDIO,
     .p.id           = AV_CODEC_ID_AAC,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
-                      AV_CODEC_CAP_SMALL_LAST_FRAME,
+                      AV_CODEC_CAP_SMALL_LAST_FRAME |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .priv_data_size = sizeof(AACEncContext),
     .init           = aac_encode_init,
     FF_CODEC_ENCODE_CB(aac_encode_frame),
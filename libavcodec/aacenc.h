@@ -156,6 +156,12 @@ typedef struct ChannelElement {
     uint8_t is_mask[128];     ///< Set if intensity stereo is used
     // shared
     SingleChannelElement ch[2];
+    // encoder state, the elements of a frame are coded in parallel
+    int start_ch;             ///< index of the first channel of the element
+    int bitres_alloc;         ///< bits the psy model allocated to each channel
+    uint8_t *buf;             ///< coded element
+    int buf_size;             ///< size of buf in bytes
+    int bits;                 ///< size of the coded element in bits
 } ChannelElement;
 
 struct AACEncContext;
@@ -252,7 +258,11 @@ typedef struct AACEncContext {
 
     struct {
         float *samples;
+        uint8_t *elements;                       ///< buffers of the coded elements
     } buffer;
+
+    int nb_jobs;                                 ///< number of contexts the elements are coded with
+    struct AACEncContext **job_ctx;              ///< job_ctx[0] is the main context
 } AACEncContext;
 
 void ff_quantize_band_cost_cache_init(struct AACEncContext *s);
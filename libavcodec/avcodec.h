@@ -2086,6 +2086,16 @@ typedef struct AVCodecContext {
      */
     AVFrameSideData  **decoded_side_data;
     int             nb_decoded_side_data;
+
+    /**
+     * Allocation policy for the frame buffer pools of
+     * avcodec_default_get_buffer2(), a combination of AV_BUFFER_POOL_FLAG_*.
+     * See av_buffer_pool_set_flags().
+     *
+     * - encoding: unused
+     * - decoding: Set by user.
+     */
+    int buffer_pool_flags;
 } AVCodecContext;
 
 /**
@@ -129,6 +129,16 @@ typedef struct FlacEncodeContext {
 
     int flushed;
     int64_t next_pts;
+
+    /* frames encoded in parallel; job_ctx[0] is the main context */
+    int nb_jobs;
+    struct FlacEncodeContext **job_ctx;
+    AVFrame **job_frames;
+    AVPacket **job_pkts;
+    int *job_ret;
+    int nb_frames;          ///< number of frames in the current batch
+    int nb_packets;         ///< number of encoded packets in the current batch
+    int next_packet;        ///< index of the next packet to return
 } FlacEncodeContext;
 
 
@@ -466,13 +476,52 @@ static av_cold int flac_encode_init(AVCodecContext *avctx)
 
     ret = ff_lpc_init(&s->lpc_ctx, avctx->frame_size,
                       s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+    if (ret < 0)
+        return ret;
 
     ff_bswapdsp_init(&s->bdsp);
     ff_flacencdsp_init(&s->flac_dsp);
 
     dprint_compression_options(s);
 
-    return ret;
+    /* Once the blocksize is fixed, frames only depend on their own samples
+     * and the frame number, so several of them can be encoded at once. */
+    s->nb_jobs = avctx->active_thread_type & FF_THREAD_SLICE ?
+                 FFMAX(avctx->thread_count, 1) : 1;
+
+    s->job_ctx    = av_calloc(s->nb_jobs, sizeof(*s->job_ctx));
+    s->job_frames = av_calloc(s->nb_jobs, sizeof(*s->job_frames));
+    s->job_pkts   = av_calloc(s->nb_jobs, sizeof(*s->job_pkts));
+    s->job_ret    = av_calloc(s->nb_jobs, sizeof(*s->job_ret));
+    if (!s->job_ctx || !s->job_frames || !s->job_pkts || !s->job_ret)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < s->nb_jobs; i++) {
+        s->job_frames[i] = av_frame_alloc();
+        s->job_pkts[i]   = av_packet_alloc();
+        if (!s->job_frames[i] || !s->job_pkts[i])
+            return AVERROR(ENOMEM);
+    }
+
+    s->job_ctx[0] = s;
+    for (i = 1; i < s->nb_jobs; i++) {
+        FlacEncodeContext *t = av_memdup(s, sizeof(*s));
+        if (!t)
+            return AVERROR(ENOMEM);
+        s->job_ctx[i] = t;
+
+        /* the MD5 sum is updated by the main context only */
+        t->md5ctx          = NULL;
+        t->md5_buffer      = NULL;
+        t->md5_buffer_size = 0;
+        memset(&t->lpc_ctx, 0, sizeof(t->lpc_ctx));
+        ret = ff_lpc_init(&t->lpc_ctx, avctx->frame_size,
+                          s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
 }
 
 
@@ -1571,10 +1620,11 @@ static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
 }
 
 
-static int update_md5_sum(FlacEncodeContext *s, const void *samples)
+static int update_md5_sum(FlacEncodeContext *s, const void *samples,
+                          int nb_samples)
 {
     const uint8_t *buf;
-    int buf_size = s->frame.blocksize * s->channels *
+    int buf_size = nb_samples * s->channels *
                    ((s->avctx->bits_per_raw_sample + 7) / 8);
 
     if (s->avctx->bits_per_raw_sample > 16 || HAVE_BIGENDIAN) {
@@ -1595,7 +1645,7 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
         const int32_t *samples0 = samples;
         uint8_t *tmp            = s->md5_buffer;
 
-        for (i = 0; i < s->frame.blocksize * s->channels; i++) {
+        for (i = 0; i < nb_samples * s->channels; i++) {
             int32_t v = samples0[i] >> 8;
             AV_WL24(tmp + 3*i, v);
         }
@@ -1606,7 +1656,7 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
         const int32_t *samples0 = samples;
         uint8_t *tmp            = s->md5_buffer;
 
-        for (i = 0; i < s->frame.blocksize * s->channels; i++)
+        for (i = 0; i < nb_samples * s->channels; i++)
             AV_WL32(tmp + 4*i, samples0[i]);
         buf = s->md5_buffer;
     }
@@ -1616,41 +1666,17 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
 }
 
 
-static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
-                             const AVFrame *frame, int *got_packet_ptr)
+static int encode_frame_packet(FlacEncodeContext *s, AVPacket *avpkt,
+                               const AVFrame *frame)
 {
-    FlacEncodeContext *s;
+    int max_framesize = s->max_framesize;
     int frame_bytes, out_bytes, ret;
 
-    s = avctx->priv_data;
-
-    /* when the last block is reached, update the header in extradata */
-    if (!frame) {
-        s->max_framesize = s->max_encoded_framesize;
-        av_md5_final(s->md5ctx, s->md5sum);
-        write_streaminfo(s, avctx->extradata);
-
-        if (!s->flushed) {
-            uint8_t *side_data = av_packet_new_side_data(avpkt, AV_PKT_DATA_NEW_EXTRADATA,
-                                                         avctx->extradata_size);
-            if (!side_data)
-                return AVERROR(ENOMEM);
-            memcpy(side_data, avctx->extradata, avctx->extradata_size);
-
-            avpkt->pts = s->next_pts;
-
-            *got_packet_ptr = 1;
-            s->flushed = 1;
-        }
-
-        return 0;
-    }
-
     /* change max_framesize for small final frame */
-    if (frame->nb_samples < s->frame.blocksize) {
-        s->max_framesize = flac_get_max_frame_size(frame->nb_samples,
-                                                   s->channels,
-                                                   avctx->bits_per_raw_sample);
+    if (frame->nb_samples < s->max_blocksize) {
+        max_framesize = flac_get_max_frame_size(frame->nb_samples,
+                                                s->channels,
+                                                s->avctx->bits_per_raw_sample);
     }
 
     init_frame(s, frame->nb_samples);
@@ -1665,36 +1691,136 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 
     /* Fall back on verbatim mode if the compressed frame is larger than it
        would be if encoded uncompressed. */
-    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
+    if (frame_bytes < 0 || frame_bytes > max_framesize) {
         s->frame.verbatim_only = 1;
         frame_bytes = encode_frame(s);
         if (frame_bytes < 0) {
-            av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
+            av_log(s->avctx, AV_LOG_ERROR, "Bad frame count\n");
             return frame_bytes;
         }
     }
 
-    if ((ret = ff_get_encode_buffer(avctx, avpkt, frame_bytes, 0)) < 0)
+    if ((ret = ff_get_encode_buffer(s->avctx, avpkt, frame_bytes, 0)) < 0)
         return ret;
 
     out_bytes = write_frame(s, avpkt);
 
-    s->frame_count++;
-    s->sample_count += frame->nb_samples;
-    if ((ret = update_md5_sum(s, frame->data[0])) < 0) {
-        av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
-        return ret;
+    av_shrink_packet(avpkt, out_bytes);
+
+    return 0;
+}
+
+
+static int encode_frame_job(AVCodecContext *avctx, void *arg,
+                            int jobnr, int threadnr)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+
+    return encode_frame_packet(s->job_ctx[jobnr], s->job_pkts[jobnr],
+                               s->job_frames[jobnr]);
+}
+
+
+/**
+ * Encode the frames of the current batch in parallel, then do the
+ * bookkeeping which depends on the stream order.
+ */
+static int encode_batch(AVCodecContext *avctx)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    int i, ret;
+
+    for (i = 0; i < s->nb_frames; i++)
+        s->job_ctx[i]->frame_count = s->frame_count + i;
+
+    avctx->execute2(avctx, encode_frame_job, NULL, s->job_ret, s->nb_frames);
+
+    for (i = 0; i < s->nb_frames; i++) {
+        AVFrame  *frame = s->job_frames[i];
+        AVPacket *avpkt = s->job_pkts[i];
+        int out_bytes   = avpkt->size;
+
+        if (s->job_ret[i] < 0)
+            return s->job_ret[i];
+
+        s->sample_count += frame->nb_samples;
+        if ((ret = update_md5_sum(s, frame->data[0], frame->nb_samples)) < 0) {
+            av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
+            return ret;
+        }
+        if (out_bytes > s->max_encoded_framesize)
+            s->max_encoded_framesize = out_bytes;
+        if (out_bytes < s->min_framesize)
+            s->min_framesize = out_bytes;
+
+        avpkt->pts      = frame->pts;
+        avpkt->dts      = frame->pts;
+        avpkt->duration = frame->duration ? frame->duration :
+                          ff_samples_to_time_base(avctx, frame->nb_samples);
+        if ((ret = ff_encode_reordered_opaque(avctx, avpkt, frame)) < 0)
+            return ret;
+
+        s->next_pts = frame->pts + ff_samples_to_time_base(avctx, frame->nb_samples);
+
+        av_frame_unref(frame);
     }
-    if (out_bytes > s->max_encoded_framesize)
-        s->max_encoded_framesize = out_bytes;
-    if (out_bytes < s->min_framesize)
-        s->min_framesize = out_bytes;
 
-    s->next_pts = frame->pts + ff_samples_to_time_base(avctx, frame->nb_samples);
+    s->frame_count += s->nb_frames;
+    s->nb_packets   = s->nb_frames;
+    s->nb_frames    = 0;
+    s->next_packet  = 0;
 
-    av_shrink_packet(avpkt, out_bytes);
+    return 0;
+}
+
+
+static int flac_encode_receive_packet(AVCodecContext *avctx, AVPacket *avpkt)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    int ret;
+
+    if (s->next_packet < s->nb_packets) {
+        av_packet_move_ref(avpkt, s->job_pkts[s->next_packet++]);
+        return 0;
+    }
+
+    while (s->nb_frames < s->nb_jobs) {
+        ret = ff_encode_get_frame(avctx, s->job_frames[s->nb_frames]);
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret < 0)
+            return ret;
+        s->nb_frames++;
+    }
+
+    if (s->nb_frames) {
+        if ((ret = encode_batch(avctx)) < 0)
+            return ret;
+        av_packet_move_ref(avpkt, s->job_pkts[s->next_packet++]);
+        return 0;
+    }
+
+    if (s->flushed)
+        return AVERROR_EOF;
+
+    /* when the last block is reached, update the header in extradata */
+    s->max_framesize = s->max_encoded_framesize;
+    av_md5_final(s->md5ctx, s->md5sum);
+    write_streaminfo(s, avctx->extradata);
+
+    {
+        uint8_t *side_data = av_packet_new_side_data(avpkt, AV_PKT_DATA_NEW_EXTRADATA,
+                                                     avctx->extradata_size);
+        if (!side_data)
+            return AVERROR(ENOMEM);
+        memcpy(side_data, avctx->extradata, avctx->extradata_size);
+    }
+
+    avpkt->pts = s->next_pts;
+    avpkt->dts = s->next_pts;
+
+    s->flushed = 1;
 
-    *got_packet_ptr = 1;
     return 0;
 }
 
@@ -1703,6 +1829,24 @@ static av_cold int flac_encode_close(AVCodecContext *avctx)
 {
     FlacEncodeContext *s = avctx->priv_data;
 
+    if (s->job_ctx) {
+        for (int i = 1; i < s->nb_jobs; i++) {
+            if (s->job_ctx[i])
+                ff_lpc_end(&s->job_ctx[i]->lpc_ctx);
+            av_freep(&s->job_ctx[i]);
+        }
+    }
+    for (int i = 0; i < s->nb_jobs; i++) {
+        if (s->job_frames)
+            av_frame_free(&s->job_frames[i]);
+        if (s->job_pkts)
+            av_packet_free(&s->job_pkts[i]);
+    }
+    av_freep(&s->job_ctx);
+    av_freep(&s->job_frames);
+    av_freep(&s->job_pkts);
+    av_freep(&s->job_ret);
+
     av_freep(&s->md5ctx);
     av_freep(&s->md5_buffer);
     ff_lpc_end(&s->lpc_ctx);
@@ -1755,14 +1899,15 @@ const FFCodec ff_flac_encoder = {
     .p.id           = AV_CODEC_ID_FLAC,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
                       AV_CODEC_CAP_SMALL_LAST_FRAME |
+                      AV_CODEC_CAP_SLICE_THREADS |
                       AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE,
     .priv_data_size = sizeof(FlacEncodeContext),
     .init           = flac_encode_init,
-    FF_CODEC_ENCODE_CB(flac_encode_frame),
+    FF_CODEC_RECEIVE_PACKET_CB(flac_encode_receive_packet),
     .close          = flac_encode_close,
     .p.sample_fmts  = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_S16,
                                                      AV_SAMPLE_FMT_S32,
                                                      AV_SAMPLE_FMT_NONE },
     .p.priv_class   = &flac_encoder_class,
-    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP | FF_CODEC_CAP_EOF_FLUSH,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
 };
@@ -127,6 +127,7 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
                     ret = AVERROR(ENOMEM);
                     goto fail;
                 }
+                av_buffer_pool_set_flags(pool->pools[i], avctx->buffer_pool_flags);
             }
         }
         pool->format = frame->format;
@@ -147,6 +148,7 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
             ret = AVERROR(ENOMEM);
             goto fail;
         }
+        av_buffer_pool_set_flags(pool->pools[0], avctx->buffer_pool_flags);
 
         pool->format     = frame->format;
         pool->channels   = frame->ch_layout.nb_channels;
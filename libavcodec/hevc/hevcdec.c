@@ -34,6 +34,7 @@
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/stereo3d.h"
 #include "libavutil/timecode.h"
 
@@ -2830,6 +2831,14 @@ error:
     return ret;
 }
 
+static void hls_decode_entry_wpp_thread(void *priv, int jobnr, int threadnr,
+                                        int nb_jobs, int nb_threads)
+{
+    HEVCContext *s = priv;
+
+    s->wpp_ret[jobnr] = hls_decode_entry_wpp(s->avctx, s->local_ctx, jobnr, threadnr);
+}
+
 static int wpp_progress_init(HEVCContext *s, unsigned count)
 {
     if (s->nb_wpp_progress < count) {
@@ -2865,7 +2874,7 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     int *ret;
     int64_t offset;
     int64_t startheader, cmpt = 0;
-    int i, j, res = 0;
+    int i, j, nb_threads, res = 0;
 
     if (s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * sps->ctb_width >= sps->ctb_width * sps->ctb_height) {
         av_log(s->avctx, AV_LOG_ERROR, "WPP ctb addresses are wrong (%d %d %d %d)\n",
@@ -2875,8 +2884,19 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         return AVERROR_INVALIDDATA;
     }
 
-    if (s->avctx->thread_count > s->nb_local_ctx) {
-        HEVCLocalContext *tmp = av_malloc_array(s->avctx->thread_count, sizeof(*s->local_ctx));
+    /* With frame threading, the rows are decoded by threads of this frame
+     * thread's own, so that they can never wait for rows of other frames. */
+    if (s->avctx->active_thread_type == FF_THREAD_FRAME && !s->wpp_thread) {
+        res = avpriv_slicethread_create(&s->wpp_thread, s, hls_decode_entry_wpp_thread,
+                                        NULL, s->wpp_threads);
+        if (res < 0)
+            return res;
+        s->nb_wpp_threads = res;
+    }
+    nb_threads = s->wpp_thread ? s->nb_wpp_threads : s->avctx->thread_count;
+
+    if (nb_threads > s->nb_local_ctx) {
+        HEVCLocalContext *tmp = av_malloc_array(nb_threads, sizeof(*s->local_ctx));
 
         if (!tmp)
             return AVERROR(ENOMEM);
@@ -2885,7 +2905,7 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         av_free(s->local_ctx);
         s->local_ctx = tmp;
 
-        for (unsigned i = s->nb_local_ctx; i < s->avctx->thread_count; i++) {
+        for (unsigned i = s->nb_local_ctx; i < nb_threads; i++) {
             tmp = &s->local_ctx[i];
 
             memset(tmp, 0, sizeof(*tmp));
@@ -2895,7 +2915,7 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
             tmp->common_cabac_state = &s->cabac;
         }
 
-        s->nb_local_ctx = s->avctx->thread_count;
+        s->nb_local_ctx = nb_threads;
     }
 
     offset = s->sh.data_offset;
@@ -2948,8 +2968,14 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     if (!ret)
         return AVERROR(ENOMEM);
 
-    if (pps->entropy_coding_sync_enabled_flag)
-        s->avctx->execute2(s->avctx, hls_decode_entry_wpp, s->local_ctx, ret, s->sh.num_entry_point_offsets + 1);
+    if (pps->entropy_coding_sync_enabled_flag) {
+        if (s->wpp_thread) {
+            s->wpp_ret = ret;
+            avpriv_slicethread_execute(s->wpp_thread, s->sh.num_entry_point_offsets + 1, 0);
+            s->wpp_ret = NULL;
+        } else
+            s->avctx->execute2(s->avctx, hls_decode_entry_wpp, s->local_ctx, ret, s->sh.num_entry_point_offsets + 1);
+    }
 
     for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
         res += ret[i];
@@ -3004,7 +3030,8 @@ static int decode_slice_data(HEVCContext *s, const HEVCLayerContext *l,
     s->local_ctx[0].tu.cu_qp_offset_cb = 0;
     s->local_ctx[0].tu.cu_qp_offset_cr = 0;
 
-    if (s->avctx->active_thread_type == FF_THREAD_SLICE  &&
+    if ((s->avctx->active_thread_type == FF_THREAD_SLICE ||
+         (s->avctx->active_thread_type == FF_THREAD_FRAME && s->wpp_threads != 1)) &&
         s->sh.num_entry_point_offsets > 0                &&
         pps->num_tile_rows == 1 && pps->num_tile_columns == 1)
         return hls_slice_data_wpp(s, nal);
@@ -3858,6 +3885,7 @@ static av_cold int hevc_decode_free(AVCodecContext *avctx)
 
     ff_hevc_ps_uninit(&s->ps);
 
+    avpriv_slicethread_free(&s->wpp_thread);
     for (int i = 0; i < s->nb_wpp_progress; i++)
         ff_thread_progress_destroy(&s->wpp_progress[i]);
     av_freep(&s->wpp_progress);
@@ -4066,6 +4094,8 @@ static const AVOption options[] = {
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
     { "strict-displaywin", "stricly apply default display window size", OFFSET(apply_defdispwin),
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { "wpp_threads", "Number of threads decoding WPP rows in parallel within each frame thread, 0 for automatic",
+        OFFSET(wpp_threads), AV_OPT_TYPE_INT, {.i64 = 1}, 0, INT_MAX, PAR },
     { "view_ids", "Array of view IDs that should be decoded and output; a single -1 to decode all views",
         .offset = OFFSET(view_ids), .type = AV_OPT_TYPE_INT | AV_OPT_TYPE_FLAG_ARRAY,
         .min = -1, .max = INT_MAX, .flags = PAR },
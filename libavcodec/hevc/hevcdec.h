@@ -545,6 +545,14 @@ typedef struct HEVCContext {
 
     atomic_int wpp_err;
 
+    /**
+     * Threads decoding the WPP rows of a slice in parallel, when frame
+     * threading is used. Owned by each frame thread context.
+     */
+    struct AVSliceThread *wpp_thread;
+    int                   nb_wpp_threads;
+    int                  *wpp_ret;          ///< per-row results of the current slice
+
     const uint8_t *data;
 
     H2645Packet pkt;
@@ -557,6 +565,7 @@ typedef struct HEVCContext {
     int is_nalff;           ///< this flag is != 0 if bitstream is encapsulated
                             ///< as a format defined in 14496-15
     int apply_defdispwin;
+    int wpp_threads;        ///< AVOption, 1 disables WPP threads in frame threading
 
     // multi-layer AVOptions
     int         *view_ids;
@@ -412,6 +412,9 @@ static const AVOption avcodec_options[] = {
     {"mastering_display_metadata",  .default_val.i64 = AV_PKT_DATA_MASTERING_DISPLAY_METADATA,  .type = AV_OPT_TYPE_CONST, .flags = A|D, .unit = "side_data_pkt" },
     {"content_light_level",         .default_val.i64 = AV_PKT_DATA_CONTENT_LIGHT_LEVEL,         .type = AV_OPT_TYPE_CONST, .flags = A|D, .unit = "side_data_pkt" },
     {"icc_profile",                 .default_val.i64 = AV_PKT_DATA_ICC_PROFILE,                 .type = AV_OPT_TYPE_CONST, .flags = A|D, .unit = "side_data_pkt" },
+{"buffer_pool_flags", "set the allocation policy of decoded frame buffers", OFFSET(buffer_pool_flags), AV_OPT_TYPE_FLAGS, {.i64 = 0 }, 0, INT_MAX, V|A|D, .unit = "buffer_pool_flags"},
+{"hugepages", "use huge pages for large buffers", 0, AV_OPT_TYPE_CONST, {.i64 = AV_BUFFER_POOL_FLAG_HUGEPAGES }, INT_MIN, INT_MAX, V|A|D, .unit = "buffer_pool_flags"},
+{"numa", "allocate buffers on the NUMA node of the decoding thread", 0, AV_OPT_TYPE_CONST, {.i64 = AV_BUFFER_POOL_FLAG_NUMA_LOCAL }, INT_MIN, INT_MAX, V|A|D, .unit = "buffer_pool_flags"},
 {NULL},
 };
 
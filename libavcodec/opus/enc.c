@@ -243,14 +243,23 @@ static void celt_frame_mdct(OpusEncContext *s, CeltFrame *f)
             int band_size   = ff_celt_freq_range[i] << f->size;
             float *coeffs   = &block->coeffs[band_offset];
 
-            for (int j = 0; j < band_size; j++)
-                ener += coeffs[j]*coeffs[j];
+            /* From 10 ms on, all bands are aligned multiples of 4 coeffs */
+            if (f->size >= CELT_BLOCK_480) {
+                ener = s->dsp->scalarproduct_float(coeffs, coeffs, band_size);
+            } else {
+                for (int j = 0; j < band_size; j++)
+                    ener += coeffs[j]*coeffs[j];
+            }
 
             block->lin_energy[i] = sqrtf(ener) + FLT_EPSILON;
             ener = 1.0f/block->lin_energy[i];
 
-            for (int j = 0; j < band_size; j++)
-                coeffs[j] *= ener;
+            if (f->size >= CELT_BLOCK_480) {
+                s->dsp->vector_fmul_scalar(coeffs, coeffs, ener, band_size);
+            } else {
+                for (int j = 0; j < band_size; j++)
+                    coeffs[j] *= ener;
+            }
 
             block->energy[i] = log2f(block->lin_energy[i]) - ff_celt_mean_energy[i];
 
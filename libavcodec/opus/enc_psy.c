@@ -111,11 +111,12 @@ static void step_collect_psy_metrics(OpusPsyContext *s, int index)
 
     for (ch = 0; ch < s->avctx->ch_layout.nb_channels; ch++) {
         for (i = 0; i < CELT_MAX_BANDS; i++) {
-            float avg_c_s, energy = 0.0f, dist_dev = 0.0f;
+            float avg_c_s, energy, dist_dev = 0.0f;
             const int range = ff_celt_freq_range[i] << s->bsize_analysis;
             const float *coeffs = st->bands[ch][i];
-            for (j = 0; j < range; j++)
-                energy += coeffs[j]*coeffs[j];
+            /* The analysis uses 20 ms blocks, so all the bands are aligned
+             * multiples of 8 coeffs */
+            energy = s->dsp->scalarproduct_float(coeffs, coeffs, range);
 
             st->energy[ch][i] += sqrtf(energy);
             silence |= !!st->energy[ch][i];
@@ -40,7 +40,7 @@ typedef struct OpusPsyStep {
     float total_change; /* Total change */
 
     float *bands[OPUS_MAX_CHANNELS][CELT_MAX_BANDS];
-    float coeffs[OPUS_MAX_CHANNELS][OPUS_BLOCK_SIZE(CELT_BLOCK_960)];
+    DECLARE_ALIGNED(32, float, coeffs)[OPUS_MAX_CHANNELS][OPUS_BLOCK_SIZE(CELT_BLOCK_960)];
 } OpusPsyStep;
 
 typedef struct OpusBandExcitation {
@@ -44,6 +44,7 @@
 #include "pngdsp.h"
 #include "progressframe.h"
 #include "thread.h"
+#include "threadprogress.h"
 #include "zlib_wrapper.h"
 
 #include <zlib.h>
@@ -125,6 +126,17 @@ typedef struct PNGDecContext {
     int pass_row_size; /* decompress row size of the current pass */
     int y;
     FFZStream zstream;
+
+    // slice threading
+    int pipeline;                ///< inflate and unfilter rows in parallel
+    ThreadProgress rows_inflated;
+    atomic_int rows_avail;       ///< number of rows inflated in total
+    uint8_t *ring;               ///< inflated rows waiting to be unfiltered
+    unsigned int ring_size;
+    int ring_stride;
+    GetByteContext *idat;        ///< consecutive IDAT chunks
+    unsigned int idat_size;
+    int nb_idat;
 } PNGDecContext;
 
 /* Mask to determine which pixels are valid in a pass */
@@ -474,6 +486,128 @@ static int png_decode_idat(PNGDecContext *s, GetByteContext *gb,
     return 0;
 }
 
+/* minimum image height for the pipeline to be used */
+#define PIPELINE_MIN_ROWS 16
+
+static int inflate_rows(PNGDecContext *s)
+{
+    z_stream *const zstream = &s->zstream.zstream;
+    int y = 0, ret = 0;
+
+    for (int i = 0; i < s->nb_idat && y < s->cur_h; i++) {
+        zstream->avail_in = bytestream2_get_bytes_left(&s->idat[i]);
+        zstream->next_in  = s->idat[i].buffer;
+
+        while (zstream->avail_in > 0 && y < s->cur_h) {
+            int zret = inflate(zstream, Z_PARTIAL_FLUSH);
+            if (zret != Z_OK && zret != Z_STREAM_END) {
+                av_log(s->avctx, AV_LOG_ERROR, "inflate returned error %d\n", zret);
+                ret = AVERROR_EXTERNAL;
+                goto end;
+            }
+            if (zstream->avail_out == 0) {
+                ff_thread_progress_report(&s->rows_inflated, ++y);
+                zstream->avail_out = s->crow_size;
+                zstream->next_out  = s->ring + y * s->ring_stride + 15;
+            }
+            if (zret == Z_STREAM_END) {
+                if (zstream->avail_in > 0)
+                    av_log(s->avctx, AV_LOG_WARNING,
+                           "%d undecompressed bytes left in buffer\n", zstream->avail_in);
+                goto end;
+            }
+        }
+    }
+
+end:
+    atomic_store(&s->rows_avail, y);
+    ff_thread_progress_report(&s->rows_inflated, INT_MAX);
+    return ret;
+}
+
+static void unfilter_rows(PNGDecContext *s, AVFrame *p)
+{
+    while (s->y < s->cur_h) {
+        const int y = s->y;
+        ff_thread_progress_await(&s->rows_inflated, y + 1);
+        if (y >= atomic_load(&s->rows_avail))
+            break;
+        s->crow_buf = s->ring + y * s->ring_stride + 15;
+        png_handle_row(s, p->data[0], p->linesize[0]);
+    }
+}
+
+static int decode_idat_job(AVCodecContext *avctx, void *arg,
+                           int jobnr, int threadnr)
+{
+    PNGDecContext *s = avctx->priv_data;
+
+    if (jobnr)
+        unfilter_rows(s, arg);
+    else
+        return inflate_rows(s);
+    return 0;
+}
+
+/**
+ * Decode the image data of a non-interlaced image starting with the IDAT
+ * chunk in gb, inflating the rows in one thread and unfiltering them in
+ * another one. All the IDAT chunks following this one are consumed from
+ * s->gb.
+ *
+ * The rows are inflated into a buffer holding the whole image, so that the
+ * inflating job never waits for the unfiltering one and the jobs also
+ * complete when execute2() runs them one after the other.
+ */
+static int png_decode_idat_pipelined(PNGDecContext *s, GetByteContext *gb,
+                                     AVFrame *p)
+{
+    z_stream *const zstream = &s->zstream.zstream;
+    int ret[2], len;
+
+    s->nb_idat = 0;
+    while (1) {
+        GetByteContext *idat = av_fast_realloc(s->idat, &s->idat_size,
+                                               (s->nb_idat + 1) * sizeof(*s->idat));
+        uint32_t length;
+
+        if (!idat)
+            return AVERROR(ENOMEM);
+        s->idat = idat;
+        s->idat[s->nb_idat++] = *gb;
+
+        if (bytestream2_get_bytes_left(&s->gb) < 12)
+            break;
+        length = AV_RB32(s->gb.buffer);
+        if (length > 0x7fffffff ||
+            length + 12 > bytestream2_get_bytes_left(&s->gb) ||
+            AV_RL32(s->gb.buffer + 4) != MKTAG('I', 'D', 'A', 'T'))
+            break;
+        bytestream2_init(gb, s->gb.buffer + 8, length);
+        bytestream2_skip(&s->gb, length + 12);
+    }
+
+    s->ring_stride = FFALIGN(s->crow_size + 15, 16);
+    av_fast_padded_malloc(&s->ring, &s->ring_size, (s->cur_h + 1) * s->ring_stride);
+    if (!s->ring)
+        return AVERROR(ENOMEM);
+
+    zstream->avail_out = s->crow_size;
+    zstream->next_out  = s->ring + 15;
+    atomic_store(&s->rows_avail, INT_MAX);
+    ff_thread_progress_reset(&s->rows_inflated);
+
+    s->avctx->execute2(s->avctx, decode_idat_job, p, ret, 2);
+
+    /* keep an incomplete row for the following chunks */
+    len = s->crow_size - zstream->avail_out;
+    s->crow_buf = s->buffer + 15;
+    memcpy(s->crow_buf, zstream->next_out - len, len);
+    zstream->next_out = s->crow_buf + len;
+
+    return ret[0];
+}
+
 static int decode_zbuf(AVBPrint *bp, const uint8_t *data,
                        const uint8_t *data_end, void *logctx)
 {
@@ -791,7 +925,7 @@ static int populate_avctx_color_fields(AVCodecContext *avctx, AVFrame *frame)
 static int decode_idat_chunk(AVCodecContext *avctx, PNGDecContext *s,
                              GetByteContext *gb, AVFrame *p)
 {
-    int ret;
+    int ret, pipelined = 0;
     size_t byte_depth = s->bit_depth > 8 ? 2 : 1;
 
     if (!p)
@@ -945,6 +1079,13 @@ static int decode_idat_chunk(AVCodecContext *avctx, PNGDecContext *s,
         s->crow_buf          = s->buffer + 15;
         s->zstream.zstream.avail_out = s->crow_size;
         s->zstream.zstream.next_out  = s->crow_buf;
+
+        /* chunk CRCs are checked in the main loop of decode_frame_common() */
+        pipelined = s->pipeline && !s->interlace_type &&
+                    avctx->codec_id == AV_CODEC_ID_PNG &&
+                    s->cur_h > PIPELINE_MIN_ROWS &&
+                    (int64_t)(s->cur_h + 1) * (s->crow_size + 31) < INT_MAX / 2 &&
+                    !(avctx->err_recognition & (AV_EF_CRCCHECK | AV_EF_IGNORE_ERR));
     }
 
     s->pic_state |= PNG_IDAT;
@@ -953,7 +1094,10 @@ static int decode_idat_chunk(AVCodecContext *avctx, PNGDecContext *s,
     if (s->has_trns && s->color_type != PNG_COLOR_TYPE_PALETTE)
         s->bpp -= byte_depth;
 
-    ret = png_decode_idat(s, gb, p->data[0], p->linesize[0]);
+    if (pipelined)
+        ret = png_decode_idat_pipelined(s, gb, p);
+    else
+        ret = png_decode_idat(s, gb, p->data[0], p->linesize[0]);
 
     if (s->has_trns && s->color_type != PNG_COLOR_TYPE_PALETTE)
         s->bpp += byte_depth;
@@ -1895,6 +2039,13 @@ static av_cold int png_dec_init(AVCodecContext *avctx)
 
     ff_pngdsp_init(&s->dsp);
 
+    if (avctx->active_thread_type & FF_THREAD_SLICE && avctx->thread_count > 1) {
+        int ret;
+        s->pipeline = 1;
+        if ((ret = ff_thread_progress_init(&s->rows_inflated, 1)) < 0)
+            return ret;
+    }
+
     return ff_inflate_init(&s->zstream, avctx);
 }
 
@@ -1910,6 +2061,11 @@ static av_cold int png_dec_end(AVCodecContext *avctx)
     s->last_row_size = 0;
     av_freep(&s->tmp_row);
     s->tmp_row_size = 0;
+    av_freep(&s->ring);
+    s->ring_size = 0;
+    av_freep(&s->idat);
+    s->idat_size = 0;
+    ff_thread_progress_destroy(&s->rows_inflated);
 
     av_freep(&s->iccp_data);
     av_dict_free(&s->frame_metadata);
@@ -1947,7 +2103,8 @@ const FFCodec ff_png_decoder = {
     .close          = png_dec_end,
     FF_CODEC_DECODE_CB(decode_frame_png),
     UPDATE_THREAD_CONTEXT(update_thread_context),
-    .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS,
+    .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .caps_internal  = FF_CODEC_CAP_SKIP_FRAME_FILL_PARAM |
                       FF_CODEC_CAP_INIT_CLEANUP |
                       FF_CODEC_CAP_USES_PROGRESSFRAMES |
@@ -50,6 +50,18 @@ typedef struct APNGFctlChunk {
     uint8_t dispose_op, blend_op;
 } APNGFctlChunk;
 
+/* band of rows deflated by one job when slice threading is used */
+typedef struct PNGEncBand {
+    FFZStream zstream;           ///< raw deflate stream
+    uint8_t *crow_base;          ///< filtering scratch buffer
+    unsigned int crow_base_size;
+    uint8_t *out;
+    unsigned int out_size;
+    int out_len;
+    uLong adler;                 ///< Adler-32 of the filtered rows of the band
+    int start, end;              ///< rows of the band
+} PNGEncBand;
+
 typedef struct PNGEncContext {
     AVClass *class;
     LLVidEncDSPContext llvidencdsp;
@@ -82,6 +94,16 @@ typedef struct PNGEncContext {
     APNGFctlChunk last_frame_fctl;
     uint8_t *last_frame_packet;
     size_t last_frame_packet_size;
+
+    // slice threading
+    int compression_level;
+    int nb_bands;                ///< maximum number of bands
+    PNGEncBand *bands;
+    uint8_t *filtered;           ///< filtered rows of the whole image
+    unsigned int filtered_size;
+    int *band_ret;
+    const AVFrame *band_frame;   ///< frame being coded in bands
+    int band_row_size;
 } PNGEncContext;
 
 static void png_get_interlaced_row(uint8_t *dst, int row_size,
@@ -506,6 +528,154 @@ static int encode_headers(AVCodecContext *avctx, const AVFrame *pict)
     return 0;
 }
 
+/* minimum amount of filtered data per band */
+#define MIN_BAND_SIZE (1 << 16)
+
+static int filter_band_job(AVCodecContext *avctx, void *arg,
+                           int jobnr, int threadnr)
+{
+    PNGEncContext *s       = avctx->priv_data;
+    const PNGEncBand *band = &s->bands[jobnr];
+    const AVFrame *p       = s->band_frame;
+    const int row_size     = s->band_row_size;
+    // pixel data should be aligned, but there's a control byte before it
+    uint8_t *crow_buf      = band->crow_base + 15;
+
+    for (int y = band->start; y < band->end; y++) {
+        const uint8_t *ptr = p->data[0] + y * p->linesize[0];
+        const uint8_t *top = y ? ptr - p->linesize[0] : NULL;
+        const uint8_t *crow = png_choose_filter(s, crow_buf, ptr, top,
+                                                row_size, s->bits_per_pixel >> 3);
+        memcpy(s->filtered + (size_t)y * (row_size + 1), crow, row_size + 1);
+    }
+    return 0;
+}
+
+static int deflate_band_job(AVCodecContext *avctx, void *arg,
+                            int jobnr, int threadnr)
+{
+    PNGEncContext *s        = avctx->priv_data;
+    PNGEncBand *band        = &s->bands[jobnr];
+    z_stream *const zstream = &band->zstream.zstream;
+    const size_t crow_size  = s->band_row_size + 1;
+    const uint8_t *data     = s->filtered + band->start * crow_size;
+    const size_t size       = (band->end - band->start) * crow_size;
+    const int last          = band->end == s->band_frame->height;
+    int ret;
+
+    deflateReset(zstream);
+    /* Start with the window of the previous band, as pigz does, so that
+     * splitting the image costs almost no compression. */
+    if (band->start) {
+        size_t dict_size = FFMIN(band->start * crow_size, 32768);
+        if (deflateSetDictionary(zstream, data - dict_size, dict_size) != Z_OK)
+            return AVERROR_EXTERNAL;
+    }
+
+    zstream->next_in   = data;
+    zstream->avail_in  = size;
+    zstream->next_out  = band->out;
+    zstream->avail_out = band->out_size;
+    /* The sync flush ends the band on a byte boundary without ending the
+     * deflate stream, so the bands can simply be concatenated. */
+    ret = deflate(zstream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (ret != (last ? Z_STREAM_END : Z_OK) ||
+        zstream->avail_in || !zstream->avail_out)
+        return AVERROR_EXTERNAL;
+
+    band->out_len = band->out_size - zstream->avail_out;
+    band->adler   = adler32(adler32(0, NULL, 0), data, size);
+
+    return 0;
+}
+
+/* write image data in IDAT chunks of IOBUF_SIZE bytes, like png_write_row() */
+static void png_write_image_data_buffered(AVCodecContext *avctx, int *pos,
+                                          const uint8_t *data, int size)
+{
+    PNGEncContext *s = avctx->priv_data;
+
+    while (size > 0) {
+        int len = FFMIN(size, IOBUF_SIZE - *pos);
+        memcpy(s->buf + *pos, data, len);
+        *pos += len;
+        data += len;
+        size -= len;
+        if (*pos == IOBUF_SIZE) {
+            if (s->bytestream_end - s->bytestream > IOBUF_SIZE + 100)
+                png_write_image_data(avctx, s->buf, IOBUF_SIZE);
+            *pos = 0;
+        }
+    }
+}
+
+/**
+ * Filter and deflate bands of rows in parallel and join them into a single
+ * zlib stream.
+ */
+static int encode_frame_bands(AVCodecContext *avctx, const AVFrame *pict,
+                              int nb_bands)
+{
+    PNGEncContext *s       = avctx->priv_data;
+    const int row_size     = (pict->width * s->bits_per_pixel + 7) >> 3;
+    const size_t crow_size = row_size + 1;
+    const int level        = s->compression_level == Z_DEFAULT_COMPRESSION ?
+                             6 : s->compression_level;
+    unsigned header;
+    uint8_t buf[4];
+    uLong adler;
+    int i, pos = 0;
+
+    av_fast_malloc(&s->filtered, &s->filtered_size, pict->height * crow_size);
+    if (!s->filtered)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < nb_bands; i++) {
+        PNGEncBand *band = &s->bands[i];
+        band->start = (int64_t)pict->height *  i      / nb_bands;
+        band->end   = (int64_t)pict->height * (i + 1) / nb_bands;
+        av_fast_malloc(&band->crow_base, &band->crow_base_size,
+                       (row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
+        av_fast_malloc(&band->out, &band->out_size,
+                       deflateBound(&band->zstream.zstream,
+                                    (band->end - band->start) * crow_size) + 64);
+        if (!band->crow_base || !band->out)
+            return AVERROR(ENOMEM);
+    }
+
+    s->band_frame    = pict;
+    s->band_row_size = row_size;
+    avctx->execute2(avctx, filter_band_job, NULL, NULL, nb_bands);
+    avctx->execute2(avctx, deflate_band_job, NULL, s->band_ret, nb_bands);
+    for (i = 0; i < nb_bands; i++)
+        if (s->band_ret[i] < 0) {
+            av_log(avctx, AV_LOG_ERROR, "deflate error\n");
+            return s->band_ret[i];
+        }
+
+    /* the zlib header deflate() writes for the same parameters */
+    header  = (Z_DEFLATED + ((MAX_WBITS - 8) << 4)) << 8;
+    header |= (level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6;
+    header += 31 - header % 31;
+    AV_WB16(buf, header);
+    png_write_image_data_buffered(avctx, &pos, buf, 2);
+
+    adler = adler32(0, NULL, 0);
+    for (i = 0; i < nb_bands; i++) {
+        const PNGEncBand *band = &s->bands[i];
+        png_write_image_data_buffered(avctx, &pos, band->out, band->out_len);
+        adler = adler32_combine(adler, band->adler,
+                                (band->end - band->start) * crow_size);
+    }
+    AV_WB32(buf, adler);
+    png_write_image_data_buffered(avctx, &pos, buf, 4);
+
+    if (pos > 0 && s->bytestream_end - s->bytestream > pos + 100)
+        png_write_image_data(avctx, s->buf, pos);
+
+    return 0;
+}
+
 static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
 {
     PNGEncContext *s       = avctx->priv_data;
@@ -520,6 +690,13 @@ static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
 
     row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
 
+    if (!s->is_progressive && s->nb_bands > 1) {
+        int nb_bands = FFMIN3(s->nb_bands, pict->height,
+                              (int64_t)pict->height * (row_size + 1) / MIN_BAND_SIZE);
+        if (nb_bands > 1)
+            return encode_frame_bands(avctx, pict, nb_bands);
+    }
+
     crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
     if (!crow_base) {
         ret = AVERROR(ENOMEM);
@@ -1103,7 +1280,7 @@ static int encode_apng(AVCodecContext *avctx, AVPacket *pkt,
 static av_cold int png_enc_init(AVCodecContext *avctx)
 {
     PNGEncContext *s = avctx->priv_data;
-    int compression_level;
+    int compression_level, ret;
 
     switch (avctx->pix_fmt) {
     case AV_PIX_FMT_RGBA:
@@ -1184,7 +1361,29 @@ static av_cold int png_enc_init(AVCodecContext *avctx)
     compression_level = avctx->compression_level == FF_COMPRESSION_DEFAULT
                       ? Z_DEFAULT_COMPRESSION
                       : av_clip(avctx->compression_level, 0, 9);
-    return ff_deflate_init(&s->zstream, compression_level, avctx);
+    ret = ff_deflate_init(&s->zstream, compression_level, avctx);
+    if (ret < 0)
+        return ret;
+
+    /* With slice threading, bands of rows of non-interlaced images are
+     * compressed in parallel. */
+    s->compression_level = compression_level;
+    s->nb_bands = avctx->active_thread_type & FF_THREAD_SLICE ?
+                  FFMAX(avctx->thread_count, 1) : 1;
+    if (s->nb_bands > 1) {
+        s->bands    = av_calloc(s->nb_bands, sizeof(*s->bands));
+        s->band_ret = av_calloc(s->nb_bands, sizeof(*s->band_ret));
+        if (!s->bands || !s->band_ret)
+            return AVERROR(ENOMEM);
+        for (int i = 0; i < s->nb_bands; i++) {
+            ret = ff_deflate_init2(&s->bands[i].zstream, compression_level,
+                                   -MAX_WBITS, avctx);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    return 0;
 }
 
 static av_cold int png_enc_close(AVCodecContext *avctx)
@@ -1192,6 +1391,16 @@ static av_cold int png_enc_close(AVCodecContext *avctx)
     PNGEncContext *s = avctx->priv_data;
 
     ff_deflate_end(&s->zstream);
+    if (s->bands) {
+        for (int i = 0; i < s->nb_bands; i++) {
+            ff_deflate_end(&s->bands[i].zstream);
+            av_freep(&s->bands[i].crow_base);
+            av_freep(&s->bands[i].out);
+        }
+        av_freep(&s->bands);
+    }
+    av_freep(&s->band_ret);
+    av_freep(&s->filtered);
     av_frame_free(&s->last_frame);
     av_frame_free(&s->prev_frame);
     av_freep(&s->last_frame_packet);
@@ -1228,6 +1437,7 @@ const FFCodec ff_png_encoder = {
     .p.type         = AVMEDIA_TYPE_VIDEO,
     .p.id           = AV_CODEC_ID_PNG,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS |
+                      AV_CODEC_CAP_SLICE_THREADS |
                       AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE,
     .priv_data_size = sizeof(PNGEncContext),
     .init           = png_enc_init,
@@ -1242,7 +1452,7 @@ const FFCodec ff_png_encoder = {
         AV_PIX_FMT_MONOBLACK, AV_PIX_FMT_NONE
     },
     .p.priv_class   = &pngenc_class,
-    .caps_internal  = FF_CODEC_CAP_ICC_PROFILES,
+    .caps_internal  = FF_CODEC_CAP_ICC_PROFILES | FF_CODEC_CAP_INIT_CLEANUP,
 };
 
 const FFCodec ff_apng_encoder = {
@@ -1251,6 +1461,7 @@ const FFCodec ff_apng_encoder = {
     .p.type         = AVMEDIA_TYPE_VIDEO,
     .p.id           = AV_CODEC_ID_APNG,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS |
                       AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE,
     .priv_data_size = sizeof(PNGEncContext),
     .init           = png_enc_init,
@@ -1265,5 +1476,5 @@ const FFCodec ff_apng_encoder = {
         AV_PIX_FMT_NONE
     },
     .p.priv_class   = &pngenc_class,
-    .caps_internal  = FF_CODEC_CAP_ICC_PROFILES,
+    .caps_internal  = FF_CODEC_CAP_ICC_PROFILES | FF_CODEC_CAP_INIT_CLEANUP,
 };
@@ -92,6 +92,28 @@ int ff_deflate_init(FFZStream *z, int level, void *logctx)
     return 0;
 }
 
+int ff_deflate_init2(FFZStream *z, int level, int window_bits, void *logctx)
+{
+    z_stream *const zstream = &z->zstream;
+    int zret;
+
+    z->inited = 0;
+    zstream->zalloc = alloc_wrapper;
+    zstream->zfree  = free_wrapper;
+    zstream->opaque = Z_NULL;
+
+    zret = deflateInit2(zstream, level, Z_DEFLATED, window_bits,
+                        8, Z_DEFAULT_STRATEGY);
+    if (zret == Z_OK) {
+        z->inited = 1;
+    } else {
+        av_log(logctx, AV_LOG_ERROR, "deflateInit2 error %d, message: %s\n",
+               zret, zstream->msg ? zstream->msg : "");
+        return AVERROR_EXTERNAL;
+    }
+    return 0;
+}
+
 void ff_deflate_end(FFZStream *z)
 {
     if (z->inited) {
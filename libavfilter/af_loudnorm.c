@@ -64,6 +64,7 @@ typedef struct LoudNormContext {
     int linear;
     int dual_mono;
     enum PrintFormat print_format;
+    int measure_only;
 
     double *buf;
     int buf_size;
@@ -95,6 +96,16 @@ typedef struct LoudNormContext {
 
     FFEBUR128State *r128_in;
     FFEBUR128State *r128_out;
+
+    /* measure_only with several threads: the input is analysed in chunks,
+     * each one preceded by the preroll audio of the previous chunk */
+    FFEBUR128State **r128_chunks;
+    double *measure_buf;
+    int measure_jobs;
+    int chunk_size;
+    int preroll_size;
+    int measure_nb_samples;
+    int have_preroll;
 } LoudNormContext;
 
 #define OFFSET(x) offsetof(LoudNormContext, x)
@@ -117,6 +128,7 @@ static const AVOption loudnorm_options[] = {
     { "offset",           "set offset gain",                   OFFSET(offset),           AV_OPT_TYPE_DOUBLE,  {.dbl =  0.},    -99.,       99.,  FLAGS },
     { "linear",           "normalize linearly if possible",    OFFSET(linear),           AV_OPT_TYPE_BOOL,    {.i64 =  1},        0,         1,  FLAGS },
     { "dual_mono",        "treat mono input as dual-mono",     OFFSET(dual_mono),        AV_OPT_TYPE_BOOL,    {.i64 =  0},        0,         1,  FLAGS },
+    { "measure_only",     "only measure the input loudness",   OFFSET(measure_only),     AV_OPT_TYPE_BOOL,    {.i64 =  0},        0,         1,  FLAGS },
     { "print_format",     "set print format for stats",        OFFSET(print_format),     AV_OPT_TYPE_INT,     {.i64 =  NONE},  NONE,  PF_NB -1,  FLAGS, .unit = "print_format" },
     {     "none",         0,                                   0,                        AV_OPT_TYPE_CONST,   {.i64 =  NONE},     0,         0,  FLAGS, .unit = "print_format" },
     {     "json",         0,                                   0,                        AV_OPT_TYPE_CONST,   {.i64 =  JSON},     0,         0,  FLAGS, .unit = "print_format" },
@@ -441,7 +453,10 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     buf = s->buf;
     limiter_buf = s->limiter_buf;
 
-    ff_ebur128_add_frames_double(s->r128_in, src, in->nb_samples);
+    /* the final frame is taken from the lookahead buffer, whose samples
+     * were already measured when they came in */
+    if (s->frame_type != FINAL_FRAME)
+        ff_ebur128_add_frames_double(s->r128_in, src, in->nb_samples);
 
     if (s->frame_type == FIRST_FRAME && in->nb_samples < frame_size(inlink->sample_rate, 3000)) {
         double offset, offset_tp, true_peak;
@@ -675,6 +690,99 @@ static int flush_frame(AVFilterLink *outlink)
     return ret;
 }
 
+static int measure_chunk(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    LoudNormContext *s = ctx->priv;
+    const int start = jobnr * s->chunk_size;
+    const int nb_samples = FFMIN(s->chunk_size, s->measure_nb_samples - start);
+    const double *src = s->measure_buf + (s->preroll_size + start) * s->channels;
+    FFEBUR128State *r128;
+
+    r128 = ff_ebur128_init(s->channels, ctx->inputs[0]->sample_rate, 0,
+                           FF_EBUR128_MODE_I | FF_EBUR128_MODE_S | FF_EBUR128_MODE_LRA | FF_EBUR128_MODE_SAMPLE_PEAK);
+    if (!r128)
+        return AVERROR(ENOMEM);
+    if (s->channels == 1 && s->dual_mono)
+        ff_ebur128_set_channel(r128, 0, FF_EBUR128_DUAL_MONO);
+
+    /* Feed the preroll and drop the blocks it produced, those ending inside
+     * it belong to the previous chunk. The chunk and preroll sizes are
+     * multiples of the 3 s window of the state, so both the gating blocks and
+     * the position in its history buffer line up with a sequential run. */
+    if (start > 0 || s->have_preroll) {
+        ff_ebur128_add_frames_double(r128, src - s->preroll_size * s->channels, s->preroll_size);
+        ff_ebur128_reset_histograms(r128);
+    }
+    ff_ebur128_add_frames_double(r128, src, nb_samples);
+
+    s->r128_chunks[jobnr] = r128;
+    return 0;
+}
+
+static int measure_flush(AVFilterContext *ctx)
+{
+    LoudNormContext *s = ctx->priv;
+    const int nb_jobs = (s->measure_nb_samples + s->chunk_size - 1) / s->chunk_size;
+    int ret = 0;
+
+    if (!nb_jobs)
+        return 0;
+
+    ff_filter_execute(ctx, measure_chunk, NULL, NULL, nb_jobs);
+
+    for (int i = 0; i < nb_jobs; i++) {
+        if (!s->r128_chunks[i]) {
+            ret = AVERROR(ENOMEM);
+            continue;
+        }
+        ff_ebur128_merge(s->r128_in, s->r128_chunks[i]);
+        ff_ebur128_destroy(&s->r128_chunks[i]);
+    }
+
+    if (s->measure_nb_samples >= s->preroll_size) {
+        memmove(s->measure_buf, s->measure_buf + s->measure_nb_samples * s->channels,
+                s->preroll_size * s->channels * sizeof(*s->measure_buf));
+        s->have_preroll = 1;
+    }
+    s->measure_nb_samples = 0;
+
+    return ret;
+}
+
+static int measure_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx = inlink->dst;
+    LoudNormContext *s = ctx->priv;
+    const double *src = (const double *)in->data[0];
+    const int buf_samples = s->measure_jobs * s->chunk_size;
+    int nb_samples = in->nb_samples;
+
+    if (s->measure_jobs <= 1) {
+        ff_ebur128_add_frames_double(s->r128_in, src, nb_samples);
+        return ff_filter_frame(ctx->outputs[0], in);
+    }
+
+    while (nb_samples > 0) {
+        const int n = FFMIN(nb_samples, buf_samples - s->measure_nb_samples);
+
+        memcpy(s->measure_buf + (s->preroll_size + s->measure_nb_samples) * s->channels,
+               src, n * s->channels * sizeof(*src));
+        src += n * s->channels;
+        nb_samples -= n;
+        s->measure_nb_samples += n;
+
+        if (s->measure_nb_samples == buf_samples) {
+            int ret = measure_flush(ctx);
+            if (ret < 0) {
+                av_frame_free(&in);
+                return ret;
+            }
+        }
+    }
+
+    return ff_filter_frame(ctx->outputs[0], in);
+}
+
 static int activate(AVFilterContext *ctx)
 {
     AVFilterLink *inlink = ctx->inputs[0];
@@ -686,7 +794,7 @@ static int activate(AVFilterContext *ctx)
 
     FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
 
-    if (s->frame_type != LINEAR_MODE) {
+    if (s->frame_type != LINEAR_MODE && !s->measure_only) {
         int nb_samples;
 
         if (s->frame_type == FIRST_FRAME) {
@@ -702,7 +810,9 @@ static int activate(AVFilterContext *ctx)
 
     if (ret < 0)
         return ret;
-    if (ret > 0) {
+    if (ret > 0 && s->measure_only) {
+        ret = measure_frame(inlink, in);
+    } else if (ret > 0) {
         if (s->frame_type == FIRST_FRAME) {
             const int nb_samples = frame_size(inlink->sample_rate, 100);
 
@@ -719,6 +829,11 @@ static int activate(AVFilterContext *ctx)
         return ret;
 
     if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        if (s->measure_buf) {
+            ret = measure_flush(ctx);
+            if (ret < 0)
+                return ret;
+        }
         ff_outlink_set_status(outlink, status, pts);
         return flush_frame(outlink);
     }
@@ -759,14 +874,38 @@ static int config_input(AVFilterLink *inlink)
     if (!s->r128_in)
         return AVERROR(ENOMEM);
 
+    if (inlink->ch_layout.nb_channels == 1 && s->dual_mono)
+        ff_ebur128_set_channel(s->r128_in, 0, FF_EBUR128_DUAL_MONO);
+
+    s->channels = inlink->ch_layout.nb_channels;
+
+    if (s->measure_only) {
+        s->measure_jobs = ff_filter_get_nb_threads(ctx);
+        if (s->measure_jobs <= 1)
+            return 0;
+
+        /* the input is at 192 kHz here, where 3 s is exactly the history
+         * window of the ebur128 state */
+        s->preroll_size = frame_size(inlink->sample_rate, 3000);
+        s->chunk_size   = 3 * s->preroll_size;
+
+        s->r128_chunks = av_calloc(s->measure_jobs, sizeof(*s->r128_chunks));
+        if (!s->r128_chunks)
+            return AVERROR(ENOMEM);
+
+        s->measure_buf = av_malloc_array((size_t)(s->preroll_size + s->measure_jobs * s->chunk_size) * s->channels,
+                                         sizeof(*s->measure_buf));
+        if (!s->measure_buf)
+            return AVERROR(ENOMEM);
+        return 0;
+    }
+
     s->r128_out = ff_ebur128_init(inlink->ch_layout.nb_channels, inlink->sample_rate, 0, FF_EBUR128_MODE_I | FF_EBUR128_MODE_S | FF_EBUR128_MODE_LRA | FF_EBUR128_MODE_SAMPLE_PEAK);
     if (!s->r128_out)
         return AVERROR(ENOMEM);
 
-    if (inlink->ch_layout.nb_channels == 1 && s->dual_mono) {
-        ff_ebur128_set_channel(s->r128_in,  0, FF_EBUR128_DUAL_MONO);
+    if (inlink->ch_layout.nb_channels == 1 && s->dual_mono)
         ff_ebur128_set_channel(s->r128_out, 0, FF_EBUR128_DUAL_MONO);
-    }
 
     s->buf_size = frame_size(inlink->sample_rate, 3000) * inlink->ch_layout.nb_channels;
     s->buf = av_malloc_array(s->buf_size, sizeof(*s->buf));
@@ -787,7 +926,6 @@ static int config_input(AVFilterLink *inlink)
     s->buf_index =
     s->prev_buf_index =
     s->limiter_buf_index = 0;
-    s->channels = inlink->ch_layout.nb_channels;
     s->index = 1;
     s->limiter_state = OUT;
     s->offset = pow(10., s->offset / 20.);
@@ -803,7 +941,7 @@ static av_cold int init(AVFilterContext *ctx)
     LoudNormContext *s = ctx->priv;
     s->frame_type = FIRST_FRAME;
 
-    if (s->linear) {
+    if (s->linear && !s->measure_only) {
         double offset, offset_tp;
         offset    = s->target_i - s->measured_i;
         offset_tp = s->measured_tp + offset;
@@ -822,12 +960,16 @@ static av_cold int init(AVFilterContext *ctx)
 static av_cold void uninit(AVFilterContext *ctx)
 {
     LoudNormContext *s = ctx->priv;
+    FFEBUR128State *r128_out = s->measure_only ? s->r128_in : s->r128_out;
     double i_in, i_out, lra_in, lra_out, thresh_in, thresh_out, tp_in, tp_out;
     int c;
 
-    if (!s->r128_in || !s->r128_out)
+    if (!s->r128_in || !r128_out)
         goto end;
 
+    if (s->measure_buf)
+        measure_flush(ctx);
+
     ff_ebur128_loudness_range(s->r128_in, &lra_in);
     ff_ebur128_loudness_global(s->r128_in, &i_in);
     ff_ebur128_relative_threshold(s->r128_in, &thresh_in);
@@ -838,12 +980,12 @@ static av_cold void uninit(AVFilterContext *ctx)
             tp_in = tmp;
     }
 
-    ff_ebur128_loudness_range(s->r128_out, &lra_out);
-    ff_ebur128_loudness_global(s->r128_out, &i_out);
-    ff_ebur128_relative_threshold(s->r128_out, &thresh_out);
+    ff_ebur128_loudness_range(r128_out, &lra_out);
+    ff_ebur128_loudness_global(r128_out, &i_out);
+    ff_ebur128_relative_threshold(r128_out, &thresh_out);
     for (c = 0; c < s->channels; c++) {
         double tmp;
-        ff_ebur128_sample_peak(s->r128_out, c, &tmp);
+        ff_ebur128_sample_peak(r128_out, c, &tmp);
         if ((c == 0) || (tmp > tp_out))
             tp_out = tmp;
     }
@@ -874,7 +1016,7 @@ static av_cold void uninit(AVFilterContext *ctx)
             20. * log10(tp_out),
             lra_out,
             thresh_out,
-            s->frame_type == LINEAR_MODE ? "linear" : "dynamic",
+            s->measure_only ? "none" : s->frame_type == LINEAR_MODE ? "linear" : "dynamic",
             s->target_i - i_out
         );
         break;
@@ -902,7 +1044,7 @@ static av_cold void uninit(AVFilterContext *ctx)
             20. * log10(tp_out),
             lra_out,
             thresh_out,
-            s->frame_type == LINEAR_MODE ? "Linear" : "Dynamic",
+            s->measure_only ? "None" : s->frame_type == LINEAR_MODE ? "Linear" : "Dynamic",
             s->target_i - i_out
         );
         break;
@@ -913,6 +1055,8 @@ end:
         ff_ebur128_destroy(&s->r128_in);
     if (s->r128_out)
         ff_ebur128_destroy(&s->r128_out);
+    av_freep(&s->r128_chunks);
+    av_freep(&s->measure_buf);
     av_freep(&s->limiter_buf);
     av_freep(&s->prev_smp);
     av_freep(&s->buf);
@@ -937,4 +1081,5 @@ const AVFilter ff_af_loudnorm = {
     FILTER_INPUTS(avfilter_af_loudnorm_inputs),
     FILTER_OUTPUTS(ff_audio_default_filterpad),
     FILTER_QUERY_FUNC2(query_formats),
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
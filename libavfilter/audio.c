@@ -52,7 +52,8 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
 
     if (!li->frame_pool) {
         li->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, channels,
-                                                  nb_samples, link->format, align);
+                                                  nb_samples, link->format, align,
+                                                  link->dst->graph->buffer_pool_flags);
         if (!li->frame_pool)
             return NULL;
     } else {
@@ -72,7 +73,8 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
 
             ff_frame_pool_uninit(&li->frame_pool);
             li->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, channels,
-                                                      nb_samples, link->format, align);
+                                                      nb_samples, link->format, align,
+                                                      link->dst->graph->buffer_pool_flags);
             if (!li->frame_pool)
                 return NULL;
         }
@@ -828,6 +828,13 @@ typedef struct AVFilterGraph {
     avfilter_execute_func *execute;
 
     char *aresample_swr_opts; ///< swr options to use for the auto-inserted aresample filters, Access ONLY through AVOptions
+
+    /**
+     * Allocation policy for the frame buffer pools of the graph's links, a
+     * combination of AV_BUFFER_POOL_FLAG_*. See av_buffer_pool_set_flags().
+     * May be set by the caller before adding any filters to the graph.
+     */
+    int buffer_pool_flags;
 } AVFilterGraph;
 
 /**
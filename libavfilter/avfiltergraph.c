@@ -26,6 +26,7 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/bprint.h"
+#include "libavutil/buffer.h"
 #include "libavutil/channel_layout.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/mem.h"
@@ -56,6 +57,10 @@ static const AVOption filtergraph_options[] = {
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|V },
     {"aresample_swr_opts"   , "default aresample filter options"    , OFFSET(aresample_swr_opts)    ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|A },
+    { "buffer_pool_flags", "frame buffer allocation policy", OFFSET(buffer_pool_flags), AV_OPT_TYPE_FLAGS,
+        { .i64 = 0 }, 0, INT_MAX, F|V|A, .unit = "buffer_pool_flags" },
+        { "hugepages", "use huge pages for large buffers", 0, AV_OPT_TYPE_CONST, { .i64 = AV_BUFFER_POOL_FLAG_HUGEPAGES }, .flags = F|V|A, .unit = "buffer_pool_flags" },
+        { "numa", "allocate buffers on the NUMA node of the filtering thread", 0, AV_OPT_TYPE_CONST, { .i64 = AV_BUFFER_POOL_FLAG_NUMA_LOCAL }, .flags = F|V|A, .unit = "buffer_pool_flags" },
     { NULL },
 };
 
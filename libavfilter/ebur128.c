@@ -41,12 +41,16 @@
  * THE SOFTWARE.
 */
 
+#include "config.h"
 #include "ebur128.h"
+#include "ebur128dsp.h"
 
 #include <float.h>
 #include <limits.h>
 #include <math.h>               /* You may have to define _USE_MATH_DEFINES if you use MSVC */
+#include <string.h>
 
+#include "libavutil/attributes.h"
 #include "libavutil/error.h"
 #include "libavutil/macros.h"
 #include "libavutil/mem.h"
@@ -80,12 +84,13 @@ struct FFEBUR128StateInternal {
     int *channel_map;
     /** How many samples fit in 100ms (rounded). */
     unsigned long samples_in_100ms;
-    /** BS.1770 filter coefficients (nominator). */
-    double b[5];
-    /** BS.1770 filter coefficients (denominator). */
-    double a[5];
-    /** BS.1770 filter state. */
-    double v[5][5];
+    /** BS.1770 filter coefficients, a[1..4] followed by b[0..4], each
+     *  repeated for every vector lane. */
+    DECLARE_ALIGNED(32, double, coeffs)[9][4];
+    /** BS.1770 filter state, 4 rows of one element per channel. */
+    double *v;
+    /** K-weighting filter functions. */
+    EBUR128DSPContext dsp;
     /** Histograms, used to calculate LRA. */
     unsigned long *block_energy_histogram;
     unsigned long *short_term_block_energy_histogram;
@@ -119,6 +124,7 @@ static void ebur128_init_filter(FFEBUR128State * st)
     double pa[3] = { 1.0, 0.0, 0.0 };
     double rb[3] = { 1.0, -2.0, 1.0 };
     double ra[3] = { 1.0, 0.0, 0.0 };
+    double a[5], b[5];
 
     double a0 = 1.0 + K / Q + K * K;
     pb[0] = (Vh + Vb * K / Q + K * K) / a0;
@@ -134,22 +140,23 @@ static void ebur128_init_filter(FFEBUR128State * st)
     ra[1] = 2.0 * (K * K - 1.0) / (1.0 + K / Q + K * K);
     ra[2] = (1.0 - K / Q + K * K) / (1.0 + K / Q + K * K);
 
-    st->d->b[0] = pb[0] * rb[0];
-    st->d->b[1] = pb[0] * rb[1] + pb[1] * rb[0];
-    st->d->b[2] = pb[0] * rb[2] + pb[1] * rb[1] + pb[2] * rb[0];
-    st->d->b[3] = pb[1] * rb[2] + pb[2] * rb[1];
-    st->d->b[4] = pb[2] * rb[2];
-
-    st->d->a[0] = pa[0] * ra[0];
-    st->d->a[1] = pa[0] * ra[1] + pa[1] * ra[0];
-    st->d->a[2] = pa[0] * ra[2] + pa[1] * ra[1] + pa[2] * ra[0];
-    st->d->a[3] = pa[1] * ra[2] + pa[2] * ra[1];
-    st->d->a[4] = pa[2] * ra[2];
-
-    for (i = 0; i < 5; ++i) {
-        for (j = 0; j < 5; ++j) {
-            st->d->v[i][j] = 0.0;
+    b[0] = pb[0] * rb[0];
+    b[1] = pb[0] * rb[1] + pb[1] * rb[0];
+    b[2] = pb[0] * rb[2] + pb[1] * rb[1] + pb[2] * rb[0];
+    b[3] = pb[1] * rb[2] + pb[2] * rb[1];
+    b[4] = pb[2] * rb[2];
+
+    a[1] = pa[0] * ra[1] + pa[1] * ra[0];
+    a[2] = pa[0] * ra[2] + pa[1] * ra[1] + pa[2] * ra[0];
+    a[3] = pa[1] * ra[2] + pa[2] * ra[1];
+    a[4] = pa[2] * ra[2];
+
+    for (i = 0; i < 4; ++i) {
+        for (j = 0; j < 4; ++j) {
+            st->d->coeffs[i][j]     = a[i + 1];
+            st->d->coeffs[i + 4][j] = b[i];
         }
+        st->d->coeffs[8][i] = b[4];
     }
 }
 
@@ -258,11 +265,15 @@ FFEBUR128State *ff_ebur128_init(unsigned int channels,
                              st->channels * sizeof(*st->d->audio_data));
     CHECK_ERROR(!st->d->audio_data, 0, free_sample_peak)
 
+    st->d->v = (double *) av_calloc(channels, 4 * sizeof(*st->d->v));
+    CHECK_ERROR(!st->d->v, 0, free_audio_data)
+
     ebur128_init_filter(st);
+    ff_ebur128_dsp_init(&st->d->dsp);
 
     st->d->block_energy_histogram =
         av_mallocz(1000 * sizeof(*st->d->block_energy_histogram));
-    CHECK_ERROR(!st->d->block_energy_histogram, 0, free_audio_data)
+    CHECK_ERROR(!st->d->block_energy_histogram, 0, free_filter_state)
     st->d->short_term_block_energy_histogram =
         av_mallocz(1000 * sizeof(*st->d->short_term_block_energy_histogram));
     CHECK_ERROR(!st->d->short_term_block_energy_histogram, 0,
@@ -287,6 +298,8 @@ free_short_term_block_energy_histogram:
     av_free(st->d->short_term_block_energy_histogram);
 free_block_energy_histogram:
     av_free(st->d->block_energy_histogram);
+free_filter_state:
+    av_free(st->d->v);
 free_audio_data:
     av_free(st->d->audio_data);
 free_sample_peak:
@@ -306,6 +319,7 @@ void ff_ebur128_destroy(FFEBUR128State ** st)
     av_free((*st)->d->block_energy_histogram);
     av_free((*st)->d->short_term_block_energy_histogram);
     av_free((*st)->d->audio_data);
+    av_free((*st)->d->v);
     av_free((*st)->d->channel_map);
     av_free((*st)->d->sample_peak);
     av_free((*st)->d->data_ptrs);
@@ -314,6 +328,89 @@ void ff_ebur128_destroy(FFEBUR128State ** st)
     *st = NULL;
 }
 
+static av_always_inline void filter_lanes(double *dst, const double *src,
+                                          ptrdiff_t stride, double *v,
+                                          ptrdiff_t v_stride,
+                                          const double (*coeffs)[4],
+                                          int nb_frames, int lanes)
+{
+    double *v1 = v, *v2 = v + v_stride, *v3 = v + 2 * v_stride, *v4 = v + 3 * v_stride;
+    int i, c;
+
+    for (i = 0; i < nb_frames; ++i) {
+        for (c = 0; c < lanes; ++c) {
+            double v0 = src[c] - coeffs[0][c] * v1[c]
+                               - coeffs[1][c] * v2[c]
+                               - coeffs[2][c] * v3[c]
+                               - coeffs[3][c] * v4[c];
+            dst[c] = coeffs[4][c] * v0
+                   + coeffs[5][c] * v1[c]
+                   + coeffs[6][c] * v2[c]
+                   + coeffs[7][c] * v3[c]
+                   + coeffs[8][c] * v4[c];
+            v4[c] = v3[c];
+            v3[c] = v2[c];
+            v2[c] = v1[c];
+            v1[c] = v0;
+        }
+        src += stride;
+        dst += stride;
+    }
+}
+
+static void filter_x1_c(double *dst, const double *src, ptrdiff_t stride,
+                        double *v, ptrdiff_t v_stride,
+                        const double (*coeffs)[4], int nb_frames)
+{
+    filter_lanes(dst, src, stride, v, v_stride, coeffs, nb_frames, 1);
+}
+
+static void filter_x2_c(double *dst, const double *src, ptrdiff_t stride,
+                        double *v, ptrdiff_t v_stride,
+                        const double (*coeffs)[4], int nb_frames)
+{
+    filter_lanes(dst, src, stride, v, v_stride, coeffs, nb_frames, 2);
+}
+
+static void filter_x4_c(double *dst, const double *src, ptrdiff_t stride,
+                        double *v, ptrdiff_t v_stride,
+                        const double (*coeffs)[4], int nb_frames)
+{
+    filter_lanes(dst, src, stride, v, v_stride, coeffs, nb_frames, 4);
+}
+
+av_cold void ff_ebur128_dsp_init(EBUR128DSPContext *dsp)
+{
+    dsp->filter_x2 = filter_x2_c;
+    dsp->filter_x4 = filter_x4_c;
+#if ARCH_X86
+    ff_ebur128_dsp_init_x86(dsp);
+#endif
+}
+
+/* Filter all channels, as many at a time as the vector width allows. Unused
+ * channels are filtered too, they are skipped when computing the energy. */
+static void ebur128_filter_channels(FFEBUR128State *st, double *dst,
+                                    const double *src, size_t frames)
+{
+    struct FFEBUR128StateInternal *d = st->d;
+    const ptrdiff_t stride = st->channels;
+    size_t c = 0;
+
+    for (; c + 4 <= st->channels; c += 4)
+        d->dsp.filter_x4(dst + c, src + c, stride, d->v + c, stride,
+                         d->coeffs, frames);
+    for (; c + 2 <= st->channels; c += 2)
+        d->dsp.filter_x2(dst + c, src + c, stride, d->v + c, stride,
+                         d->coeffs, frames);
+    for (; c < st->channels; ++c)
+        filter_x1_c(dst + c, src + c, stride, d->v + c, stride,
+                    d->coeffs, frames);
+
+    for (c = 0; c < 4 * st->channels; ++c)
+        d->v[c] = fabs(d->v[c]) < DBL_MIN ? 0.0 : d->v[c];
+}
+
 #define EBUR128_FILTER(type, scaling_factor)                                       \
 static void ebur128_filter_##type(FFEBUR128State* st, const type** srcs,           \
                                   size_t src_index, size_t frames,                 \
@@ -336,32 +433,8 @@ static void ebur128_filter_##type(FFEBUR128State* st, const type** srcs,
             if (max > st->d->sample_peak[c]) st->d->sample_peak[c] = max;          \
         }                                                                          \
     }                                                                              \
-    for (c = 0; c < st->channels; ++c) {                                           \
-        int ci = st->d->channel_map[c] - 1;                                        \
-        if (ci < 0) continue;                                                      \
-        else if (ci == FF_EBUR128_DUAL_MONO - 1) ci = 0; /*dual mono */            \
-        for (i = 0; i < frames; ++i) {                                             \
-            st->d->v[ci][0] = (double) (srcs[c][src_index + i * stride] / scaling_factor) \
-                         - st->d->a[1] * st->d->v[ci][1]                           \
-                         - st->d->a[2] * st->d->v[ci][2]                           \
-                         - st->d->a[3] * st->d->v[ci][3]                           \
-                         - st->d->a[4] * st->d->v[ci][4];                          \
-            audio_data[i * st->channels + c] =                                     \
-                           st->d->b[0] * st->d->v[ci][0]                           \
-                         + st->d->b[1] * st->d->v[ci][1]                           \
-                         + st->d->b[2] * st->d->v[ci][2]                           \
-                         + st->d->b[3] * st->d->v[ci][3]                           \
-                         + st->d->b[4] * st->d->v[ci][4];                          \
-            st->d->v[ci][4] = st->d->v[ci][3];                                     \
-            st->d->v[ci][3] = st->d->v[ci][2];                                     \
-            st->d->v[ci][2] = st->d->v[ci][1];                                     \
-            st->d->v[ci][1] = st->d->v[ci][0];                                     \
-        }                                                                          \
-        st->d->v[ci][4] = fabs(st->d->v[ci][4]) < DBL_MIN ? 0.0 : st->d->v[ci][4]; \
-        st->d->v[ci][3] = fabs(st->d->v[ci][3]) < DBL_MIN ? 0.0 : st->d->v[ci][3]; \
-        st->d->v[ci][2] = fabs(st->d->v[ci][2]) < DBL_MIN ? 0.0 : st->d->v[ci][2]; \
-        st->d->v[ci][1] = fabs(st->d->v[ci][1]) < DBL_MIN ? 0.0 : st->d->v[ci][1]; \
-    }                                                                              \
+    /* the K-weighting filter works on interleaved data, srcs[c] == srcs[0] + c */ \
+    ebur128_filter_channels(st, audio_data, srcs[0] + src_index, frames);          \
 }
 EBUR128_FILTER(double, 1.0)
 
@@ -723,3 +796,30 @@ int ff_ebur128_sample_peak(FFEBUR128State * st,
     *out = st->d->sample_peak[channel_number];
     return 0;
 }
+
+void ff_ebur128_reset_histograms(FFEBUR128State * st)
+{
+    memset(st->d->block_energy_histogram, 0,
+           1000 * sizeof(*st->d->block_energy_histogram));
+    memset(st->d->short_term_block_energy_histogram, 0,
+           1000 * sizeof(*st->d->short_term_block_energy_histogram));
+}
+
+int ff_ebur128_merge(FFEBUR128State * dst, const FFEBUR128State * src)
+{
+    size_t i;
+
+    if (dst->channels != src->channels || dst->mode != src->mode)
+        return AVERROR(EINVAL);
+
+    for (i = 0; i < 1000; ++i) {
+        dst->d->block_energy_histogram[i] +=
+            src->d->block_energy_histogram[i];
+        dst->d->short_term_block_energy_histogram[i] +=
+            src->d->short_term_block_energy_histogram[i];
+    }
+    for (i = 0; i < dst->channels; ++i)
+        dst->d->sample_peak[i] = FFMAX(dst->d->sample_peak[i],
+                                       src->d->sample_peak[i]);
+    return 0;
+}
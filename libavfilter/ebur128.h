@@ -226,4 +226,26 @@ int ff_ebur128_sample_peak(FFEBUR128State * st,
  */
 int ff_ebur128_relative_threshold(FFEBUR128State * st, double *out);
 
+/** \brief Discard the gating blocks measured so far.
+ *
+ *  The filter state and the audio history are kept, so a state that has been
+ *  fed the audio preceding a chunk and then reset measures the chunk as if
+ *  it had processed the whole stream.
+ *
+ *  @param st library state
+ */
+void ff_ebur128_reset_histograms(FFEBUR128State * st);
+
+/** \brief Add the gating blocks and sample peaks of one state to another.
+ *
+ *  Used to combine measurements of consecutive chunks of a stream.
+ *
+ *  @param dst library state to merge into
+ *  @param src library state to merge from
+ *  @return
+ *    - 0 on success.
+ *    - AVERROR(EINVAL) if the channel count or the mode differ.
+ */
+int ff_ebur128_merge(FFEBUR128State * dst, const FFEBUR128State * src);
+
 #endif                          /* AVFILTER_EBUR128_H */
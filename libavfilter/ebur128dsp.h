@@ -0,0 +1,51 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_EBUR128DSP_H
+#define AVFILTER_EBUR128DSP_H
+
+#include <stddef.h>
+
+typedef struct EBUR128DSPContext {
+    /**
+     * Run the BS.1770 K-weighting filter over 2 (filter_x2) or 4 (filter_x4)
+     * adjacent channels of interleaved audio, one channel per vector lane.
+     *
+     * @param dst       filtered output, stride elements per frame
+     * @param src       input, stride elements per frame
+     * @param stride    number of interleaved channels
+     * @param v         filter state, 4 rows (z^-1 .. z^-4) of v_stride
+     *                  elements; the first 2 or 4 elements of each row are
+     *                  used and updated
+     * @param v_stride  distance between the rows of v in elements
+     * @param coeffs    a[1..4] followed by b[0..4], each repeated 4 times,
+     *                  32-byte aligned
+     * @param nb_frames number of frames to filter, must be > 0
+     */
+    void (*filter_x2)(double *dst, const double *src, ptrdiff_t stride,
+                      double *v, ptrdiff_t v_stride,
+                      const double (*coeffs)[4], int nb_frames);
+    void (*filter_x4)(double *dst, const double *src, ptrdiff_t stride,
+                      double *v, ptrdiff_t v_stride,
+                      const double (*coeffs)[4], int nb_frames);
+} EBUR128DSPContext;
+
+void ff_ebur128_dsp_init(EBUR128DSPContext *dsp);
+void ff_ebur128_dsp_init_x86(EBUR128DSPContext *dsp);
+
+#endif /* AVFILTER_EBUR128DSP_H */
@@ -53,7 +53,8 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
                                       int width,
                                       int height,
                                       enum AVPixelFormat format,
-                                      int align)
+                                      int align,
+                                      int pool_flags)
 {
     int i, ret;
     FFFramePool *pool;
@@ -103,6 +104,7 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
         pool->pools[i] = av_buffer_pool_init(sizes[i] + align, alloc);
         if (!pool->pools[i])
             goto fail;
+        av_buffer_pool_set_flags(pool->pools[i], pool_flags);
     }
 
     return pool;
@@ -116,7 +118,8 @@ FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
                                       int channels,
                                       int nb_samples,
                                       enum AVSampleFormat format,
-                                      int align)
+                                      int align,
+                                      int pool_flags)
 {
     int ret, planar;
     FFFramePool *pool;
@@ -144,6 +147,7 @@ FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
     pool->pools[0] = av_buffer_pool_init(pool->linesize[0] + align, NULL);
     if (!pool->pools[0])
         goto fail;
+    av_buffer_pool_set_flags(pool->pools[0], pool_flags);
 
     return pool;
 
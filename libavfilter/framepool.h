@@ -42,13 +42,16 @@ typedef struct FFFramePool FFFramePool;
  * @param height height of each frame in this pool
  * @param format format of each frame in this pool
  * @param align buffers alignement of each frame in this pool
+ * @param pool_flags allocation policy of the buffers, see
+ *                   av_buffer_pool_set_flags()
  * @return newly created video frame pool on success, NULL on error.
  */
 FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
                                       int width,
                                       int height,
                                       enum AVPixelFormat format,
-                                      int align);
+                                      int align,
+                                      int pool_flags);
 
 /**
  * Allocate and initialize an audio frame pool.
@@ -60,13 +63,16 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(size_t size),
  * @param nb_samples number of samples of each frame in this pool
  * @param format format of each frame in this pool
  * @param align buffers alignement of each frame in this pool
+ * @param pool_flags allocation policy of the buffers, see
+ *                   av_buffer_pool_set_flags()
  * @return newly created audio frame pool on success, NULL on error.
  */
 FFFramePool *ff_frame_pool_audio_init(AVBufferRef* (*alloc)(size_t size),
                                       int channels,
                                       int samples,
                                       enum AVSampleFormat format,
-                                      int align);
+                                      int align,
+                                      int pool_flags);
 
 /**
  * Deallocate the frame pool. It is safe to call this function while
@@ -194,6 +194,7 @@ typedef struct GlyphInfo {
     int y;                          ///< the y position of the glyph
     int shift_x64;                  ///< the horizontal shift of the glyph in 26.6 units
     int shift_y64;                  ///< the vertical shift of the glyph in 26.6 units
+    struct Glyph *glyph;            ///< the cached glyph, resolved once per frame
 } GlyphInfo;
 
 /** Information about a single line of text */
@@ -1276,20 +1277,31 @@ static void update_alpha(DrawTextContext *s)
         s->alpha = 256 * alpha;
 }
 
-static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
-                       FFDrawColor *color,
-                       TextMetrics *metrics,
-                       int x, int y, int borderw)
+typedef struct ThreadData {
+    AVFrame *frame;
+    TextMetrics *metrics;
+    FFDrawColor *fontcolor;
+    FFDrawColor *shadowcolor;
+    FFDrawColor *bordercolor;
+    FFDrawColor *boxcolor;
+    int clip_top, clip_bottom;      ///< rows of the frame that may be drawn to
+} ThreadData;
+
+/* Only rows in [slice_start, slice_end) are drawn to. */
+static void draw_glyphs(DrawTextContext *s, AVFrame *frame,
+                        FFDrawColor *color,
+                        TextMetrics *metrics,
+                        int x, int y, int borderw,
+                        int slice_start, int slice_end)
 {
     int g, l, x1, y1, w1, h1, idx;
     int dx = 0, dy = 0, pdx = 0;
     GlyphInfo *info;
-    Glyph dummy = { 0 }, *glyph;
     FT_Bitmap bitmap;
     FT_BitmapGlyph b_glyph;
     uint8_t j_left = 0, j_right = 0, j_top = 0, j_bottom = 0;
     int line_w, offset_y = 0;
-    int clip_x = 0, clip_y = 0;
+    int clip_x = 0, clip_y = 0, clip_top;
 
     j_left = !!(s->text_align & TA_LEFT);
     j_right = !!(s->text_align & TA_RIGHT);
@@ -1302,28 +1314,17 @@ static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
         offset_y = s->box_height - metrics->height;
     }
 
-    if ((!j_left || j_right) && !s->tab_warning_printed && s->tab_count > 0) {
-        s->tab_warning_printed = 1;
-        av_log(s, AV_LOG_WARNING, "Tab characters are only supported with left horizontal alignment\n");
-    }
-
     clip_x = FFMIN(metrics->rect_x + s->box_width + s->bb_right, frame->width);
-    clip_y = FFMIN(metrics->rect_y + s->box_height + s->bb_bottom, frame->height);
+    clip_y = FFMIN(metrics->rect_y + s->box_height + s->bb_bottom, slice_end);
+    clip_top = FFMAX(metrics->rect_y - s->bb_top, slice_start);
 
     for (l = 0; l < s->line_count; ++l) {
         TextLine *line = &s->lines[l];
         line_w = POS_CEIL(line->width64, 64);
         for (g = 0; g < line->hb_data.glyph_count; ++g) {
             info = &line->glyphs[g];
-            dummy.fontsize = s->fontsize;
-            dummy.code = info->code;
-            glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-            if (!glyph) {
-                return AVERROR(EINVAL);
-            }
-
             idx = get_subpixel_idx(info->shift_x64, info->shift_y64);
-            b_glyph = borderw ? glyph->border_bglyph[idx] : glyph->bglyph[idx];
+            b_glyph = borderw ? info->glyph->border_bglyph[idx] : info->glyph->bglyph[idx];
             bitmap = b_glyph->bitmap;
             x1 = x + info->x + b_glyph->left;
             y1 = y + info->y - b_glyph->top + offset_y;
@@ -1342,9 +1343,9 @@ static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
                 dx = metrics->rect_x - s->bb_left - x1;
                 x1 = metrics->rect_x - s->bb_left;
             }
-            if (y1 < metrics->rect_y - s->bb_top) {
-                dy = metrics->rect_y - s->bb_top - y1;
-                y1 = metrics->rect_y - s->bb_top;
+            if (y1 < clip_top) {
+                dy = clip_top - y1;
+                y1 = clip_top;
             }
 
             // check if the glyph is empty or out of the clipping region
@@ -1360,6 +1361,51 @@ static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
                 bitmap.buffer + pdx, bitmap.pitch, w1, h1, 3, 0, x1, y1);
         }
     }
+}
+
+static int draw_text_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    DrawTextContext *s = ctx->priv;
+    ThreadData *td = arg;
+    TextMetrics *metrics = td->metrics;
+    AVFrame *frame = td->frame;
+    const int align = 1 << s->dc.vsub_max;
+    const int rows = td->clip_bottom - td->clip_top;
+    int slice_start = td->clip_top, slice_end = td->clip_bottom;
+
+    /* Slice boundaries are aligned to the chroma subsampling, so that no
+     * chroma row is blended by two jobs and the result does not depend on
+     * the number of jobs. */
+    if (jobnr > 0)
+        slice_start = FFMAX(td->clip_top,
+                            (td->clip_top + rows * jobnr / nb_jobs) & ~(align - 1));
+    if (jobnr < nb_jobs - 1)
+        slice_end = FFMAX(td->clip_top,
+                          (td->clip_top + rows * (jobnr + 1) / nb_jobs) & ~(align - 1));
+    if (slice_start >= slice_end)
+        return 0;
+
+    if (s->draw_box) {
+        int rec_y = FFMAX(metrics->rect_y - s->bb_top, slice_start);
+        int rec_bottom = FFMIN(metrics->rect_y + s->box_height + s->bb_bottom, slice_end);
+
+        if (rec_bottom > rec_y)
+            ff_blend_rectangle(&s->dc, td->boxcolor,
+                frame->data, frame->linesize, frame->width, frame->height,
+                metrics->rect_x - s->bb_left, rec_y,
+                s->box_width + s->bb_right + s->bb_left, rec_bottom - rec_y);
+    }
+
+    if (s->shadowx || s->shadowy)
+        draw_glyphs(s, frame, td->shadowcolor, metrics,
+                    s->shadowx, s->shadowy, s->borderw, slice_start, slice_end);
+
+    if (s->borderw)
+        draw_glyphs(s, frame, td->bordercolor, metrics,
+                    0, 0, s->borderw, slice_start, slice_end);
+
+    draw_glyphs(s, frame, td->fontcolor, metrics,
+                0, 0, 0, slice_start, slice_end);
 
     return 0;
 }
@@ -1578,7 +1624,6 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame)
 
     int width = frame->width;
     int height = frame->height;
-    int rec_x = 0, rec_y = 0, rec_width = 0, rec_height = 0;
     int is_outside = 0;
     int last_tab_idx = 0;
 
@@ -1751,6 +1796,7 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame)
             g_info->y = ((y64 + true_y) >> 6) + (shift_y64 > 0 ? 1 : 0);
             g_info->shift_x64 = shift_x64;
             g_info->shift_y64 = shift_y64;
+            g_info->glyph = glyph;
 
             if (!is_tab) {
                 x += hb->glyph_pos[t].x_advance;
@@ -1792,35 +1838,26 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame)
                     metrics.rect_y + s->box_height + s->bb_bottom <= 0;
 
     if (!is_outside) {
-        /* draw box */
-        if (s->draw_box) {
-            rec_x = metrics.rect_x - s->bb_left;
-            rec_y = metrics.rect_y - s->bb_top;
-            rec_width = s->box_width + s->bb_right + s->bb_left;
-            rec_height = s->box_height + s->bb_bottom + s->bb_top;
-            ff_blend_rectangle(&s->dc, &boxcolor,
-                frame->data, frame->linesize, width, height,
-                rec_x, rec_y, rec_width, rec_height);
+        ThreadData td = {
+            .frame       = frame,
+            .metrics     = &metrics,
+            .fontcolor   = &fontcolor,
+            .shadowcolor = &shadowcolor,
+            .bordercolor = &bordercolor,
+            .boxcolor    = &boxcolor,
+            .clip_top    = FFMAX(metrics.rect_y - s->bb_top, 0),
+            .clip_bottom = FFMIN(metrics.rect_y + s->box_height + s->bb_bottom, height),
+        };
+        int nb_jobs = FFMIN((td.clip_bottom - td.clip_top) >> s->dc.vsub_max,
+                            ff_filter_get_nb_threads(ctx));
+
+        if ((s->text_align & (TA_LEFT | TA_RIGHT)) != TA_LEFT &&
+            !s->tab_warning_printed && s->tab_count > 0) {
+            s->tab_warning_printed = 1;
+            av_log(s, AV_LOG_WARNING, "Tab characters are only supported with left horizontal alignment\n");
         }
 
-        if (s->shadowx || s->shadowy) {
-            if ((ret = draw_glyphs(s, frame, &shadowcolor, &metrics,
-                    s->shadowx, s->shadowy, s->borderw)) < 0) {
-                return ret;
-            }
-        }
-
-        if (s->borderw) {
-            if ((ret = draw_glyphs(s, frame, &bordercolor, &metrics,
-                    0, 0, s->borderw)) < 0) {
-                return ret;
-            }
-        }
-
-        if ((ret = draw_glyphs(s, frame, &fontcolor, &metrics, 0,
-                0, 0)) < 0) {
-            return ret;
-        }
+        ff_filter_execute(ctx, draw_text_slice, &td, NULL, FFMAX(nb_jobs, 1));
     }
 
     // FREE data structures
@@ -1925,5 +1962,6 @@ const AVFilter ff_vf_drawtext = {
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_QUERY_FUNC2(query_formats),
     .process_command = command,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC |
+                     AVFILTER_FLAG_SLICE_THREADS,
 };
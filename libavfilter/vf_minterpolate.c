@@ -164,6 +164,8 @@ typedef struct Frame {
 typedef struct MIContext {
     const AVClass *class;
     AVMotionEstContext me_ctx;
+    AVMotionEstContext *thread_me_ctx;
+    int nb_threads;
     AVRational frame_rate;
     enum MIMode mi_mode;
     int mc_mode;
@@ -196,6 +198,14 @@ typedef struct MIContext {
     int nb_planes;
 } MIContext;
 
+typedef struct ThreadData {
+    Block *blocks;
+    int dir;
+    int wave;
+    int alpha;
+    AVFrame *out;
+} ThreadData;
+
 #define OFFSET(x) offsetof(MIContext, x)
 #define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
 #define CONST(name, help, val, u) { name, help, 0, AV_OPT_TYPE_CONST, {.i64=val}, 0, 0, FLAGS, .unit = u }
@@ -253,20 +263,16 @@ static uint64_t get_sbad(AVMotionEstContext *me_ctx, int x, int y, int x_mv, int
     int linesize = me_ctx->linesize;
     int mv_x1 = x_mv - x;
     int mv_y1 = y_mv - y;
-    int mv_x, mv_y, i, j;
-    uint64_t sbad = 0;
+    int mv_x, mv_y;
+    uint64_t sbad;
 
     x = av_clip(x, me_ctx->x_min, me_ctx->x_max);
     y = av_clip(y, me_ctx->y_min, me_ctx->y_max);
     mv_x = av_clip(x_mv - x, -FFMIN(x - me_ctx->x_min, me_ctx->x_max - x), FFMIN(x - me_ctx->x_min, me_ctx->x_max - x));
     mv_y = av_clip(y_mv - y, -FFMIN(y - me_ctx->y_min, me_ctx->y_max - y), FFMIN(y - me_ctx->y_min, me_ctx->y_max - y));
 
-    data_cur += (y + mv_y) * linesize;
-    data_next += (y - mv_y) * linesize;
-
-    for (j = 0; j < me_ctx->mb_size; j++)
-        for (i = 0; i < me_ctx->mb_size; i++)
-            sbad += FFABS(data_cur[x + mv_x + i + j * linesize] - data_next[x - mv_x + i + j * linesize]);
+    sbad = ff_me_sad(me_ctx, data_cur  + x + mv_x + (y + mv_y) * linesize,
+                             data_next + x - mv_x + (y - mv_y) * linesize, me_ctx->mb_size);
 
     return sbad + (FFABS(mv_x1 - me_ctx->pred_x) + FFABS(mv_y1 - me_ctx->pred_y)) * COST_PRED_SCALE;
 }
@@ -280,19 +286,20 @@ static uint64_t get_sbad_ob(AVMotionEstContext *me_ctx, int x, int y, int x_mv,
     int x_max = me_ctx->x_max - me_ctx->mb_size / 2;
     int y_min = me_ctx->y_min + me_ctx->mb_size / 2;
     int y_max = me_ctx->y_max - me_ctx->mb_size / 2;
+    int ob = me_ctx->mb_size / 2;
     int mv_x1 = x_mv - x;
     int mv_y1 = y_mv - y;
-    int mv_x, mv_y, i, j;
-    uint64_t sbad = 0;
+    int mv_x, mv_y;
+    uint64_t sbad;
 
     x = av_clip(x, x_min, x_max);
     y = av_clip(y, y_min, y_max);
     mv_x = av_clip(x_mv - x, -FFMIN(x - x_min, x_max - x), FFMIN(x - x_min, x_max - x));
     mv_y = av_clip(y_mv - y, -FFMIN(y - y_min, y_max - y), FFMIN(y - y_min, y_max - y));
 
-    for (j = -me_ctx->mb_size / 2; j < me_ctx->mb_size * 3 / 2; j++)
-        for (i = -me_ctx->mb_size / 2; i < me_ctx->mb_size * 3 / 2; i++)
-            sbad += FFABS(data_cur[x + mv_x + i + (y + mv_y + j) * linesize] - data_next[x - mv_x + i + (y - mv_y + j) * linesize]);
+    sbad = ff_me_sad(me_ctx, data_cur  + x + mv_x - ob + (y + mv_y - ob) * linesize,
+                             data_next + x - mv_x - ob + (y - mv_y - ob) * linesize,
+                     me_ctx->mb_size * 3 / 2 + ob);
 
     return sbad + (FFABS(mv_x1 - me_ctx->pred_x) + FFABS(mv_y1 - me_ctx->pred_y)) * COST_PRED_SCALE;
 }
@@ -306,19 +313,19 @@ static uint64_t get_sad_ob(AVMotionEstContext *me_ctx, int x, int y, int x_mv, i
     int x_max = me_ctx->x_max - me_ctx->mb_size / 2;
     int y_min = me_ctx->y_min + me_ctx->mb_size / 2;
     int y_max = me_ctx->y_max - me_ctx->mb_size / 2;
+    int ob = me_ctx->mb_size / 2;
     int mv_x = x_mv - x;
     int mv_y = y_mv - y;
-    int i, j;
-    uint64_t sad = 0;
+    uint64_t sad;
 
     x = av_clip(x, x_min, x_max);
     y = av_clip(y, y_min, y_max);
     x_mv = av_clip(x_mv, x_min, x_max);
     y_mv = av_clip(y_mv, y_min, y_max);
 
-    for (j = -me_ctx->mb_size / 2; j < me_ctx->mb_size * 3 / 2; j++)
-        for (i = -me_ctx->mb_size / 2; i < me_ctx->mb_size * 3 / 2; i++)
-            sad += FFABS(data_ref[x_mv + i + (y_mv + j) * linesize] - data_cur[x + i + (y + j) * linesize]);
+    sad = ff_me_sad(me_ctx, data_ref + x_mv - ob + (y_mv - ob) * linesize,
+                            data_cur + x    - ob + (y    - ob) * linesize,
+                    me_ctx->mb_size * 3 / 2 + ob);
 
     return sad + (FFABS(mv_x - me_ctx->pred_x) + FFABS(mv_y - me_ctx->pred_y)) * COST_PRED_SCALE;
 }
@@ -367,6 +374,11 @@ static int config_input(AVFilterLink *inlink)
         else if (mi_ctx->me_mode == ME_MODE_BILAT)
             me_ctx->get_cost = &get_sbad_ob;
 
+        mi_ctx->nb_threads = ff_filter_get_nb_threads(inlink->dst);
+        mi_ctx->thread_me_ctx = av_calloc(mi_ctx->nb_threads, sizeof(*mi_ctx->thread_me_ctx));
+        if (!mi_ctx->thread_me_ctx)
+            return AVERROR(ENOMEM);
+
         mi_ctx->pixel_mvs     = av_calloc(width * height, sizeof(*mi_ctx->pixel_mvs));
         mi_ctx->pixel_weights = av_calloc(width * height, sizeof(*mi_ctx->pixel_weights));
         mi_ctx->pixel_refs    = av_calloc(width * height, sizeof(*mi_ctx->pixel_refs));
@@ -413,9 +425,9 @@ static int config_output(AVFilterLink *outlink)
         preds.nb++;\
     } while(0)
 
-static void search_mv(MIContext *mi_ctx, Block *blocks, int mb_x, int mb_y, int dir)
+static void search_mv(MIContext *mi_ctx, AVMotionEstContext *me_ctx, Block *blocks,
+                      int mb_x, int mb_y, int dir)
 {
-    AVMotionEstContext *me_ctx = &mi_ctx->me_ctx;
     AVMotionEstPredictor *preds = me_ctx->preds;
     Block *block = &blocks[mb_x + mb_y * mi_ctx->b_width];
 
@@ -555,8 +567,75 @@ static void search_mv(MIContext *mi_ctx, Block *blocks, int mb_x, int mb_y, int
     block->mvs[dir][1] = mv[1] - y_mb;
 }
 
-static void bilateral_me(MIContext *mi_ctx)
+static int search_mv_rows(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData *td = arg;
+    const int slice_start = (mi_ctx->b_height *  jobnr     ) / nb_jobs;
+    const int slice_end   = (mi_ctx->b_height * (jobnr + 1)) / nb_jobs;
+    int mb_x, mb_y;
+
+    for (mb_y = slice_start; mb_y < slice_end; mb_y++)
+        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++)
+            search_mv(mi_ctx, &mi_ctx->thread_me_ctx[jobnr], td->blocks, mb_x, mb_y, td->dir);
+
+    return 0;
+}
+
+/**
+ * Search the blocks with mb_x + 2 * mb_y == td->wave. Their left, top,
+ * top-left and top-right neighbours all belong to earlier waves.
+ */
+static int search_mv_wave(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData *td = arg;
+    const int y_min = FFMAX(0, (td->wave - mi_ctx->b_width + 2) / 2);
+    const int y_max = FFMIN(mi_ctx->b_height - 1, td->wave / 2);
+    const int slice_start = y_min + ((y_max - y_min + 1) *  jobnr     ) / nb_jobs;
+    const int slice_end   = y_min + ((y_max - y_min + 1) * (jobnr + 1)) / nb_jobs;
+    int mb_y;
+
+    for (mb_y = slice_start; mb_y < slice_end; mb_y++)
+        search_mv(mi_ctx, &mi_ctx->thread_me_ctx[jobnr], td->blocks,
+                  td->wave - 2 * mb_y, mb_y, td->dir);
+
+    return 0;
+}
+
+static void motion_estimation(AVFilterContext *ctx, Block *blocks, int dir)
 {
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData td = { .blocks = blocks, .dir = dir };
+    int nb_jobs, i;
+
+    if (mi_ctx->me_method == AV_ME_METHOD_EPZS || mi_ctx->me_method == AV_ME_METHOD_UMH) {
+        /* the predictors depend on already searched neighbours in the
+         * current frame, so search along diagonal wavefronts */
+        for (td.wave = 0; td.wave < mi_ctx->b_width + 2 * mi_ctx->b_height - 2; td.wave++) {
+            const int y_min = FFMAX(0, (td.wave - mi_ctx->b_width + 2) / 2);
+            const int y_max = FFMIN(mi_ctx->b_height - 1, td.wave / 2);
+
+            nb_jobs = FFMIN(y_max - y_min + 1, mi_ctx->nb_threads);
+            for (i = 0; i < nb_jobs; i++)
+                mi_ctx->thread_me_ctx[i] = mi_ctx->me_ctx;
+            ff_filter_execute(ctx, search_mv_wave, &td, NULL, nb_jobs);
+        }
+    } else {
+        nb_jobs = FFMIN(mi_ctx->b_height, mi_ctx->nb_threads);
+        for (i = 0; i < nb_jobs; i++)
+            mi_ctx->thread_me_ctx[i] = mi_ctx->me_ctx;
+        ff_filter_execute(ctx, search_mv_rows, &td, NULL, nb_jobs);
+    }
+
+    /* the last job searched the last block, keep its predictor state */
+    mi_ctx->me_ctx.pred_x = mi_ctx->thread_me_ctx[nb_jobs - 1].pred_x;
+    mi_ctx->me_ctx.pred_y = mi_ctx->thread_me_ctx[nb_jobs - 1].pred_y;
+}
+
+static void bilateral_me(AVFilterContext *ctx)
+{
+    MIContext *mi_ctx = ctx->priv;
     Block *block;
     int mb_x, mb_y;
 
@@ -571,9 +650,7 @@ static void bilateral_me(MIContext *mi_ctx)
             block->mvs[0][1] = 0;
         }
 
-    for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++)
-            search_mv(mi_ctx, mi_ctx->int_blocks, mb_x, mb_y, 0);
+    motion_estimation(ctx, mi_ctx->int_blocks, 0);
 }
 
 static int var_size_bme(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int n)
@@ -756,9 +833,7 @@ static int inject_frame(AVFilterLink *inlink, AVFrame *avf_in)
                     mi_ctx->me_ctx.data_cur = mi_ctx->frames[2].avf->data[0];
                     mi_ctx->me_ctx.data_ref = mi_ctx->frames[dir ? 3 : 1].avf->data[0];
 
-                    for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-                        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++)
-                            search_mv(mi_ctx, mi_ctx->frames[2].blocks, mb_x, mb_y, dir);
+                    motion_estimation(ctx, mi_ctx->frames[2].blocks, dir);
                 }
             }
 
@@ -773,7 +848,7 @@ static int inject_frame(AVFilterLink *inlink, AVFrame *avf_in)
             mi_ctx->me_ctx.data_cur = mi_ctx->frames[1].avf->data[0];
             mi_ctx->me_ctx.data_ref = mi_ctx->frames[2].avf->data[0];
 
-            bilateral_me(mi_ctx);
+            bilateral_me(ctx);
 
             if (mi_ctx->mc_mode == MC_MODE_AOBMC) {
 
@@ -854,14 +929,14 @@ static int detect_scene_change(AVFilterContext *ctx)
         pixel_refs->nb++;\
     } while(0)
 
-static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
+static void bidirectional_obmc(MIContext *mi_ctx, int alpha, int slice_start, int slice_end)
 {
     int x, y;
     int width = mi_ctx->frames[0].avf->width;
     int height = mi_ctx->frames[0].avf->height;
     int mb_y, mb_x, dir;
 
-    for (y = 0; y < height; y++)
+    for (y = slice_start; y < slice_end; y++)
         for (x = 0; x < width; x++)
             mi_ctx->pixel_refs[x + y * width].nb = 0;
 
@@ -878,9 +953,9 @@ static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
                 start_y = (mb_y << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2 + mv_y * a / ALPHA_MAX;
 
                 startc_x = av_clip(start_x, 0, width - 1);
-                startc_y = av_clip(start_y, 0, height - 1);
+                startc_y = FFMAX(av_clip(start_y, 0, height - 1), slice_start);
                 endc_x = av_clip(start_x + (2 << mi_ctx->log2_mb_size), 0, width - 1);
-                endc_y = av_clip(start_y + (2 << mi_ctx->log2_mb_size), 0, height - 1);
+                endc_y = FFMIN(av_clip(start_y + (2 << mi_ctx->log2_mb_size), 0, height - 1), slice_end);
 
                 if (dir) {
                     mv_x = -mv_x;
@@ -904,16 +979,16 @@ static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
             }
 }
 
-static void set_frame_data(MIContext *mi_ctx, int alpha, AVFrame *avf_out)
+static void set_frame_data(MIContext *mi_ctx, int alpha, AVFrame *avf_out,
+                           int slice_start, int slice_end)
 {
     int x, y, plane;
 
     for (plane = 0; plane < mi_ctx->nb_planes; plane++) {
         int width = avf_out->width;
-        int height = avf_out->height;
         int chroma = plane == 1 || plane == 2;
 
-        for (y = 0; y < height; y++)
+        for (y = slice_start; y < slice_end; y++)
             for (x = 0; x < width; x++) {
                 int x_mv, y_mv;
                 int weight_sum = 0;
@@ -962,7 +1037,8 @@ static void set_frame_data(MIContext *mi_ctx, int alpha, AVFrame *avf_out)
     }
 }
 
-static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int n, int alpha)
+static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int n, int alpha,
+                         int slice_start, int slice_end)
 {
     int sb_x, sb_y;
     int width = mi_ctx->frames[0].avf->width;
@@ -973,7 +1049,8 @@ static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, in
             Block *sb = &block->subs[sb_x + sb_y * 2];
 
             if (sb->sb)
-                var_size_bmc(mi_ctx, sb, x_mb + (sb_x << (n - 1)), y_mb + (sb_y << (n - 1)), n - 1, alpha);
+                var_size_bmc(mi_ctx, sb, x_mb + (sb_x << (n - 1)), y_mb + (sb_y << (n - 1)), n - 1, alpha,
+                             slice_start, slice_end);
             else {
                 int x, y;
                 int mv_x = sb->mvs[0][0] * 2;
@@ -984,7 +1061,7 @@ static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, in
                 int end_x = start_x + (1 << (n - 1));
                 int end_y = start_y + (1 << (n - 1));
 
-                for (y = start_y; y < end_y; y++)  {
+                for (y = FFMAX(start_y, slice_start); y < FFMIN(end_y, slice_end); y++)  {
                     int y_min = -y;
                     int y_max = height - y - 1;
                     for (x = start_x; x < end_x; x++) {
@@ -1001,7 +1078,8 @@ static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, in
         }
 }
 
-static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y, int alpha)
+static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y, int alpha,
+                           int slice_start, int slice_end)
 {
     int x, y;
     int width = mi_ctx->frames[0].avf->width;
@@ -1016,6 +1094,17 @@ static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y,
     int start_x, start_y;
     int startc_x, startc_y, endc_x, endc_y;
 
+    start_x = (mb_x << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2;
+    start_y = (mb_y << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2;
+
+    startc_x = av_clip(start_x, 0, width - 1);
+    startc_y = FFMAX(av_clip(start_y, 0, height - 1), slice_start);
+    endc_x = av_clip(start_x + (2 << mi_ctx->log2_mb_size), 0, width - 1);
+    endc_y = FFMIN(av_clip(start_y + (2 << mi_ctx->log2_mb_size), 0, height - 1), slice_end);
+
+    if (startc_y >= endc_y)
+        return;
+
     if (mi_ctx->mc_mode == MC_MODE_AOBMC)
         for (nb_y = FFMAX(0, mb_y - 1); nb_y < FFMIN(mb_y + 2, mi_ctx->b_height); nb_y++)
             for (nb_x = FFMAX(0, mb_x - 1); nb_x < FFMIN(mb_x + 2, mi_ctx->b_width); nb_x++) {
@@ -1026,14 +1115,6 @@ static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y,
                     sbads[nb_x - mb_x + 1 + (nb_y - mb_y + 1) * 3] = get_sbad(&mi_ctx->me_ctx, x_nb, y_nb, x_nb + block->mvs[0][0], y_nb + block->mvs[0][1]);
             }
 
-    start_x = (mb_x << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2;
-    start_y = (mb_y << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2;
-
-    startc_x = av_clip(start_x, 0, width - 1);
-    startc_y = av_clip(start_y, 0, height - 1);
-    endc_x = av_clip(start_x + (2 << mi_ctx->log2_mb_size), 0, width - 1);
-    endc_y = av_clip(start_y + (2 << mi_ctx->log2_mb_size), 0, height - 1);
-
     for (y = startc_y; y < endc_y; y++) {
         int y_min = -y;
         int y_max = height - y - 1;
@@ -1065,13 +1146,86 @@ static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y,
     }
 }
 
+static int blend_frames_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *avf_out = td->out;
+    int alpha = td->alpha;
+    int x, y, plane;
+
+    for (plane = 0; plane < mi_ctx->nb_planes; plane++) {
+        int width = avf_out->width;
+        int height = avf_out->height;
+        int slice_start, slice_end;
+
+        if (plane == 1 || plane == 2) {
+            width = AV_CEIL_RSHIFT(width, mi_ctx->log2_chroma_w);
+            height = AV_CEIL_RSHIFT(height, mi_ctx->log2_chroma_h);
+        }
+
+        slice_start = (height *  jobnr     ) / nb_jobs;
+        slice_end   = (height * (jobnr + 1)) / nb_jobs;
+
+        for (y = slice_start; y < slice_end; y++) {
+            for (x = 0; x < width; x++) {
+                avf_out->data[plane][x + y * avf_out->linesize[plane]] =
+                    (alpha  * mi_ctx->frames[2].avf->data[plane][x + y * mi_ctx->frames[2].avf->linesize[plane]] +
+                     (ALPHA_MAX - alpha) * mi_ctx->frames[1].avf->data[plane][x + y * mi_ctx->frames[1].avf->linesize[plane]] + 512) >> 10;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int mci_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData *td = arg;
+    const int width  = mi_ctx->frames[0].avf->width;
+    const int height = mi_ctx->frames[0].avf->height;
+    /* a chroma row is written from all of its luma rows, keep them in one slice */
+    const int nb_rows = AV_CEIL_RSHIFT(height, mi_ctx->log2_chroma_h);
+    const int slice_start = FFMIN(((nb_rows *  jobnr     ) / nb_jobs) << mi_ctx->log2_chroma_h, height);
+    const int slice_end   = FFMIN(((nb_rows * (jobnr + 1)) / nb_jobs) << mi_ctx->log2_chroma_h, height);
+    int x, y;
+
+    if (mi_ctx->me_mode == ME_MODE_BIDIR) {
+        bidirectional_obmc(mi_ctx, td->alpha, slice_start, slice_end);
+    } else if (mi_ctx->me_mode == ME_MODE_BILAT) {
+        int mb_x, mb_y;
+        Block *block;
+
+        for (y = slice_start; y < slice_end; y++)
+            for (x = 0; x < width; x++)
+                mi_ctx->pixel_refs[x + y * width].nb = 0;
+
+        for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
+            for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
+                block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
+
+                if (block->sb)
+                    var_size_bmc(mi_ctx, block, mb_x << mi_ctx->log2_mb_size, mb_y << mi_ctx->log2_mb_size, mi_ctx->log2_mb_size, td->alpha,
+                                 slice_start, slice_end);
+
+                bilateral_obmc(mi_ctx, block, mb_x, mb_y, td->alpha, slice_start, slice_end);
+
+            }
+    }
+
+    set_frame_data(mi_ctx, td->alpha, td->out, slice_start, slice_end);
+
+    return 0;
+}
+
 static void interpolate(AVFilterLink *inlink, AVFrame *avf_out)
 {
     AVFilterContext *ctx = inlink->dst;
     AVFilterLink *outlink = ctx->outputs[0];
     MIContext *mi_ctx = ctx->priv;
-    int x, y;
-    int plane, alpha;
+    ThreadData td = { .out = avf_out };
+    int alpha;
     int64_t pts;
 
     pts = av_rescale(avf_out->pts, (int64_t) ALPHA_MAX * outlink->time_base.num * inlink->time_base.den,
@@ -1097,57 +1251,23 @@ static void interpolate(AVFilterLink *inlink, AVFrame *avf_out)
         return;
     }
 
+    td.alpha = alpha;
+
     switch(mi_ctx->mi_mode) {
         case MI_MODE_DUP:
             av_frame_copy(avf_out, alpha > ALPHA_MAX / 2 ? mi_ctx->frames[2].avf : mi_ctx->frames[1].avf);
 
             break;
         case MI_MODE_BLEND:
-            for (plane = 0; plane < mi_ctx->nb_planes; plane++) {
-                int width = avf_out->width;
-                int height = avf_out->height;
-
-                if (plane == 1 || plane == 2) {
-                    width = AV_CEIL_RSHIFT(width, mi_ctx->log2_chroma_w);
-                    height = AV_CEIL_RSHIFT(height, mi_ctx->log2_chroma_h);
-                }
-
-                for (y = 0; y < height; y++) {
-                    for (x = 0; x < width; x++) {
-                        avf_out->data[plane][x + y * avf_out->linesize[plane]] =
-                            (alpha  * mi_ctx->frames[2].avf->data[plane][x + y * mi_ctx->frames[2].avf->linesize[plane]] +
-                             (ALPHA_MAX - alpha) * mi_ctx->frames[1].avf->data[plane][x + y * mi_ctx->frames[1].avf->linesize[plane]] + 512) >> 10;
-                    }
-                }
-            }
+            ff_filter_execute(ctx, blend_frames_slice, &td, NULL,
+                              FFMIN(AV_CEIL_RSHIFT(avf_out->height, mi_ctx->log2_chroma_h),
+                                    ff_filter_get_nb_threads(ctx)));
 
             break;
         case MI_MODE_MCI:
-            if (mi_ctx->me_mode == ME_MODE_BIDIR) {
-                bidirectional_obmc(mi_ctx, alpha);
-                set_frame_data(mi_ctx, alpha, avf_out);
-
-            } else if (mi_ctx->me_mode == ME_MODE_BILAT) {
-                int mb_x, mb_y;
-                Block *block;
-
-                for (y = 0; y < mi_ctx->frames[0].avf->height; y++)
-                    for (x = 0; x < mi_ctx->frames[0].avf->width; x++)
-                        mi_ctx->pixel_refs[x + y * mi_ctx->frames[0].avf->width].nb = 0;
-
-                for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-                    for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
-                        block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
-
-                        if (block->sb)
-                            var_size_bmc(mi_ctx, block, mb_x << mi_ctx->log2_mb_size, mb_y << mi_ctx->log2_mb_size, mi_ctx->log2_mb_size, alpha);
-
-                        bilateral_obmc(mi_ctx, block, mb_x, mb_y, alpha);
-
-                    }
-
-                set_frame_data(mi_ctx, alpha, avf_out);
-            }
+            ff_filter_execute(ctx, mci_slice, &td, NULL,
+                              FFMIN(AV_CEIL_RSHIFT(avf_out->height, mi_ctx->log2_chroma_h),
+                                    mi_ctx->nb_threads));
 
             break;
     }
@@ -1220,6 +1340,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&mi_ctx->pixel_mvs);
     av_freep(&mi_ctx->pixel_weights);
     av_freep(&mi_ctx->pixel_refs);
+    av_freep(&mi_ctx->thread_me_ctx);
     if (mi_ctx->int_blocks)
         for (m = 0; m < mi_ctx->b_count; m++)
             free_blocks(&mi_ctx->int_blocks[m], 0);
@@ -1261,4 +1382,5 @@ const AVFilter ff_vf_minterpolate = {
     FILTER_INPUTS(minterpolate_inputs),
     FILTER_OUTPUTS(minterpolate_outputs),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
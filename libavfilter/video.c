@@ -74,7 +74,8 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
         li->frame_pool = ff_frame_pool_video_init(CONFIG_MEMORY_POISONING
                                                      ? NULL
                                                      : av_buffer_allocz,
-                                                  w, h, link->format, align);
+                                                  w, h, link->format, align,
+                                                  link->dst->graph->buffer_pool_flags);
         if (!li->frame_pool)
             return NULL;
     } else {
@@ -91,7 +92,8 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
             li->frame_pool = ff_frame_pool_video_init(CONFIG_MEMORY_POISONING
                                                          ? NULL
                                                          : av_buffer_allocz,
-                                                      w, h, link->format, align);
+                                                      w, h, link->format, align,
+                                                      link->dst->graph->buffer_pool_flags);
             if (!li->frame_pool)
                 return NULL;
         }
@@ -0,0 +1,91 @@
+;*****************************************************************************
+;* x86-optimized functions for the EBU R128 K-weighting filter
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION .text
+
+; The operations are done in the same order as in the C version, without FMA,
+; so that the output is bitexact.
+
+;------------------------------------------------------------------------------
+; void ff_ebur128_filter_x<lanes>(double *dst, const double *src, ptrdiff_t stride,
+;                                 double *v, ptrdiff_t v_stride,
+;                                 const double (*coeffs)[4], int nb_frames)
+;------------------------------------------------------------------------------
+
+%macro EBUR128_FILTER 1 ; lanes
+cglobal ebur128_filter_x%1, 7, 7, 7, dst, src, stride, v, vstride, coeffs, len
+    shl       strideq, 3
+    shl      vstrideq, 3
+    movu           m1, [vq]
+    movu           m2, [vq + vstrideq]
+    lea            vq, [vq + vstrideq * 2]
+    movu           m3, [vq]
+    movu           m4, [vq + vstrideq]
+
+ALIGN 16
+.loop:
+    movu           m0, [srcq]
+    mulpd          m5, m1, [coeffsq + 0 * 32]
+    subpd          m0, m5
+    mulpd          m5, m2, [coeffsq + 1 * 32]
+    subpd          m0, m5
+    mulpd          m5, m3, [coeffsq + 2 * 32]
+    subpd          m0, m5
+    mulpd          m5, m4, [coeffsq + 3 * 32]
+    subpd          m0, m5
+
+    mulpd          m6, m0, [coeffsq + 4 * 32]
+    mulpd          m5, m1, [coeffsq + 5 * 32]
+    addpd          m6, m5
+    mulpd          m5, m2, [coeffsq + 6 * 32]
+    addpd          m6, m5
+    mulpd          m5, m3, [coeffsq + 7 * 32]
+    addpd          m6, m5
+    mulpd          m5, m4, [coeffsq + 8 * 32]
+    addpd          m6, m5
+    movu       [dstq], m6
+
+    mova           m4, m3
+    mova           m3, m2
+    mova           m2, m1
+    mova           m1, m0
+    add          srcq, strideq
+    add          dstq, strideq
+    dec          lend
+    jg .loop
+
+    movu    [vq + vstrideq], m4
+    movu           [vq], m3
+    sub            vq, vstrideq
+    movu           [vq], m2
+    sub            vq, vstrideq
+    movu           [vq], m1
+    RET
+%endmacro
+
+INIT_XMM sse2
+EBUR128_FILTER 2
+
+%if HAVE_AVX_EXTERNAL
+INIT_YMM avx
+EBUR128_FILTER 4
+%endif
@@ -30,6 +30,7 @@
 #include "avio_internal.h"
 #include "dash.h"
 #include "demux.h"
+#include "segment_prefetch.h"
 #include "url.h"
 
 #define INITIAL_BUFFER_SIZE 32768
@@ -109,6 +110,9 @@ struct representation {
     int64_t cur_seg_offset;
     int64_t cur_seg_size;
     struct fragment *cur_seg;
+    /* current fragment, if it was downloaded by the prefetcher */
+    uint8_t *seg_data;
+    size_t seg_data_size;
 
     /* Currently active Media Initialization Section */
     struct fragment *init_section;
@@ -154,6 +158,9 @@ typedef struct DASHContext {
     AVDictionary *avio_opts;
     int max_url_size;
     char *cenc_decryption_key;
+    int prefetch;
+    int64_t prefetch_max_size;
+    SegmentPrefetch *prefetcher;
 
     /* Flags for init section*/
     int is_init_section_common_video;
@@ -357,6 +364,7 @@ static void free_representation(struct representation *pls)
     av_freep(&pls->init_sec_buf);
     av_freep(&pls->pb.pub.buffer);
     ff_format_io_close(pls->parent, &pls->input);
+    av_freep(&pls->seg_data);
     if (pls->ctx) {
         pls->ctx->pb = NULL;
         avformat_close_input(&pls->ctx);
@@ -1674,6 +1682,15 @@ static int read_from_url(struct representation *pls, struct fragment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, pls->cur_seg_size - pls->cur_seg_offset);
 
+    if (pls->seg_data) {
+        ret = FFMIN(buf_size, pls->seg_data_size - pls->cur_seg_offset);
+        if (ret <= 0)
+            return AVERROR_EOF;
+        memcpy(buf, pls->seg_data + pls->cur_seg_offset, ret);
+        pls->cur_seg_offset += ret;
+        return ret;
+    }
+
     ret = avio_read(pls->input, buf, buf_size);
     if (ret > 0)
         pls->cur_seg_offset += ret;
@@ -1762,13 +1779,66 @@ static int update_init_section(struct representation *pls)
 static int64_t seek_data(void *opaque, int64_t offset, int whence)
 {
     struct representation *v = opaque;
-    if (v->n_fragments && !v->init_sec_data_len) {
+    if (v->n_fragments && !v->init_sec_data_len && v->input) {
         return avio_seek(v->input, offset, whence);
     }
 
     return AVERROR(ENOSYS);
 }
 
+static void prefetch_fragments(DASHContext *c, struct representation *pls)
+{
+    char *url = av_mallocz(c->max_url_size);
+    char *tmpfilename = av_mallocz(c->max_url_size);
+
+    if (!url || !tmpfilename)
+        goto end;
+
+    for (int i = 1; i <= c->prefetch; i++) {
+        int64_t seq = pls->cur_seq_no + i;
+        AVDictionary *opts = NULL;
+
+        if (pls->n_fragments) {
+            struct fragment *seg;
+
+            if (seq >= pls->n_fragments)
+                break;
+            seg = pls->fragments[seq];
+            ff_make_absolute_url(url, c->max_url_size, c->base_url, seg->url);
+            if (seg->size >= 0) {
+                av_dict_set_int(&opts, "offset", seg->url_offset, 0);
+                av_dict_set_int(&opts, "end_offset", seg->url_offset + seg->size, 0);
+            }
+        } else if (pls->url_template && seq <= pls->last_seq_no) {
+            ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, seq, 0,
+                                     get_segment_start_time_based_on_timeline(pls, seq));
+            ff_make_absolute_url(url, c->max_url_size, c->base_url, tmpfilename);
+        } else {
+            break;
+        }
+
+        if (!ishttp(url)) {
+            av_dict_free(&opts);
+            break;
+        }
+
+        av_dict_copy(&opts, c->avio_opts, 0);
+        ff_segment_prefetch_submit(c->prefetcher, pls->stream_index, seq, url, opts);
+        av_dict_free(&opts);
+    }
+
+end:
+    av_free(tmpfilename);
+    av_free(url);
+}
+
+static void reset_prefetch(DASHContext *c, struct representation *pls)
+{
+    av_freep(&pls->seg_data);
+    if (c->prefetcher)
+        ff_segment_prefetch_flush(c->prefetcher, pls->stream_index);
+}
+
 static int read_data(void *opaque, uint8_t *buf, int buf_size)
 {
     int ret = 0;
@@ -1776,7 +1846,7 @@ static int read_data(void *opaque, uint8_t *buf, int buf_size)
     DASHContext *c = v->parent->priv_data;
 
 restart:
-    if (!v->input) {
+    if (!v->input && !v->seg_data) {
         free_fragment(&v->cur_seg);
         v->cur_seg = get_current_fragment(v);
         if (!v->cur_seg) {
@@ -1789,16 +1859,26 @@ restart:
         if (ret)
             goto end;
 
-        ret = open_input(c, v, v->cur_seg);
-        if (ret < 0) {
-            if (ff_check_interrupt(c->interrupt_callback)) {
-                ret = AVERROR_EXIT;
-                goto end;
+        if (c->prefetcher &&
+            ff_segment_prefetch_get(c->prefetcher, v->stream_index, v->cur_seq_no,
+                                    &v->seg_data, &v->seg_data_size) >= 0) {
+            v->cur_seg_offset = 0;
+            v->cur_seg_size = v->cur_seg->size;
+        } else {
+            ret = open_input(c, v, v->cur_seg);
+            if (ret < 0) {
+                if (ff_check_interrupt(c->interrupt_callback)) {
+                    ret = AVERROR_EXIT;
+                    goto end;
+                }
+                av_log(v->parent, AV_LOG_WARNING, "Failed to open fragment of playlist\n");
+                v->cur_seq_no++;
+                goto restart;
             }
-            av_log(v->parent, AV_LOG_WARNING, "Failed to open fragment of playlist\n");
-            v->cur_seq_no++;
-            goto restart;
         }
+
+        if (c->prefetcher)
+            prefetch_fragments(c, v);
     }
 
     if (v->init_sec_buf_read_offset < v->init_sec_data_len) {
@@ -2029,6 +2109,15 @@ static int dash_read_header(AVFormatContext *s)
     if ((ret = parse_manifest(s, s->url, s->pb)) < 0)
         return ret;
 
+    /* the fragments of live streams are only known once they are due */
+    if (c->prefetch && !c->is_live) {
+        ret = ff_segment_prefetch_init(&c->prefetcher, s, c->prefetch,
+                                       c->prefetch_max_size);
+        if (ret < 0)
+            av_log(s, AV_LOG_WARNING, "Fragment prefetching is not available: %s\n",
+                   av_err2str(ret));
+    }
+
     /* If this isn't a live stream, fill the total duration of the
      * stream. */
     if (!c->is_live) {
@@ -2048,11 +2137,11 @@ static int dash_read_header(AVFormatContext *s)
             if (ret < 0)
                 return ret;
         }
+        rep->stream_index = stream_index;
         ret = open_demux_for_component(s, rep);
 
         if (ret)
             return ret;
-        rep->stream_index = stream_index;
         ++stream_index;
     }
 
@@ -2066,11 +2155,11 @@ static int dash_read_header(AVFormatContext *s)
             if (ret < 0)
                 return ret;
         }
+        rep->stream_index = stream_index;
         ret = open_demux_for_component(s, rep);
 
         if (ret)
             return ret;
-        rep->stream_index = stream_index;
         ++stream_index;
     }
 
@@ -2084,11 +2173,11 @@ static int dash_read_header(AVFormatContext *s)
             if (ret < 0)
                 return ret;
         }
+        rep->stream_index = stream_index;
         ret = open_demux_for_component(s, rep);
 
         if (ret)
             return ret;
-        rep->stream_index = stream_index;
         ++stream_index;
     }
 
@@ -2148,6 +2237,7 @@ static void recheck_discard_flags(AVFormatContext *s, struct representation **p,
         } else if (!needed && pls->ctx) {
             close_demux_for_component(pls);
             ff_format_io_close(pls->parent, &pls->input);
+            reset_prefetch(s->priv_data, pls);
             av_log(s, AV_LOG_INFO, "No longer receiving stream_index %d\n", pls->stream_index);
         }
     }
@@ -2210,6 +2300,7 @@ static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
             cur->init_sec_buf_read_offset = 0;
             cur->is_restart_needed = 0;
             ff_format_io_close(cur->parent, &cur->input);
+            av_freep(&cur->seg_data);
             ret = reopen_demux_for_component(s, cur);
         }
     }
@@ -2219,6 +2310,7 @@ static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
 static int dash_close(AVFormatContext *s)
 {
     DASHContext *c = s->priv_data;
+    ff_segment_prefetch_free(&c->prefetcher);
     free_audio_list(c);
     free_video_list(c);
     free_subtitle_list(c);
@@ -2248,6 +2340,7 @@ static int dash_seek(AVFormatContext *s, struct representation *pls, int64_t see
     }
 
     ff_format_io_close(pls->parent, &pls->input);
+    reset_prefetch(s->priv_data, pls);
 
     // find the nearest fragment
     if (pls->n_timelines > 0 && pls->fragment_timescale > 0) {
@@ -2346,6 +2439,10 @@ static const AVOption dash_options[] = {
         {.str = "aac,m4a,m4s,m4v,mov,mp4,webm,ts"},
         INT_MIN, INT_MAX, FLAGS},
     { "cenc_decryption_key", "Media decryption key (hex)", OFFSET(cenc_decryption_key), AV_OPT_TYPE_STRING, {.str = NULL}, INT_MIN, INT_MAX, .flags = FLAGS },
+    { "prefetch", "Number of fragments to download in parallel ahead of the read position",
+        OFFSET(prefetch), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 16, FLAGS },
+    { "prefetch_max_size", "Maximum size of the prefetched fragments held in memory",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20}, 0, INT64_MAX, FLAGS },
     {NULL}
 };
 
@@ -19,6 +19,9 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE     /* Needed for O_DIRECT */
+
 #include "config_components.h"
 
 #include "libavutil/avstring.h"
@@ -39,6 +42,7 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#include "file_prefetch.h"
 #include "os_support.h"
 #include "url.h"
 
@@ -96,6 +100,10 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int prefetch_blocks;
+    int prefetch_size;
+    int direct;
+    FilePrefetch *prefetch;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -106,6 +114,9 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "prefetch", "set number of blocks read ahead in the background", offsetof(FileContext, prefetch_blocks), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 256, AV_OPT_FLAG_DECODING_PARAM },
+    { "prefetch_size", "set size of the prefetched blocks", offsetof(FileContext, prefetch_size), AV_OPT_TYPE_INT, { .i64 = 262144 }, FILE_PREFETCH_ALIGN, 64 << 20, AV_OPT_FLAG_DECODING_PARAM },
+    { "direct", "bypass the page cache when prefetching", offsetof(FileContext, direct), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -141,6 +152,8 @@ static int file_read(URLContext *h, unsigned char *buf, int size)
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+    if (CONFIG_FILE_PROTOCOL && c->prefetch)
+        return ff_file_prefetch_read(c->prefetch, buf, size);
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
@@ -221,7 +234,11 @@ static int fd_dup(URLContext *h, int oldfd)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
-    int ret = close(c->fd);
+    int ret;
+
+    if (CONFIG_FILE_PROTOCOL)
+        ff_file_prefetch_free(&c->prefetch);
+    ret = close(c->fd);
     return (ret == -1) ? AVERROR(errno) : 0;
 }
 
@@ -237,6 +254,9 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
         return ret < 0 ? AVERROR(errno) : (S_ISFIFO(st.st_mode) ? 0 : st.st_size);
     }
 
+    if (CONFIG_FILE_PROTOCOL && c->prefetch)
+        return ff_file_prefetch_seek(c->prefetch, pos, whence);
+
     ret = lseek(c->fd, pos, whence);
 
     return ret < 0 ? AVERROR(errno) : ret;
@@ -284,8 +304,9 @@ static int file_open(URLContext *h, const char *filename, int flags)
 {
     FileContext *c = h->priv_data;
     int access;
-    int fd;
+    int fd, direct = 0;
     struct stat st;
+    int prefetch = c->prefetch_blocks && !(flags & AVIO_FLAG_WRITE) && !c->follow;
 
     av_strstart(filename, "file:", &filename);
 
@@ -303,13 +324,44 @@ static int file_open(URLContext *h, const char *filename, int flags)
 #ifdef O_BINARY
     access |= O_BINARY;
 #endif
-    fd = avpriv_open(filename, access, 0666);
+#ifdef O_DIRECT
+    if (prefetch && c->direct) {
+        /* Only the prefetch blocks are aligned as O_DIRECT requires. */
+        fd = avpriv_open(filename, access | O_DIRECT, 0666);
+        if (fd == -1)
+            av_log(h, AV_LOG_WARNING, "Could not open with O_DIRECT: %s\n",
+                   av_err2str(AVERROR(errno)));
+        else
+            direct = 1;
+    } else
+#endif
+        fd = -1;
+    if (fd == -1)
+        fd = avpriv_open(filename, access, 0666);
     if (fd == -1)
         return AVERROR(errno);
     c->fd = fd;
 
     h->is_streamed = !fstat(fd, &st) && S_ISFIFO(st.st_mode);
 
+    if (prefetch && !h->is_streamed) {
+        int ret = ff_file_prefetch_init(&c->prefetch, h, fd, c->prefetch_blocks,
+                                        FFALIGN(c->prefetch_size, FILE_PREFETCH_ALIGN));
+        if (ret == AVERROR(ENOSYS)) {
+            av_log(h, AV_LOG_WARNING, "Prefetching is not supported on this system\n");
+            if (direct) {
+                /* Plain reads into unaligned buffers fail with O_DIRECT. */
+                close(fd);
+                c->fd = fd = avpriv_open(filename, access, 0666);
+                if (fd == -1)
+                    return AVERROR(errno);
+            }
+        } else if (ret < 0) {
+            close(fd);
+            return ret;
+        }
+    }
+
     /* Buffer writes more than the default 32k to improve throughput especially
      * with networked file systems */
     if (!h->is_streamed && flags & AVIO_FLAG_WRITE)
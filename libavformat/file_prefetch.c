@@ -0,0 +1,578 @@
+/*
+ * Read-ahead for the file protocol
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * The file is read through a window of nb_blocks consecutive, aligned
+ * blocks starting at the block holding the read position. Whenever the read
+ * position leaves a block, that block is reused for the block following the
+ * window, so that nb_blocks reads are kept in flight ahead of the demuxer.
+ */
+
+/* for syscall() and MAP_POPULATE */
+#define _GNU_SOURCE
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#if HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "file_prefetch.h"
+
+#if HAVE_LINUX_IO_URING_H && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define PREFETCH_IO_URING 1
+#else
+#define PREFETCH_IO_URING 0
+#endif
+
+#if HAVE_PTHREADS && HAVE_UNISTD_H && !defined(_WIN32)
+#define PREFETCH_THREADS 1
+#else
+#define PREFETCH_THREADS 0
+#endif
+
+#define MAX_THREADS 4
+
+enum BlockState {
+    BLOCK_IDLE,
+    BLOCK_QUEUED,   ///< waiting for a worker thread
+    BLOCK_READING,  ///< read in progress, the buffer must not be touched
+    BLOCK_DONE,
+};
+
+typedef struct PrefetchBlock {
+    uint8_t *buf;
+    int64_t offset;
+    enum BlockState state;
+    int result;             ///< number of bytes read or AVERROR code
+#if PREFETCH_IO_URING
+    struct iovec iov;
+#endif
+} PrefetchBlock;
+
+struct FilePrefetch {
+    void *logctx;
+    int fd;
+    int block_size;
+    int nb_blocks;
+    PrefetchBlock *blocks;
+    uint8_t *buffer;
+
+    int head;               ///< index of the block holding the read position
+    int64_t base;           ///< offset of blocks[head]
+    int64_t pos;            ///< read position
+
+#if PREFETCH_IO_URING
+    int ring_fd;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned to_submit;
+#endif
+
+#if PREFETCH_THREADS
+    int nb_threads;
+    pthread_t threads[MAX_THREADS];
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_work;
+    pthread_cond_t cond_done;
+    int exiting;
+#endif
+};
+
+#if PREFETCH_IO_URING
+static int uring_init(FilePrefetch *pf)
+{
+    struct io_uring_params p = { 0 };
+    uint8_t *sq, *cq;
+    int fd;
+
+    fd = syscall(__NR_io_uring_setup, pf->nb_blocks, &p);
+    if (fd < 0)
+        return AVERROR(errno);
+    pf->ring_fd = fd;
+
+    pf->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    pf->cq_ring_size = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        pf->sq_ring_size = pf->cq_ring_size = FFMAX(pf->sq_ring_size, pf->cq_ring_size);
+
+    pf->sq_ring = mmap(NULL, pf->sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (pf->sq_ring == MAP_FAILED)
+        goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        pf->cq_ring = pf->sq_ring;
+    } else {
+        pf->cq_ring = mmap(NULL, pf->cq_ring_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (pf->cq_ring == MAP_FAILED)
+            goto fail;
+    }
+    pf->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    pf->sqes = mmap(NULL, pf->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (pf->sqes == MAP_FAILED)
+        goto fail;
+
+    sq = pf->sq_ring;
+    cq = pf->cq_ring;
+    pf->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    pf->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    pf->sq_array = (unsigned *)(sq + p.sq_off.array);
+    pf->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    pf->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    pf->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    pf->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    for (int i = 0; i < pf->nb_blocks; i++) {
+        pf->blocks[i].iov.iov_base = pf->blocks[i].buf;
+        pf->blocks[i].iov.iov_len  = pf->block_size;
+    }
+    return 0;
+
+fail:
+    if (pf->sq_ring && pf->sq_ring != MAP_FAILED)
+        munmap(pf->sq_ring, pf->sq_ring_size);
+    if (pf->cq_ring && pf->cq_ring != MAP_FAILED && pf->cq_ring != pf->sq_ring)
+        munmap(pf->cq_ring, pf->cq_ring_size);
+    close(fd);
+    pf->ring_fd = -1;
+    return AVERROR(ENOMEM);
+}
+
+static void uring_queue(FilePrefetch *pf, PrefetchBlock *b)
+{
+    /* At most nb_blocks reads are in flight, so the ring cannot overflow. */
+    unsigned tail = *pf->sq_tail;
+    unsigned idx  = tail & *pf->sq_mask;
+    struct io_uring_sqe *sqe = &pf->sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = IORING_OP_READV;
+    sqe->fd        = pf->fd;
+    sqe->addr      = (uintptr_t)&b->iov;
+    sqe->len       = 1;
+    sqe->off       = b->offset;
+    sqe->user_data = b - pf->blocks;
+    pf->sq_array[idx] = idx;
+    atomic_store_explicit((atomic_uint *)pf->sq_tail, tail + 1, memory_order_release);
+
+    b->state = BLOCK_READING;
+    pf->to_submit++;
+}
+
+static int uring_enter(FilePrefetch *pf, unsigned min_complete)
+{
+    int ret = syscall(__NR_io_uring_enter, pf->ring_fd, pf->to_submit, min_complete,
+                      min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if (ret < 0)
+        return errno == EINTR ? 0 : AVERROR(errno);
+    pf->to_submit -= ret;
+    return 0;
+}
+
+static void uring_reap(FilePrefetch *pf)
+{
+    unsigned head = *pf->cq_head;
+    unsigned tail = atomic_load_explicit((atomic_uint *)pf->cq_tail, memory_order_acquire);
+
+    for (; head != tail; head++) {
+        const struct io_uring_cqe *cqe = &pf->cqes[head & *pf->cq_mask];
+        PrefetchBlock *b = &pf->blocks[cqe->user_data];
+
+        b->result = cqe->res < 0 ? AVERROR(-cqe->res) : cqe->res;
+        b->state  = BLOCK_DONE;
+    }
+    atomic_store_explicit((atomic_uint *)pf->cq_head, head, memory_order_release);
+}
+
+static void uring_uninit(FilePrefetch *pf)
+{
+    for (int i = 0; i < pf->nb_blocks; i++) {
+        while (pf->blocks[i].state == BLOCK_READING) {
+            if (uring_enter(pf, 1) < 0)
+                break;
+            uring_reap(pf);
+        }
+    }
+    munmap(pf->sqes, pf->sqes_size);
+    if (pf->cq_ring != pf->sq_ring)
+        munmap(pf->cq_ring, pf->cq_ring_size);
+    munmap(pf->sq_ring, pf->sq_ring_size);
+    close(pf->ring_fd);
+}
+#endif /* PREFETCH_IO_URING */
+
+#if PREFETCH_THREADS
+static void *worker_thread(void *arg)
+{
+    FilePrefetch *pf = arg;
+
+    pthread_mutex_lock(&pf->mutex);
+    while (!pf->exiting) {
+        PrefetchBlock *b = NULL;
+        ssize_t ret;
+
+        /* Serve the block that will be needed first. */
+        for (int i = 0; i < pf->nb_blocks && !b; i++) {
+            PrefetchBlock *cur = &pf->blocks[(pf->head + i) % pf->nb_blocks];
+            if (cur->state == BLOCK_QUEUED)
+                b = cur;
+        }
+        if (!b) {
+            pthread_cond_wait(&pf->cond_work, &pf->mutex);
+            continue;
+        }
+
+        b->state = BLOCK_READING;
+        pthread_mutex_unlock(&pf->mutex);
+        do {
+            ret = pread(pf->fd, b->buf, pf->block_size, b->offset);
+        } while (ret < 0 && errno == EINTR);
+        pthread_mutex_lock(&pf->mutex);
+
+        b->result = ret < 0 ? AVERROR(errno) : ret;
+        b->state  = BLOCK_DONE;
+        pthread_cond_broadcast(&pf->cond_done);
+    }
+    pthread_mutex_unlock(&pf->mutex);
+
+    return NULL;
+}
+
+static int threads_init(FilePrefetch *pf)
+{
+    int ret;
+
+    if ((ret = pthread_mutex_init(&pf->mutex, NULL)))
+        return AVERROR(ret);
+    if ((ret = pthread_cond_init(&pf->cond_work, NULL))) {
+        pthread_mutex_destroy(&pf->mutex);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&pf->cond_done, NULL))) {
+        pthread_cond_destroy(&pf->cond_work);
+        pthread_mutex_destroy(&pf->mutex);
+        return AVERROR(ret);
+    }
+
+    for (int i = 0; i < FFMIN(pf->nb_blocks, MAX_THREADS); i++) {
+        if ((ret = pthread_create(&pf->threads[i], NULL, worker_thread, pf)))
+            break;
+        pf->nb_threads++;
+    }
+    if (!pf->nb_threads) {
+        pthread_cond_destroy(&pf->cond_done);
+        pthread_cond_destroy(&pf->cond_work);
+        pthread_mutex_destroy(&pf->mutex);
+        return AVERROR(ret);
+    }
+    return 0;
+}
+
+static void threads_uninit(FilePrefetch *pf)
+{
+    pthread_mutex_lock(&pf->mutex);
+    pf->exiting = 1;
+    pthread_cond_broadcast(&pf->cond_work);
+    pthread_mutex_unlock(&pf->mutex);
+
+    for (int i = 0; i < pf->nb_threads; i++)
+        pthread_join(pf->threads[i], NULL);
+
+    pthread_cond_destroy(&pf->cond_done);
+    pthread_cond_destroy(&pf->cond_work);
+    pthread_mutex_destroy(&pf->mutex);
+}
+#endif /* PREFETCH_THREADS */
+
+static void lock(FilePrefetch *pf)
+{
+#if PREFETCH_THREADS
+    if (pf->nb_threads)
+        pthread_mutex_lock(&pf->mutex);
+#endif
+}
+
+static void unlock(FilePrefetch *pf)
+{
+#if PREFETCH_THREADS
+    if (pf->nb_threads)
+        pthread_mutex_unlock(&pf->mutex);
+#endif
+}
+
+/* Must be called locked. */
+static void queue_block(FilePrefetch *pf, PrefetchBlock *b, int64_t offset)
+{
+    b->offset = offset;
+#if PREFETCH_THREADS
+    if (pf->nb_threads) {
+        b->state = BLOCK_QUEUED;
+        pthread_cond_signal(&pf->cond_work);
+        return;
+    }
+#endif
+#if PREFETCH_IO_URING
+    uring_queue(pf, b);
+#endif
+}
+
+/* Must be called locked. Returns with b no longer being read. */
+static int wait_block(FilePrefetch *pf, PrefetchBlock *b)
+{
+#if PREFETCH_THREADS
+    if (pf->nb_threads) {
+        if (b->state == BLOCK_QUEUED)
+            b->state = BLOCK_IDLE;
+        while (b->state == BLOCK_READING)
+            pthread_cond_wait(&pf->cond_done, &pf->mutex);
+        return 0;
+    }
+#endif
+#if PREFETCH_IO_URING
+    while (b->state == BLOCK_READING) {
+        int ret = uring_enter(pf, 1);
+        if (ret < 0)
+            return ret;
+        uring_reap(pf);
+    }
+#endif
+    return 0;
+}
+
+/* Must be called locked. Moves the window so that it starts at the block
+ * holding the read position. */
+static int move_window(FilePrefetch *pf)
+{
+    const int64_t window = (int64_t)pf->nb_blocks * pf->block_size;
+    int ret;
+
+    if (pf->pos < pf->base || pf->pos >= pf->base + window) {
+        for (int i = 0; i < pf->nb_blocks; i++)
+            if ((ret = wait_block(pf, &pf->blocks[i])) < 0)
+                return ret;
+        pf->head = 0;
+        pf->base = pf->pos - pf->pos % pf->block_size;
+        for (int i = 0; i < pf->nb_blocks; i++)
+            queue_block(pf, &pf->blocks[i], pf->base + (int64_t)i * pf->block_size);
+        return 0;
+    }
+
+    while (pf->pos >= pf->base + pf->block_size) {
+        PrefetchBlock *b = &pf->blocks[pf->head];
+        if ((ret = wait_block(pf, b)) < 0)
+            return ret;
+        queue_block(pf, b, pf->base + window);
+        pf->base += pf->block_size;
+        pf->head  = (pf->head + 1) % pf->nb_blocks;
+    }
+    return 0;
+}
+
+int ff_file_prefetch_read(FilePrefetch *pf, uint8_t *buf, int size)
+{
+    PrefetchBlock *b;
+    int64_t off;
+    int ret;
+
+    lock(pf);
+    ret = move_window(pf);
+    b = &pf->blocks[pf->head];
+    if (ret >= 0 && b->state != BLOCK_DONE) {
+#if PREFETCH_THREADS
+        if (pf->nb_threads) {
+            while (b->state != BLOCK_DONE)
+                pthread_cond_wait(&pf->cond_done, &pf->mutex);
+        }
+#endif
+#if PREFETCH_IO_URING
+        while (ret >= 0 && b->state != BLOCK_DONE) {
+            if ((ret = uring_enter(pf, 1)) >= 0)
+                uring_reap(pf);
+        }
+#endif
+    }
+#if PREFETCH_IO_URING
+    /* Make sure the blocks queued by move_window() are in flight. */
+    if (ret >= 0 && pf->to_submit)
+        ret = uring_enter(pf, 0);
+#endif
+    if (ret >= 0 && b->result < 0) {
+        /* Retry on the next call. */
+        ret = b->result;
+        queue_block(pf, b, b->offset);
+    }
+    unlock(pf);
+    if (ret < 0)
+        return ret;
+
+    /* The head block is only reused by this thread, no need for the lock. */
+    off = pf->pos - b->offset;
+    if (off < b->result) {
+        ret = FFMIN(size, b->result - off);
+        memcpy(buf, b->buf + off, ret);
+    } else if (!b->result) {
+        return AVERROR_EOF;
+    } else {
+        /* Short read that may not be at the end of the file. Read the block
+         * again, as the buffer and offset given to pread() must stay aligned
+         * for files opened with O_DIRECT. */
+        do {
+            ret = pread(pf->fd, b->buf, pf->block_size, b->offset);
+        } while (ret < 0 && errno == EINTR);
+        if (ret < 0)
+            return AVERROR(errno);
+        b->result = ret;
+        if (off >= b->result)
+            return AVERROR_EOF;
+        ret = FFMIN(size, b->result - off);
+        memcpy(buf, b->buf + off, ret);
+    }
+    pf->pos += ret;
+    return ret;
+}
+
+int64_t ff_file_prefetch_seek(FilePrefetch *pf, int64_t pos, int whence)
+{
+    struct stat st;
+
+    switch (whence) {
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        pos += pf->pos;
+        break;
+    case SEEK_END:
+        if (fstat(pf->fd, &st) < 0)
+            return AVERROR(errno);
+        pos += st.st_size;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+    return pf->pos = pos;
+}
+
+int ff_file_prefetch_init(FilePrefetch **ppf, void *logctx, int fd,
+                          int nb_blocks, int block_size)
+{
+    FilePrefetch *pf;
+    int ret = AVERROR(ENOSYS);
+
+    if (nb_blocks <= 0 || block_size <= 0 || block_size % FILE_PREFETCH_ALIGN)
+        return AVERROR(EINVAL);
+
+    pf = av_mallocz(sizeof(*pf));
+    if (!pf)
+        return AVERROR(ENOMEM);
+    pf->logctx     = logctx;
+    pf->fd         = fd;
+    pf->nb_blocks  = nb_blocks;
+    pf->block_size = block_size;
+    pf->base       = INT64_MIN / 2;
+#if PREFETCH_IO_URING
+    pf->ring_fd    = -1;
+#endif
+
+    pf->blocks = av_calloc(nb_blocks, sizeof(*pf->blocks));
+    pf->buffer = av_malloc((size_t)nb_blocks * block_size + FILE_PREFETCH_ALIGN - 1);
+    if (!pf->blocks || !pf->buffer) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (int i = 0; i < nb_blocks; i++) {
+        uintptr_t start = FFALIGN((uintptr_t)pf->buffer, FILE_PREFETCH_ALIGN);
+        pf->blocks[i].buf = (uint8_t *)start + (size_t)i * block_size;
+    }
+
+#if PREFETCH_IO_URING
+    ret = uring_init(pf);
+    if (ret >= 0) {
+        av_log(logctx, AV_LOG_DEBUG, "Prefetching %d blocks of %d bytes using io_uring\n",
+               nb_blocks, block_size);
+        *ppf = pf;
+        return 0;
+    }
+    av_log(logctx, AV_LOG_VERBOSE, "io_uring unavailable (%s), using threads\n",
+           av_err2str(ret));
+#endif
+#if PREFETCH_THREADS
+    ret = threads_init(pf);
+    if (ret >= 0) {
+        av_log(logctx, AV_LOG_DEBUG, "Prefetching %d blocks of %d bytes using %d threads\n",
+               nb_blocks, block_size, pf->nb_threads);
+        *ppf = pf;
+        return 0;
+    }
+#endif
+
+fail:
+    av_freep(&pf->blocks);
+    av_freep(&pf->buffer);
+    av_freep(&pf);
+    return ret;
+}
+
+void ff_file_prefetch_free(FilePrefetch **ppf)
+{
+    FilePrefetch *pf = *ppf;
+
+    if (!pf)
+        return;
+
+#if PREFETCH_THREADS
+    if (pf->nb_threads)
+        threads_uninit(pf);
+#endif
+#if PREFETCH_IO_URING
+    if (pf->ring_fd >= 0)
+        uring_uninit(pf);
+#endif
+    av_freep(&pf->blocks);
+    av_freep(&pf->buffer);
+    av_freep(ppf);
+}
@@ -0,0 +1,58 @@
+/*
+ * Read-ahead for the file protocol
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_FILE_PREFETCH_H
+#define AVFORMAT_FILE_PREFETCH_H
+
+#include <stdint.h>
+
+/**
+ * Alignment of the prefetch block offsets, sizes and buffers, sufficient
+ * for files opened with O_DIRECT.
+ */
+#define FILE_PREFETCH_ALIGN 4096
+
+typedef struct FilePrefetch FilePrefetch;
+
+/**
+ * Start reading ahead of the read position of fd, with up to nb_blocks
+ * reads of block_size bytes in flight. io_uring is used if the kernel
+ * allows it, worker threads otherwise.
+ *
+ * @param block_size multiple of FILE_PREFETCH_ALIGN
+ * @return 0 on success, AVERROR(ENOSYS) if no backend is available
+ */
+int ff_file_prefetch_init(FilePrefetch **pf, void *logctx, int fd,
+                          int nb_blocks, int block_size);
+
+/**
+ * Read up to size bytes at the read position, as read(2) would.
+ */
+int ff_file_prefetch_read(FilePrefetch *pf, uint8_t *buf, int size);
+
+/**
+ * Set the read position, as lseek(2) would. The blocks around the new
+ * position are only requested by the next read.
+ */
+int64_t ff_file_prefetch_seek(FilePrefetch *pf, int64_t pos, int whence);
+
+void ff_file_prefetch_free(FilePrefetch **pf);
+
+#endif /* AVFORMAT_FILE_PREFETCH_H */
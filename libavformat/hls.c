@@ -47,6 +47,7 @@
 #include "url.h"
 
 #include "hls_sample_encryption.h"
+#include "segment_prefetch.h"
 
 #define INITIAL_BUFFER_SIZE 32768
 
@@ -107,6 +108,9 @@ struct playlist {
     int input_read_done;
     AVIOContext *input_next;
     int input_next_requested;
+    /* current segment, if it was downloaded by the prefetcher */
+    uint8_t *seg_data;
+    size_t seg_data_size;
     AVFormatContext *parent;
     int index;
     AVFormatContext *ctx;
@@ -228,6 +232,9 @@ typedef struct HLSContext {
     int http_multiple;
     int http_seekable;
     int seg_max_retry;
+    int prefetch;
+    int64_t prefetch_max_size;
+    SegmentPrefetch *prefetcher;
     AVIOContext *playlist_pb;
     HLSCryptoContext  crypto_ctx;
 } HLSContext;
@@ -280,6 +287,7 @@ static void free_playlist_list(HLSContext *c)
         pls->input_read_done = 0;
         ff_format_io_close(c->ctx, &pls->input_next);
         pls->input_next_requested = 0;
+        av_freep(&pls->seg_data);
         if (pls->ctx) {
             pls->ctx->pb = NULL;
             avformat_close_input(&pls->ctx);
@@ -1072,6 +1080,15 @@ static int read_from_url(struct playlist *pls, struct segment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
 
+    if (pls->seg_data) {
+        ret = FFMIN(buf_size, pls->seg_data_size - pls->cur_seg_offset);
+        if (ret <= 0)
+            return AVERROR_EOF;
+        memcpy(buf, pls->seg_data + pls->cur_seg_offset, ret);
+        pls->cur_seg_offset += ret;
+        return ret;
+    }
+
     ret = avio_read(pls->input, buf, buf_size);
     if (ret > 0)
         pls->cur_seg_offset += ret;
@@ -1473,6 +1490,38 @@ static int playlist_needed(struct playlist *pls)
     return 0;
 }
 
+static void prefetch_segments(HLSContext *c, struct playlist *v)
+{
+    for (int i = 1; i <= c->prefetch; i++) {
+        int64_t n = v->cur_seq_no - v->start_seq_no + i;
+        AVDictionary *opts = NULL;
+        struct segment *seg;
+
+        if (n >= v->n_segments)
+            break;
+        seg = v->segments[n];
+        /* segments needing a key are opened by read_data() */
+        if (seg->key_type != KEY_NONE || !av_strstart(seg->url, "http", NULL))
+            break;
+
+        av_dict_copy(&opts, c->avio_opts, 0);
+        if (seg->size >= 0) {
+            av_dict_set_int(&opts, "offset", seg->url_offset, 0);
+            av_dict_set_int(&opts, "end_offset", seg->url_offset + seg->size, 0);
+        }
+        ff_segment_prefetch_submit(c->prefetcher, v->index, v->cur_seq_no + i,
+                                   seg->url, opts);
+        av_dict_free(&opts);
+    }
+}
+
+static void reset_prefetch(HLSContext *c, struct playlist *pls)
+{
+    av_freep(&pls->seg_data);
+    if (c->prefetcher)
+        ff_segment_prefetch_flush(c->prefetcher, pls->index);
+}
+
 static int read_data(void *opaque, uint8_t *buf, int buf_size)
 {
     struct playlist *v = opaque;
@@ -1487,7 +1536,7 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if (!v->seg_data && (!v->input || (c->http_persistent && v->input_read_done))) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1558,7 +1607,15 @@ reload:
         if (ret)
             return ret;
 
-        if (c->http_multiple == 1 && v->input_next_requested) {
+        if (c->prefetcher &&
+            ff_segment_prefetch_get(c->prefetcher, v->index, v->cur_seq_no,
+                                    &v->seg_data, &v->seg_data_size) >= 0) {
+            /* keep an idle persistent connection for the next segment */
+            if (v->input)
+                v->input_read_done = 1;
+            v->cur_seg_offset = 0;
+            ret = 0;
+        } else if (c->http_multiple == 1 && v->input_next_requested) {
             FFSWAP(AVIOContext *, v->input, v->input_next);
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
@@ -1585,9 +1642,12 @@ reload:
         }
         segment_retries = 0;
         just_opened = 1;
+
+        if (c->prefetcher)
+            prefetch_segments(c, v);
     }
 
-    if (c->http_multiple == -1) {
+    if (c->http_multiple == -1 && v->input) {
         uint8_t *http_version_opt = NULL;
         int r = av_opt_get(v->input, "http_version", AV_OPT_SEARCH_CHILDREN, &http_version_opt);
         if (r >= 0) {
@@ -1630,7 +1690,9 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (v->seg_data) {
+        av_freep(&v->seg_data);
+    } else if (c->http_persistent &&
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
@@ -1914,6 +1976,7 @@ static int hls_close(AVFormatContext *s)
 {
     HLSContext *c = s->priv_data;
 
+    ff_segment_prefetch_free(&c->prefetcher);
     free_playlist_list(c);
     free_variant_list(c);
     free_rendition_list(c);
@@ -1948,6 +2011,20 @@ static int hls_read_header(AVFormatContext *s)
        the range header */
     av_dict_set_int(&c->avio_opts, "seekable", c->http_seekable, 0);
 
+    if (c->prefetch) {
+        ret = ff_segment_prefetch_init(&c->prefetcher, s, c->prefetch,
+                                       c->prefetch_max_size);
+        if (ret < 0) {
+            av_log(s, AV_LOG_WARNING, "Segment prefetching is not available: %s\n",
+                   av_err2str(ret));
+        } else {
+            /* the prefetcher already requests the next segments */
+            if (c->http_multiple == 1)
+                av_log(s, AV_LOG_WARNING, "http_multiple is ignored with prefetch\n");
+            c->http_multiple = 0;
+        }
+    }
+
     if ((ret = parse_playlist(c, s->url, NULL, s->pb)) < 0)
         return ret;
 
@@ -2085,6 +2162,7 @@ static int hls_read_header(AVFormatContext *s)
             ff_format_io_close(pls->parent, &pls->input_next);
             pls->input_next = NULL;
             pls->input_next_requested = 0;
+            reset_prefetch(c, pls);
             pls->cur_seg_offset = 0;
             pls->cur_init_section = NULL;
             /* Reset EOF flag */
@@ -2242,6 +2320,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
             pls->input_next_requested = 0;
+            reset_prefetch(c, pls);
             pls->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving playlist %d\n", i);
@@ -2498,6 +2577,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
         pls->input_next_requested = 0;
+        reset_prefetch(c, pls);
         av_packet_unref(pls->pkt);
         pb->eof_reached = 0;
         /* Clear any buffered data */
@@ -2590,6 +2670,10 @@ static const AVOption hls_options[] = {
         OFFSET(seg_format_opts), AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, FLAGS},
     {"seg_max_retry", "Maximum number of times to reload a segment on error.",
      OFFSET(seg_max_retry), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS},
+    {"prefetch", "Number of segments to download in parallel ahead of the read position",
+        OFFSET(prefetch), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 16, FLAGS},
+    {"prefetch_max_size", "Maximum size of the prefetched segments held in memory",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
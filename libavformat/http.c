@@ -40,6 +40,7 @@
 #include "avformat.h"
 #include "http.h"
 #include "httpauth.h"
+#include "httppool.h"
 #include "internal.h"
 #include "network.h"
 #include "os_support.h"
@@ -143,6 +144,11 @@ typedef struct HTTPContext {
     unsigned int retry_after;
     int reconnect_max_retries;
     int reconnect_delay_total_max;
+    int connection_pool;
+    int pool_max_per_host;
+    int pool_idle_timeout;
+    /* set if hd was opened through the connection pool */
+    HTTPPoolConnection *pool_conn;
 } HTTPContext;
 
 #define OFFSET(x) offsetof(HTTPContext, x)
@@ -188,6 +194,9 @@ static const AVOption options[] = {
     { "resource", "The resource requested by a client", OFFSET(resource), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { "reply_code", "The http status code to return to a client", OFFSET(reply_code), AV_OPT_TYPE_INT, { .i64 = 200}, INT_MIN, 599, E},
     { "short_seek_size", "Threshold to favor readahead over seek.", OFFSET(short_seek_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+    { "connection_pool", "reuse idle connections of other contexts to the same server", OFFSET(connection_pool), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "pool_max_per_host", "max idle connections kept in the pool per server", OFFSET(pool_max_per_host), AV_OPT_TYPE_INT, { .i64 = 6 }, 0, INT_MAX, D },
+    { "pool_idle_timeout", "close pooled connections idle for longer than this many seconds", OFFSET(pool_idle_timeout), AV_OPT_TYPE_INT, { .i64 = 30 }, 0, INT_MAX / 1000000, D },
     { NULL }
 };
 
@@ -197,6 +206,14 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
 static int http_read_header(URLContext *h);
 static int http_shutdown(URLContext *h, int flags);
 
+static void http_close_cnx(URLContext **hd, HTTPPoolConnection **pool_conn)
+{
+    if (*pool_conn)
+        ff_http_pool_close(hd, pool_conn);
+    else
+        ffurl_closep(hd);
+}
+
 void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
 {
     memcpy(&((HTTPContext *)dest->priv_data)->auth_state,
@@ -272,7 +289,19 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 
     ff_url_join(buf, sizeof(buf), lower_proto, NULL, hostname, port, NULL);
 
-    if (!s->hd) {
+    if (!s->hd && s->connection_pool && !(h->flags & AVIO_FLAG_WRITE)) {
+        int64_t hits, misses;
+        int hit;
+
+        err = ff_http_pool_open(&s->hd, &s->pool_conn, &hit, buf,
+                                &h->interrupt_callback, options,
+                                h->protocol_whitelist, h->protocol_blacklist, h);
+        if (err >= 0) {
+            ff_http_pool_get_stats(&hits, &misses);
+            av_log(h, AV_LOG_DEBUG, "%s connection to %s, pool hits: %"PRId64", misses: %"PRId64"\n",
+                   hit ? "Reusing" : "Opened", buf, hits, misses);
+        }
+    } else if (!s->hd) {
         err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
                                    &h->interrupt_callback, options,
                                    h->protocol_whitelist, h->protocol_blacklist, h);
@@ -416,7 +445,7 @@ redo:
         /* restore the offset (http_connect resets it) */
         s->off = off;
 
-        ffurl_closep(&s->hd);
+        http_close_cnx(&s->hd, &s->pool_conn);
         goto redo;
     }
 
@@ -424,7 +453,7 @@ redo:
     if (s->http_code == 401) {
         if ((cur_auth_type == HTTP_AUTH_NONE || s->auth_state.stale) &&
             s->auth_state.auth_type != HTTP_AUTH_NONE && auth_attempts < 4) {
-            ffurl_closep(&s->hd);
+            http_close_cnx(&s->hd, &s->pool_conn);
             goto redo;
         } else
             goto fail;
@@ -432,7 +461,7 @@ redo:
     if (s->http_code == 407) {
         if ((cur_proxy_auth_type == HTTP_AUTH_NONE || s->proxy_auth_state.stale) &&
             s->proxy_auth_state.auth_type != HTTP_AUTH_NONE && auth_attempts < 4) {
-            ffurl_closep(&s->hd);
+            http_close_cnx(&s->hd, &s->pool_conn);
             goto redo;
         } else
             goto fail;
@@ -441,7 +470,7 @@ redo:
          s->http_code == 303 || s->http_code == 307 || s->http_code == 308) &&
         s->new_location) {
         /* url moved, get next */
-        ffurl_closep(&s->hd);
+        http_close_cnx(&s->hd, &s->pool_conn);
         if (redirects++ >= MAX_REDIRECTS)
             return AVERROR(EIO);
 
@@ -467,7 +496,7 @@ redo:
 
 fail:
     if (s->hd)
-        ffurl_closep(&s->hd);
+        http_close_cnx(&s->hd, &s->pool_conn);
     if (ret < 0)
         return ret;
     return ff_http_averror(s->http_code, AVERROR(EIO));
@@ -721,6 +750,10 @@ static int http_open(URLContext *h, const char *uri, int flags,
 
     s->filesize = UINT64_MAX;
 
+    /* pooled connections must not be closed by the server after the request */
+    if (s->connection_pool)
+        s->multiple_requests = 1;
+
     s->location = av_strdup(uri);
     if (!s->location)
         return AVERROR(ENOMEM);
@@ -1644,7 +1677,7 @@ static int http_buf_read(URLContext *h, uint8_t *buf, int size)
             }
             else if (!s->chunksize) {
                 av_log(h, AV_LOG_DEBUG, "Last chunk received, closing conn\n");
-                ffurl_closep(&s->hd);
+                http_close_cnx(&s->hd, &s->pool_conn);
                 return 0;
             }
             else if (s->chunksize == UINT64_MAX) {
@@ -1933,6 +1966,23 @@ static int http_shutdown(URLContext *h, int flags)
     return ret;
 }
 
+/* whether the response was read in full and the server keeps the
+ * connection open */
+static int http_connection_reusable(HTTPContext *s)
+{
+    uint64_t end = s->filesize;
+
+    if (!s->hd || !s->pool_conn || s->willclose || !s->end_header ||
+        s->buf_ptr != s->buf_end)
+        return 0;
+    if (s->chunksize != UINT64_MAX)
+        return s->chunkend;
+    /* a range response may end before the end of the file */
+    if (s->http_code == 206 && s->end_off)
+        end = FFMIN(end, s->end_off);
+    return end != UINT64_MAX && s->off >= end;
+}
+
 static int http_close(URLContext *h)
 {
     int ret = 0;
@@ -1947,8 +1997,13 @@ static int http_close(URLContext *h)
         /* Close the write direction by sending the end of chunked encoding. */
         ret = http_shutdown(h, h->flags);
 
-    if (s->hd)
-        ffurl_closep(&s->hd);
+    if (http_connection_reusable(s))
+        ff_http_pool_release(&s->hd, &s->pool_conn, s->pool_max_per_host,
+                             s->pool_idle_timeout * 1000000LL);
+    else
+        http_close_cnx(&s->hd, &s->pool_conn);
+    if (s->connection_pool)
+        ff_http_pool_expire();
     av_dict_free(&s->chained_options);
     av_dict_free(&s->cookie_dict);
     av_dict_free(&s->redirect_cache);
@@ -1961,6 +2016,7 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
 {
     HTTPContext *s = h->priv_data;
     URLContext *old_hd = s->hd;
+    HTTPPoolConnection *old_pool_conn = s->pool_conn;
     uint64_t old_off = s->off;
     uint8_t old_buf[BUFFER_SIZE];
     int old_buf_size, ret;
@@ -2009,19 +2065,21 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
     old_buf_size = s->buf_end - s->buf_ptr;
     memcpy(old_buf, s->buf_ptr, old_buf_size);
     s->hd = NULL;
+    s->pool_conn = NULL;
 
     /* if it fails, continue on old connection */
     if ((ret = http_open_cnx(h, &options)) < 0) {
         av_dict_free(&options);
         memcpy(s->buffer, old_buf, old_buf_size);
-        s->buf_ptr = s->buffer;
-        s->buf_end = s->buffer + old_buf_size;
-        s->hd      = old_hd;
-        s->off     = old_off;
+        s->buf_ptr   = s->buffer;
+        s->buf_end   = s->buffer + old_buf_size;
+        s->hd        = old_hd;
+        s->pool_conn = old_pool_conn;
+        s->off       = old_off;
         return ret;
     }
     av_dict_free(&options);
-    ffurl_close(old_hd);
+    http_close_cnx(&old_hd, &old_pool_conn);
     return off;
 }
 
@@ -0,0 +1,241 @@
+/*
+ * Process-wide pool of idle HTTP connections
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "libavutil/bprint.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "httppool.h"
+#include "url.h"
+
+struct HTTPPoolConnection {
+    /* interrupt callback of the current user */
+    AVIOInterruptCB int_cb;
+    char *key;
+
+    /* only used while the connection is in the pool */
+    URLContext *hd;
+    int64_t idle_since;
+    int64_t idle_timeout;
+};
+
+/* options of the lower protocols which make connections differ */
+static const char *const connection_opts[] = {
+    "ca_file", "cafile", "tls_verify", "cert_file", "key_file", "verifyhost",
+    "http_proxy", "local_addr", "local_port", "rw_timeout", "timeout", NULL
+};
+
+static AVMutex pool_mutex = AV_MUTEX_INITIALIZER;
+static HTTPPoolConnection **pool;
+static int pool_size;
+static int64_t pool_hits, pool_misses;
+
+static int pool_interrupt_cb(void *opaque)
+{
+    HTTPPoolConnection *conn = opaque;
+    return ff_check_interrupt(&conn->int_cb);
+}
+
+static char *make_key(const char *url, AVDictionary *options)
+{
+    AVBPrint key;
+    char *ret;
+
+    av_bprint_init(&key, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&key, "%s", url);
+    for (int i = 0; connection_opts[i]; i++) {
+        const AVDictionaryEntry *e = av_dict_get(options, connection_opts[i], NULL, 0);
+        if (e)
+            av_bprintf(&key, "|%s=%s", e->key, e->value);
+    }
+    if (av_bprint_finalize(&key, &ret) < 0)
+        return NULL;
+    return ret;
+}
+
+/* must be called with the mutex locked */
+static void pool_remove(int idx)
+{
+    memmove(pool + idx, pool + idx + 1, (pool_size - idx - 1) * sizeof(*pool));
+    pool_size--;
+}
+
+void ff_http_pool_close(URLContext **hd, HTTPPoolConnection **conn)
+{
+    ffurl_closep(hd);
+    if (*conn)
+        av_freep(&(*conn)->key);
+    av_freep(conn);
+}
+
+/* must be called with the mutex locked */
+static void pool_expire(int64_t now)
+{
+    for (int i = 0; i < pool_size; i++) {
+        HTTPPoolConnection *conn = pool[i];
+        if (now - conn->idle_since > conn->idle_timeout) {
+            pool_remove(i--);
+            ff_http_pool_close(&conn->hd, &conn);
+        }
+    }
+}
+
+/* check that the server did not close an idle connection */
+static int connection_alive(URLContext *hd)
+{
+    uint8_t buf[1];
+    int ret;
+
+    hd->flags |= AVIO_FLAG_NONBLOCK;
+    ret = ffurl_read(hd, buf, sizeof(buf));
+    hd->flags &= ~AVIO_FLAG_NONBLOCK;
+
+    return ret == AVERROR(EAGAIN);
+}
+
+int ff_http_pool_open(URLContext **hd, HTTPPoolConnection **pconn, int *hit,
+                      const char *url, const AVIOInterruptCB *int_cb,
+                      AVDictionary **options, const char *whitelist,
+                      const char *blacklist, URLContext *parent)
+{
+    HTTPPoolConnection *conn;
+    AVIOInterruptCB cb;
+    char *key;
+    int ret;
+
+    key = make_key(url, options ? *options : NULL);
+    if (!key)
+        return AVERROR(ENOMEM);
+
+    while (1) {
+        conn = NULL;
+
+        ff_mutex_lock(&pool_mutex);
+        pool_expire(av_gettime_relative());
+        /* the most recently used connection is the least likely to be closed */
+        for (int i = pool_size - 1; i >= 0; i--) {
+            if (!strcmp(pool[i]->key, key)) {
+                conn = pool[i];
+                pool_remove(i);
+                break;
+            }
+        }
+        ff_mutex_unlock(&pool_mutex);
+
+        if (!conn)
+            break;
+
+        *hd = conn->hd;
+        conn->hd = NULL;
+        conn->int_cb = int_cb ? *int_cb : (AVIOInterruptCB){ 0 };
+        if (connection_alive(*hd)) {
+            ff_mutex_lock(&pool_mutex);
+            pool_hits++;
+            ff_mutex_unlock(&pool_mutex);
+            av_free(key);
+            *pconn = conn;
+            *hit   = 1;
+            return 0;
+        }
+        ff_http_pool_close(hd, &conn);
+    }
+
+    conn = av_mallocz(sizeof(*conn));
+    if (!conn) {
+        av_free(key);
+        return AVERROR(ENOMEM);
+    }
+    conn->key    = key;
+    conn->int_cb = int_cb ? *int_cb : (AVIOInterruptCB){ 0 };
+    cb = (AVIOInterruptCB){ pool_interrupt_cb, conn };
+
+    ret = ffurl_open_whitelist(hd, url, AVIO_FLAG_READ_WRITE, &cb, options,
+                               whitelist, blacklist, parent);
+    if (ret < 0) {
+        ff_http_pool_close(hd, &conn);
+        return ret;
+    }
+
+    ff_mutex_lock(&pool_mutex);
+    pool_misses++;
+    ff_mutex_unlock(&pool_mutex);
+
+    *pconn = conn;
+    *hit   = 0;
+    return 0;
+}
+
+void ff_http_pool_release(URLContext **hd, HTTPPoolConnection **pconn,
+                          int max_per_host, int64_t idle_timeout)
+{
+    HTTPPoolConnection *conn = *pconn;
+    int nb_same = 0, ret = AVERROR(ENOSPC);
+
+    conn->int_cb       = (AVIOInterruptCB){ 0 };
+    conn->idle_since   = av_gettime_relative();
+    conn->idle_timeout = idle_timeout;
+    conn->hd           = *hd;
+
+    ff_mutex_lock(&pool_mutex);
+    pool_expire(conn->idle_since);
+    for (int i = 0; i < pool_size; i++)
+        nb_same += !strcmp(pool[i]->key, conn->key);
+    if (nb_same < max_per_host)
+        ret = av_dynarray_add_nofree(&pool, &pool_size, conn);
+    ff_mutex_unlock(&pool_mutex);
+
+    if (ret < 0) {
+        conn->hd = NULL;
+        ff_http_pool_close(hd, pconn);
+        return;
+    }
+
+    *hd    = NULL;
+    *pconn = NULL;
+}
+
+void ff_http_pool_expire(void)
+{
+    ff_mutex_lock(&pool_mutex);
+    pool_expire(av_gettime_relative());
+    ff_mutex_unlock(&pool_mutex);
+}
+
+void ff_http_pool_deinit(void)
+{
+    ff_mutex_lock(&pool_mutex);
+    for (int i = 0; i < pool_size; i++)
+        ff_http_pool_close(&pool[i]->hd, &pool[i]);
+    av_freep(&pool);
+    pool_size = 0;
+    ff_mutex_unlock(&pool_mutex);
+}
+
+void ff_http_pool_get_stats(int64_t *hits, int64_t *misses)
+{
+    ff_mutex_lock(&pool_mutex);
+    *hits   = pool_hits;
+    *misses = pool_misses;
+    ff_mutex_unlock(&pool_mutex);
+}
@@ -0,0 +1,96 @@
+/*
+ * Process-wide pool of idle HTTP connections
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HTTPPOOL_H
+#define AVFORMAT_HTTPPOOL_H
+
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+
+#include "avio.h"
+#include "url.h"
+
+/**
+ * Idle connections are kept until they were idle for longer than the
+ * timeout given when releasing them, which is checked whenever a pooled
+ * connection is opened, released or closed, or until
+ * avformat_network_deinit() closes all of them.
+ */
+
+/**
+ * State of a connection which can be returned to the pool. Pooled
+ * connections outlive the URLContext that opened them, so the interrupt
+ * callback of the lower protocols is routed through this.
+ */
+typedef struct HTTPPoolConnection HTTPPoolConnection;
+
+/**
+ * Take an idle connection to url out of the pool, or open a new one if
+ * there is none.
+ *
+ * Connections are only shared between users passing the same url and the
+ * same values for the options affecting the connection itself, e.g. the
+ * TLS certificate options.
+ *
+ * @param hd   set to the connection
+ * @param conn set to the pool state of the connection, which must be passed
+ *             to ff_http_pool_release() or ff_http_pool_close() with hd
+ * @param hit  set to 1 if the connection was taken from the pool
+ */
+int ff_http_pool_open(URLContext **hd, HTTPPoolConnection **conn, int *hit,
+                      const char *url, const AVIOInterruptCB *int_cb,
+                      AVDictionary **options, const char *whitelist,
+                      const char *blacklist, URLContext *parent);
+
+/**
+ * Put a connection into the pool. The response to the last request must
+ * have been read completely.
+ *
+ * @param max_per_host the connection is closed instead if there are that
+ *                     many idle connections for the same url
+ * @param idle_timeout the connection is closed once it was idle for longer,
+ *                     in microseconds
+ */
+void ff_http_pool_release(URLContext **hd, HTTPPoolConnection **conn,
+                          int max_per_host, int64_t idle_timeout);
+
+/**
+ * Close a connection opened with ff_http_pool_open().
+ */
+void ff_http_pool_close(URLContext **hd, HTTPPoolConnection **conn);
+
+/**
+ * Close the idle connections whose timeout expired.
+ */
+void ff_http_pool_expire(void);
+
+/**
+ * Close all idle connections and free the pool.
+ */
+void ff_http_pool_deinit(void);
+
+/**
+ * Get the number of connections taken from the pool and the number of
+ * connections opened because the pool had none.
+ */
+void ff_http_pool_get_stats(int64_t *hits, int64_t *misses);
+
+#endif /* AVFORMAT_HTTPPOOL_H */
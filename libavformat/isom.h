@@ -370,6 +370,9 @@ typedef struct MOVContext {
     int thmb_item_id;
     int64_t idat_offset;
     int interleaved_read;
+    int use_mmap;
+    int mmap_fd;            ///< descriptor of the input file if it can be mapped, -1 otherwise
+    long mmap_page_size;
 } MOVContext;
 
 int ff_mp4_read_descr_len(AVIOContext *pb);
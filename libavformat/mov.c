@@ -76,6 +76,17 @@
 #endif
 
 #include "qtpalette.h"
+#include "url.h"
+
+#if HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Samples smaller than this are read rather than mapped with the mmap option,
+ * as the mapping costs more than the copy. */
+#define MOV_MMAP_MIN_SIZE (64 << 10)
 
 /* those functions parse an atom */
 /* links atom IDs to parse functions */
@@ -10484,6 +10495,32 @@ static int mov_parse_lcevc_streams(AVFormatContext *s)
     return 0;
 }
 
+/**
+ * Get the descriptor of the input file, so that samples can be mapped
+ * instead of read. Only local files can be mapped.
+ */
+static int mov_init_mmap(AVFormatContext *s)
+{
+#if HAVE_MMAP
+    MOVContext *mov = s->priv_data;
+    URLContext *h = ffio_geturlcontext(s->pb);
+    struct stat st;
+    int fd;
+
+    if (!h || strcmp(h->prot->name, "file"))
+        return AVERROR(ENOSYS);
+    fd = ffurl_get_file_handle(h);
+    if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+        return AVERROR(ENOSYS);
+
+    mov->mmap_fd        = fd;
+    mov->mmap_page_size = sysconf(_SC_PAGESIZE);
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
 static int mov_read_header(AVFormatContext *s)
 {
     MOVContext *mov = s->priv_data;
@@ -10499,6 +10536,7 @@ static int mov_read_header(AVFormatContext *s)
     }
 
     mov->fc = s;
+    mov->mmap_fd = -1;
     mov->trak_index = -1;
     mov->thmb_item_id = -1;
     mov->primary_item_id = -1;
@@ -10714,6 +10752,10 @@ static int mov_read_header(AVFormatContext *s)
         if (mov->frag_index.item[i].moof_offset <= mov->fragment.moof_offset)
             mov->frag_index.item[i].headers_read = 1;
 
+    if (mov->use_mmap && (err = mov_init_mmap(s)) < 0)
+        av_log(s, AV_LOG_WARNING, "Could not map the file, reading it instead: %s\n",
+               av_err2str(err));
+
     return 0;
 }
 
@@ -10906,6 +10948,70 @@ static int mov_finalize_packet(AVFormatContext *s, AVStream *st, AVIndexEntry *s
     return 0;
 }
 
+/**
+ * Whether the packet for sample can be taken from a mapping of the file. The
+ * data must not need to be modified or rewritten, and small samples are
+ * cheaper to copy than to map. The pages holding the sample and its padding
+ * must also be inside the file, as accessing pages past its end raises SIGBUS.
+ */
+static int mov_sample_is_mapped(MOVContext *mov, AVStream *st, const AVIndexEntry *sample)
+{
+#if HAVE_MMAP
+    const MOVStreamContext *sc = st->priv_data;
+    struct stat st_file;
+
+    return mov->mmap_fd >= 0 && sc->pb == mov->fc->pb &&
+           !mov->aax_mode && !mov->decryption_key && !sc->iamf &&
+           st->codecpar->codec_id != AV_CODEC_ID_EIA_608 &&
+           sample->pos >= 0 && sample->size >= MOV_MMAP_MIN_SIZE &&
+           !fstat(mov->mmap_fd, &st_file) &&
+           sample->pos + sample->size + AV_INPUT_BUFFER_PADDING_SIZE <=
+           FFALIGN(st_file.st_size, mov->mmap_page_size);
+#else
+    return 0;
+#endif
+}
+
+#if HAVE_MMAP
+static void mov_unmap_packet(void *opaque, uint8_t *data)
+{
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+#endif
+
+/**
+ * Get the packet for a sample from a private mapping of the pages holding it.
+ * The padding is zeroed in the mapping, which only copies the last page, and
+ * writing to the packet does not modify the file.
+ */
+static int mov_get_mapped_packet(MOVContext *mov, const AVIndexEntry *sample, AVPacket *pkt)
+{
+#if HAVE_MMAP
+    int64_t start = sample->pos & ~(int64_t)(mov->mmap_page_size - 1);
+    size_t offset = sample->pos - start;
+    size_t size   = offset + sample->size + AV_INPUT_BUFFER_PADDING_SIZE;
+    uint8_t *data;
+
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, mov->mmap_fd, start);
+    if (data == MAP_FAILED)
+        return AVERROR(errno);
+    memset(data + offset + sample->size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    pkt->buf = av_buffer_create(data, size, mov_unmap_packet,
+                                (void *)(uintptr_t)size, 0);
+    if (!pkt->buf) {
+        munmap(data, size);
+        return AVERROR(ENOMEM);
+    }
+    pkt->data = data + offset;
+    pkt->size = sample->size;
+    pkt->pos  = sample->pos;
+    return pkt->size;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
 static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MOVContext *mov = s->priv_data;
@@ -10968,7 +11074,8 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
     }
 
     if (st->discard != AVDISCARD_ALL) {
-        int64_t ret64 = avio_seek(sc->pb, sample->pos, SEEK_SET);
+        int mapped = mov_sample_is_mapped(mov, st, sample);
+        int64_t ret64 = mapped ? sample->pos : avio_seek(sc->pb, sample->pos, SEEK_SET);
         if (ret64 != sample->pos) {
             av_log(mov->fc, AV_LOG_ERROR, "stream %d, offset 0x%"PRIx64": partial file\n",
                    sc->ffindex, sample->pos);
@@ -10985,7 +11092,9 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             goto retry;
         }
 
-        if (st->codecpar->codec_id == AV_CODEC_ID_EIA_608 && sample->size > 8)
+        if (mapped)
+            ret = mov_get_mapped_packet(mov, sample, pkt);
+        else if (st->codecpar->codec_id == AV_CODEC_ID_EIA_608 && sample->size > 8)
             ret = get_eia608_packet(sc->pb, pkt, sample->size);
 #if CONFIG_IAMFDEC
         else if (sc->iamf) {
@@ -11337,6 +11446,7 @@ static const AVOption mov_options[] = {
         {.i64 = 0}, 0, 1, FLAGS },
     { "max_stts_delta", "treat offsets above this value as invalid", OFFSET(max_stts_delta), AV_OPT_TYPE_INT, {.i64 = UINT_MAX-48000*10 }, 0, UINT_MAX, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "interleaved_read", "Interleave packets from multiple tracks at demuxer level", OFFSET(interleaved_read), AV_OPT_TYPE_BOOL, {.i64 = 1 }, 0, 1, .flags = AV_OPT_FLAG_DECODING_PARAM },
+    { "mmap", "Map the large samples of local files instead of copying them", OFFSET(use_mmap), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, .flags = AV_OPT_FLAG_DECODING_PARAM },
 
     { NULL },
 };
@@ -2929,6 +2929,18 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
     avio_seek(pb, -back, SEEK_CUR);
 
     for (i = 0; i < ts->resync_size; i++) {
+        /* look for the sync byte in the buffered data first */
+        int len = FFMIN(pb->buf_end - pb->buf_ptr, ts->resync_size - i);
+        if (len > 0) {
+            const uint8_t *sync = memchr(pb->buf_ptr, SYNC_BYTE, len);
+            if (!sync) {
+                avio_skip(pb, len);
+                i += len - 1;
+                continue;
+            }
+            i += sync - pb->buf_ptr;
+            avio_skip(pb, sync - pb->buf_ptr);
+        }
         c = avio_r8(pb);
         if (avio_feof(pb))
             return AVERROR_EOF;
@@ -2998,6 +3010,38 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
         avio_skip(pb, skip);
 }
 
+/**
+ * Handle the 188-byte packets which are already in the I/O buffer in one go,
+ * without going through read_packet() and avio_tell() for each of them.
+ * Packets of PIDs without a filter are dropped before being looked at.
+ *
+ * @return the number of packets handled or a negative error code
+ */
+static int handle_buffered_packets(MpegTSContext *ts, int max_packets)
+{
+    AVIOContext *pb = ts->stream->pb;
+    /* file position of the start of the buffer */
+    const int64_t buf_pos = avio_tell(pb) - (pb->buf_ptr - pb->buffer);
+    int n;
+
+    for (n = 0; n < max_packets && !ts->stop_parse; n++) {
+        const uint8_t *packet = pb->buf_ptr;
+        int ret;
+
+        if (pb->buf_end - packet < TS_PACKET_SIZE || packet[0] != SYNC_BYTE)
+            break;
+        pb->buf_ptr += TS_PACKET_SIZE;
+
+        if (!ts->pids[AV_RB16(packet + 1) & 0x1fff] && !ts->auto_guess)
+            continue;
+        ret = handle_packet(ts, packet, buf_pos + (pb->buf_ptr - pb->buffer));
+        if (ret < 0)
+            return ret;
+    }
+
+    return n;
+}
+
 static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
 {
     AVFormatContext *s = ts->stream;
@@ -3039,6 +3083,18 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
+        if (ts->raw_packet_size == TS_PACKET_SIZE) {
+            int max_packets = nb_packets ? FFMIN(nb_packets - packet_num, INT_MAX) : INT_MAX;
+            ret = handle_buffered_packets(ts, max_packets);
+            if (ret < 0)
+                break;
+            if (ret > 0) {
+                packet_num += ret - 1;
+                ret = 0;
+                continue;
+            }
+        }
+
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
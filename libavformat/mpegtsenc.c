@@ -131,6 +131,9 @@ typedef struct MpegTSWrite {
     uint8_t provider_name[256];
 
     int omit_video_pes_length;
+
+    /* null packet for CBR padding, built once at init */
+    uint8_t null_packet[TS_PACKET_SIZE];
 } MpegTSWrite;
 
 /* a PES packet header is generated every DEFAULT_PES_HEADER_FREQ packets */
@@ -1098,9 +1101,17 @@ static int mpegts_init(AVFormatContext *s)
     MpegTSWrite *ts = s->priv_data;
     AVDictionaryEntry *provider;
     const char *provider_name;
+    uint8_t *q;
     int i, j;
     int ret;
 
+    q    = ts->null_packet;
+    *q++ = SYNC_BYTE;
+    *q++ = 0x00 | (NULL_PID >> 8);
+    *q++ = NULL_PID & 0xff;
+    *q++ = 0x10;
+    memset(q, STUFFING_BYTE, TS_PACKET_SIZE - 4); /* data_bytes may be assigned any value */
+
     if (ts->m2ts_mode == -1) {
         if (av_match_ext(s->url, "m2ts")) {
             ts->m2ts_mode = 1;
@@ -1358,16 +1369,8 @@ static int write_pcr_bits(uint8_t *buf, int64_t pcr)
 /* Write a single null transport stream packet */
 static void mpegts_insert_null_packet(AVFormatContext *s)
 {
-    uint8_t *q;
-    uint8_t buf[TS_PACKET_SIZE];
-
-    q    = buf;
-    *q++ = SYNC_BYTE;
-    *q++ = 0x00 | (NULL_PID >> 8);
-    *q++ = NULL_PID & 0xff;
-    *q++ = 0x10;
-    memset(q, STUFFING_BYTE, TS_PACKET_SIZE - (q - buf)); /* data_bytes may be assigned any value */
-    write_packet(s, buf);
+    MpegTSWrite *ts = s->priv_data;
+    write_packet(s, ts->null_packet);
 }
 
 /* Write a single transport stream packet with a PCR and no payload */
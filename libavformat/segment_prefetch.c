@@ -0,0 +1,476 @@
+/*
+ * Parallel download of the media segments of adaptive streaming demuxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * The demuxer submits the segments following the one it is reading. Worker
+ * threads pick them up in submission order and download each into a memory
+ * buffer, which the demuxer takes over once it reaches that segment.
+ */
+
+#include "config.h"
+#include "config_components.h"
+
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "avio_internal.h"
+#include "http.h"
+#include "segment_prefetch.h"
+#include "url.h"
+
+#define MAX_THREADS 16
+#define READ_SIZE   (64 * 1024)
+
+enum JobState {
+    JOB_QUEUED,     ///< waiting for a worker thread
+    JOB_RUNNING,    ///< download in progress, owned by a worker
+    JOB_DONE,
+};
+
+typedef struct PrefetchJob {
+    int stream;
+    int64_t seq;
+    char *url;
+    AVDictionary *opts;
+
+    enum JobState state;
+    int ret;
+    /* set when the job was dropped while running, the worker frees it */
+    int abandoned;
+
+    uint8_t *data;
+    size_t size;
+    size_t allocated;
+} PrefetchJob;
+
+struct SegmentPrefetch {
+    AVFormatContext *s;
+    int64_t max_size;
+
+#if HAVE_THREADS
+    int nb_threads;
+    pthread_t threads[MAX_THREADS];
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+    int exiting;
+    AVIOInterruptCB int_cb;
+
+    /* in submission order */
+    PrefetchJob **jobs;
+    int nb_jobs;
+    /* data held by the jobs */
+    int64_t buffered;
+
+    /* statistics */
+    int nb_downloads;
+    int nb_failed;
+    int nb_hits;
+    int nb_misses;
+    int nb_connections;
+    int64_t bytes_downloaded;
+    int64_t download_time;
+};
+
+static void job_free(PrefetchJob **pjob)
+{
+    PrefetchJob *job = *pjob;
+
+    if (!job)
+        return;
+
+    av_freep(&job->url);
+    av_dict_free(&job->opts);
+    av_freep(&job->data);
+    av_freep(pjob);
+}
+
+#if HAVE_THREADS
+static int prefetch_interrupt_cb(void *opaque)
+{
+    SegmentPrefetch *sp = opaque;
+    return sp->exiting || ff_check_interrupt(&sp->s->interrupt_callback);
+}
+
+static void job_remove(SegmentPrefetch *sp, int idx)
+{
+    memmove(sp->jobs + idx, sp->jobs + idx + 1,
+            (sp->nb_jobs - idx - 1) * sizeof(*sp->jobs));
+    sp->nb_jobs--;
+}
+
+/* must be called with the mutex locked */
+static void job_drop(SegmentPrefetch *sp, int idx)
+{
+    PrefetchJob *job = sp->jobs[idx];
+
+    job_remove(sp, idx);
+
+    if (job->state == JOB_RUNNING) {
+        job->abandoned = 1;
+        return;
+    }
+
+    sp->buffered -= job->size;
+    job_free(&job);
+}
+
+static int open_segment(SegmentPrefetch *sp, AVIOContext **pb, PrefetchJob *job)
+{
+    AVFormatContext *s = sp->s;
+    AVDictionary *opts = NULL;
+    int ret;
+
+    av_dict_copy(&opts, job->opts, 0);
+    av_dict_set(&opts, "multiple_requests", "1", 0);
+
+#if CONFIG_HTTP_PROTOCOL
+    if (*pb) {
+        /* reuse the connection of the previous segment */
+        (*pb)->eof_reached = 0;
+        ret = ff_http_do_new_request2(ffio_geturlcontext(*pb), job->url, &opts);
+        if (ret >= 0)
+            goto end;
+
+        avio_closep(pb);
+        av_dict_free(&opts);
+        av_dict_copy(&opts, job->opts, 0);
+        av_dict_set(&opts, "multiple_requests", "1", 0);
+    }
+#else
+    avio_closep(pb);
+#endif
+
+    ret = ffio_open_whitelist(pb, job->url, AVIO_FLAG_READ, &sp->int_cb, &opts,
+                              s->protocol_whitelist, s->protocol_blacklist);
+    if (ret >= 0) {
+        pthread_mutex_lock(&sp->mutex);
+        sp->nb_connections++;
+        pthread_mutex_unlock(&sp->mutex);
+    }
+
+#if CONFIG_HTTP_PROTOCOL
+end:
+#endif
+    av_dict_free(&opts);
+    return ret;
+}
+
+static int download(SegmentPrefetch *sp, AVIOContext **pb, PrefetchJob *job)
+{
+    int ret = open_segment(sp, pb, job);
+    if (ret < 0)
+        return ret;
+
+    while (1) {
+        int abandoned;
+
+        if (job->allocated - job->size < READ_SIZE) {
+            size_t allocated = FFMAX(job->allocated * 2, READ_SIZE * 4);
+            uint8_t *data = av_realloc(job->data, allocated);
+            if (!data)
+                return AVERROR(ENOMEM);
+            job->data      = data;
+            job->allocated = allocated;
+        }
+
+        ret = avio_read(*pb, job->data + job->size, READ_SIZE);
+        if (ret == AVERROR_EOF || !ret)
+            break;
+        if (ret < 0)
+            return ret;
+
+        pthread_mutex_lock(&sp->mutex);
+        job->size    += ret;
+        sp->buffered += ret;
+        abandoned     = job->abandoned || sp->exiting;
+        pthread_mutex_unlock(&sp->mutex);
+
+        if (abandoned)
+            return AVERROR_EXIT;
+    }
+
+    return 0;
+}
+
+static PrefetchJob *next_job(SegmentPrefetch *sp)
+{
+    if (sp->buffered >= sp->max_size)
+        return NULL;
+
+    for (int i = 0; i < sp->nb_jobs; i++)
+        if (sp->jobs[i]->state == JOB_QUEUED)
+            return sp->jobs[i];
+
+    return NULL;
+}
+
+static void *worker_thread(void *arg)
+{
+    SegmentPrefetch *sp = arg;
+    AVIOContext *pb = NULL;
+
+    pthread_mutex_lock(&sp->mutex);
+
+    while (!sp->exiting) {
+        PrefetchJob *job = next_job(sp);
+        int64_t start;
+        int ret;
+
+        if (!job) {
+            pthread_cond_wait(&sp->cond, &sp->mutex);
+            continue;
+        }
+
+        job->state = JOB_RUNNING;
+        pthread_mutex_unlock(&sp->mutex);
+
+        start = av_gettime_relative();
+        ret = download(sp, &pb, job);
+        /* a connection is only reusable once the response was read in full */
+        if (ret < 0)
+            avio_closep(&pb);
+
+        pthread_mutex_lock(&sp->mutex);
+
+        if (ret < 0 && ret != AVERROR_EXIT)
+            av_log(sp->s, AV_LOG_WARNING, "Prefetching '%s' failed: %s\n",
+                   job->url, av_err2str(ret));
+
+        sp->download_time += av_gettime_relative() - start;
+        sp->bytes_downloaded += job->size;
+        sp->nb_downloads++;
+        sp->nb_failed += ret < 0;
+
+        if (job->abandoned) {
+            sp->buffered -= job->size;
+            job_free(&job);
+        } else {
+            job->state = JOB_DONE;
+            job->ret   = ret;
+        }
+        pthread_cond_broadcast(&sp->cond);
+    }
+
+    pthread_mutex_unlock(&sp->mutex);
+
+    avio_closep(&pb);
+
+    return NULL;
+}
+#endif /* HAVE_THREADS */
+
+int ff_segment_prefetch_init(SegmentPrefetch **psp, AVFormatContext *s,
+                             int nb_threads, int64_t max_size)
+{
+#if HAVE_THREADS
+    SegmentPrefetch *sp;
+    int ret;
+
+    sp = av_mallocz(sizeof(*sp));
+    if (!sp)
+        return AVERROR(ENOMEM);
+
+    sp->s        = s;
+    sp->max_size = max_size;
+    sp->int_cb   = (AVIOInterruptCB){ prefetch_interrupt_cb, sp };
+
+    if ((ret = pthread_mutex_init(&sp->mutex, NULL))) {
+        av_free(sp);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&sp->cond, NULL))) {
+        pthread_mutex_destroy(&sp->mutex);
+        av_free(sp);
+        return AVERROR(ret);
+    }
+
+    for (int i = 0; i < FFMIN(nb_threads, MAX_THREADS); i++) {
+        if ((ret = pthread_create(&sp->threads[i], NULL, worker_thread, sp)))
+            break;
+        sp->nb_threads++;
+    }
+    if (!sp->nb_threads) {
+        pthread_cond_destroy(&sp->cond);
+        pthread_mutex_destroy(&sp->mutex);
+        av_free(sp);
+        return AVERROR(ret);
+    }
+
+    *psp = sp;
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+int ff_segment_prefetch_submit(SegmentPrefetch *sp, int stream, int64_t seq,
+                               const char *url, const AVDictionary *opts)
+{
+#if HAVE_THREADS
+    PrefetchJob *job;
+    int ret = 0;
+
+    pthread_mutex_lock(&sp->mutex);
+
+    for (int i = 0; i < sp->nb_jobs; i++)
+        if (sp->jobs[i]->stream == stream && sp->jobs[i]->seq == seq)
+            goto end;
+
+    job = av_mallocz(sizeof(*job));
+    if (!job) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    job->stream = stream;
+    job->seq    = seq;
+    job->url    = av_strdup(url);
+    if (!job->url ||
+        (ret = av_dict_copy(&job->opts, opts, 0)) < 0 ||
+        (ret = av_dynarray_add_nofree(&sp->jobs, &sp->nb_jobs, job)) < 0) {
+        job_free(&job);
+        ret = ret < 0 ? ret : AVERROR(ENOMEM);
+        goto end;
+    }
+
+    pthread_cond_broadcast(&sp->cond);
+end:
+    pthread_mutex_unlock(&sp->mutex);
+    return ret;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+int ff_segment_prefetch_get(SegmentPrefetch *sp, int stream, int64_t seq,
+                            uint8_t **data, size_t *size)
+{
+#if HAVE_THREADS
+    PrefetchJob *job = NULL;
+    int idx, ret;
+
+    pthread_mutex_lock(&sp->mutex);
+
+    for (idx = 0; idx < sp->nb_jobs; idx++) {
+        PrefetchJob *cur = sp->jobs[idx];
+
+        if (cur->stream != stream)
+            continue;
+
+        if (cur->seq < seq) {
+            /* will never be read */
+            job_drop(sp, idx--);
+        } else if (cur->seq == seq) {
+            job = cur;
+            break;
+        }
+    }
+
+    /* opening the segment directly is no slower than waiting for a worker */
+    if (!job || job->state == JOB_QUEUED) {
+        if (job)
+            job_drop(sp, idx);
+        sp->nb_misses++;
+        ret = AVERROR(ENOENT);
+        goto end;
+    }
+
+    while (job->state == JOB_RUNNING)
+        pthread_cond_wait(&sp->cond, &sp->mutex);
+
+    for (int i = 0; i < sp->nb_jobs; i++) {
+        if (sp->jobs[i] == job) {
+            job_remove(sp, i);
+            break;
+        }
+    }
+    sp->buffered -= job->size;
+
+    ret = job->ret;
+    if (ret >= 0) {
+        *data = job->data;
+        *size = job->size;
+        job->data = NULL;
+        sp->nb_hits++;
+    } else {
+        sp->nb_misses++;
+    }
+    job_free(&job);
+
+    /* room for more downloads */
+    pthread_cond_broadcast(&sp->cond);
+end:
+    pthread_mutex_unlock(&sp->mutex);
+    return ret;
+#else
+    return AVERROR(ENOENT);
+#endif
+}
+
+void ff_segment_prefetch_flush(SegmentPrefetch *sp, int stream)
+{
+#if HAVE_THREADS
+    pthread_mutex_lock(&sp->mutex);
+    for (int i = 0; i < sp->nb_jobs; i++)
+        if (sp->jobs[i]->stream == stream)
+            job_drop(sp, i--);
+    pthread_cond_broadcast(&sp->cond);
+    pthread_mutex_unlock(&sp->mutex);
+#endif
+}
+
+void ff_segment_prefetch_free(SegmentPrefetch **psp)
+{
+    SegmentPrefetch *sp = *psp;
+
+    if (!sp)
+        return;
+
+#if HAVE_THREADS
+    pthread_mutex_lock(&sp->mutex);
+    sp->exiting = 1;
+    pthread_cond_broadcast(&sp->cond);
+    pthread_mutex_unlock(&sp->mutex);
+
+    for (int i = 0; i < sp->nb_threads; i++)
+        pthread_join(sp->threads[i], NULL);
+
+    pthread_cond_destroy(&sp->cond);
+    pthread_mutex_destroy(&sp->mutex);
+#endif
+
+    for (int i = 0; i < sp->nb_jobs; i++)
+        job_free(&sp->jobs[i]);
+    av_freep(&sp->jobs);
+
+    av_log(sp->s, AV_LOG_VERBOSE,
+           "Prefetched %d segments (%"PRId64" bytes, %d failed) on %d "
+           "connections at %.0f kbit/s per connection; %d hits, %d misses\n",
+           sp->nb_downloads, sp->bytes_downloaded, sp->nb_failed,
+           sp->nb_connections,
+           sp->download_time ? sp->bytes_downloaded * 8000.0 / sp->download_time : 0.0,
+           sp->nb_hits, sp->nb_misses);
+
+    av_freep(psp);
+}
@@ -0,0 +1,80 @@
+/*
+ * Parallel download of the media segments of adaptive streaming demuxers
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_SEGMENT_PREFETCH_H
+#define AVFORMAT_SEGMENT_PREFETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+
+#include "avformat.h"
+
+typedef struct SegmentPrefetch SegmentPrefetch;
+
+/**
+ * Start nb_threads worker threads downloading segments into memory. Each
+ * worker keeps its HTTP connection open across the segments it downloads.
+ * The segments are opened with the protocol white- and blacklists and the
+ * interrupt callback of s.
+ *
+ * @param max_size the workers do not start new downloads while the segments
+ *                 held in memory add up to more than this many bytes
+ * @return 0 on success, AVERROR(ENOSYS) if threads are not available
+ */
+int ff_segment_prefetch_init(SegmentPrefetch **sp, AVFormatContext *s,
+                             int nb_threads, int64_t max_size);
+
+/**
+ * Request the download of a segment. Does nothing if it is already requested.
+ *
+ * @param stream identifies the playlist or representation the segment
+ *               belongs to
+ * @param seq    sequence number of the segment in that playlist
+ * @param opts   options for opening url, e.g. a byte range; may be NULL
+ */
+int ff_segment_prefetch_submit(SegmentPrefetch *sp, int stream, int64_t seq,
+                               const char *url, const AVDictionary *opts);
+
+/**
+ * Get the contents of a segment, waiting for its download to complete if it
+ * is in progress. Requests for earlier segments of the same stream are
+ * dropped.
+ *
+ * @param data set to the segment data, which the caller must av_free()
+ * @return 0 on success, AVERROR(ENOENT) if the download was not started yet,
+ *         in which case the caller should open the segment itself, another
+ *         negative error code if the download failed
+ */
+int ff_segment_prefetch_get(SegmentPrefetch *sp, int stream, int64_t seq,
+                            uint8_t **data, size_t *size);
+
+/**
+ * Drop all the requests for segments of a stream, e.g. after seeking.
+ */
+void ff_segment_prefetch_flush(SegmentPrefetch *sp, int stream);
+
+/**
+ * Stop the workers, drop all the requests and log statistics.
+ */
+void ff_segment_prefetch_free(SegmentPrefetch **sp);
+
+#endif /* AVFORMAT_SEGMENT_PREFETCH_H */
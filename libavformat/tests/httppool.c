@@ -0,0 +1,148 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "libavutil/dict.h"
+#include "libavutil/time.h"
+
+#include "libavformat/httppool.h"
+#include "libavformat/network.h"
+
+static int listen_fd = -1;
+static char url[64];
+
+static int server_init(void)
+{
+    struct sockaddr_in addr = { 0 };
+    socklen_t len = sizeof(addr);
+
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0 ||
+        bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(listen_fd, 8) ||
+        getsockname(listen_fd, (struct sockaddr *)&addr, &len))
+        return AVERROR(ff_neterrno());
+    snprintf(url, sizeof(url), "tcp://127.0.0.1:%d", ntohs(addr.sin_port));
+    return 0;
+}
+
+/* server side of the connection opened last */
+static int server_accept(void)
+{
+    return accept(listen_fd, NULL, NULL);
+}
+
+static const char *closed_by_client(int fd)
+{
+    char c;
+
+    if (ff_network_wait_fd_timeout(fd, 0, 1000000, NULL) < 0)
+        return "open";
+    return recv(fd, &c, 1, 0) ? "open" : "closed";
+}
+
+static int pool_open(URLContext **hd, HTTPPoolConnection **conn, const char *rw_timeout)
+{
+    AVDictionary *opts = NULL;
+    int hit, ret;
+
+    if (rw_timeout)
+        av_dict_set(&opts, "rw_timeout", rw_timeout, 0);
+    ret = ff_http_pool_open(hd, conn, &hit, url, NULL, &opts, NULL, NULL, NULL);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        fprintf(stderr, "Could not open %s: %s\n", url, av_err2str(ret));
+        return ret;
+    }
+    printf("%s\n", hit ? "hit" : "miss");
+    return 0;
+}
+
+int main(void)
+{
+    URLContext *hd[2] = { NULL };
+    HTTPPoolConnection *conn[2] = { NULL };
+    int srv[2];
+    int64_t hits, misses;
+
+    if (ff_network_init() < 0 || server_init() < 0) {
+        fprintf(stderr, "Could not listen on the loopback interface\n");
+        return 1;
+    }
+
+    printf("open: ");
+    if (pool_open(&hd[0], &conn[0], NULL) < 0)
+        return 1;
+    srv[0] = server_accept();
+
+    printf("open after release: ");
+    ff_http_pool_release(&hd[0], &conn[0], 6, 30000000);
+    if (pool_open(&hd[0], &conn[0], NULL) < 0)
+        return 1;
+
+    printf("open with another rw_timeout: ");
+    ff_http_pool_release(&hd[0], &conn[0], 6, 30000000);
+    if (pool_open(&hd[1], &conn[1], "1000000") < 0)
+        return 1;
+    srv[1] = server_accept();
+    ff_http_pool_close(&hd[1], &conn[1]);
+    closesocket(srv[1]);
+
+    printf("open two connections: ");
+    if (pool_open(&hd[0], &conn[0], NULL) < 0 ||
+        pool_open(&hd[1], &conn[1], NULL) < 0)
+        return 1;
+    srv[1] = server_accept();
+    ff_http_pool_release(&hd[0], &conn[0], 1, 30000000);
+    ff_http_pool_release(&hd[1], &conn[1], 1, 30000000);
+    printf("connection beyond max_per_host: %s\n", closed_by_client(srv[1]));
+    closesocket(srv[1]);
+
+    printf("open after the server closed the idle connection: ");
+    closesocket(srv[0]);
+    if (pool_open(&hd[0], &conn[0], NULL) < 0)
+        return 1;
+    srv[0] = server_accept();
+
+    ff_http_pool_release(&hd[0], &conn[0], 6, 0);
+    av_usleep(1000);
+    ff_http_pool_expire();
+    printf("expired connection: %s\n", closed_by_client(srv[0]));
+    closesocket(srv[0]);
+
+    printf("open after expiry: ");
+    if (pool_open(&hd[0], &conn[0], NULL) < 0)
+        return 1;
+    srv[0] = server_accept();
+    ff_http_pool_release(&hd[0], &conn[0], 6, 30000000);
+    ff_http_pool_deinit();
+    printf("idle connection after deinit: %s\n", closed_by_client(srv[0]));
+    closesocket(srv[0]);
+
+    ff_http_pool_get_stats(&hits, &misses);
+    printf("hits %"PRId64", misses %"PRId64"\n", hits, misses);
+
+    closesocket(listen_fd);
+    ff_network_close();
+    return 0;
+}
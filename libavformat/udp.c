@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() */
 
 #include "avformat.h"
 #include "libavutil/avassert.h"
@@ -59,6 +60,16 @@
 #define IPPROTO_UDPLITE                                  136
 #endif
 
+#ifdef __linux__
+#include <netinet/udp.h>
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT                                      103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO                                          104
+#endif
+#endif
+
 #if HAVE_W32THREADS
 #undef HAVE_PTHREAD_CANCEL
 #define HAVE_PTHREAD_CANCEL 1
@@ -77,6 +88,16 @@
 #define UDP_RX_BUF_SIZE 393216
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_MAX_BATCH 64
+#define UDP_MAX_GSO_SIZE 65507
+
+#if HAVE_RECVMMSG
+/* ancillary data of a received datagram */
+typedef union UDPControl {
+    char buf[CMSG_SPACE(sizeof(struct timespec)) + 2 * CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+} UDPControl;
+#endif
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -115,6 +136,23 @@ typedef struct UDPContext {
     char *sources;
     char *block;
     IPSourceFilters filters;
+
+    /* batching of system calls */
+    int batch_size;
+    int gso;
+    int gro;
+    int timestamps;
+    int rx_batch;
+    uint8_t *rx_buf;
+
+    /* statistics */
+    int64_t nb_datagrams;
+    int64_t nb_calls;
+    int64_t nb_overruns;
+    uint32_t kernel_drops;
+    int64_t nb_delays;
+    int64_t delay_sum;
+    int64_t delay_max;
 } UDPContext;
 
 #define OFFSET(x) offsetof(UDPContext, x)
@@ -139,6 +177,10 @@ static const AVOption options[] = {
     { "timeout",        "set raise error timeout, in microseconds (only in read mode)",OFFSET(timeout),         AV_OPT_TYPE_INT,  {.i64 = 0}, 0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "batch_size",     "Number of datagrams sent or received per system call", OFFSET(batch_size), AV_OPT_TYPE_INT, { .i64 = 1 },      1, UDP_MAX_BATCH, .flags = D|E },
+    { "gso",            "Let the kernel split batches of datagrams to send (Linux only)", OFFSET(gso), AV_OPT_TYPE_BOOL, { .i64 = 0 },     0, 1,       E },
+    { "gro",            "Let the kernel coalesce received datagrams (Linux only)", OFFSET(gro), AV_OPT_TYPE_BOOL,    { .i64 = 0 },     0, 1,       D },
+    { "timestamps",     "Measure the receive delay with kernel timestamps", OFFSET(timestamps), AV_OPT_TYPE_BOOL,    { .i64 = 0 },     0, 1,       D },
     { NULL }
 };
 
@@ -478,7 +520,84 @@ static int udp_get_file_handle(URLContext *h)
     return s->udp_fd;
 }
 
+/* send buf, split into datagrams of pkt_size bytes if batching is enabled */
+static int udp_send(UDPContext *s, const uint8_t *buf, int size)
+{
+    int ret;
+
+#if HAVE_SENDMMSG
+    if (s->batch_size > 1 && !s->gso && size > s->pkt_size) {
+        struct mmsghdr msgs[UDP_MAX_BATCH];
+        struct iovec iov[UDP_MAX_BATCH];
+        int nb_msgs = 0;
+
+        for (int pos = 0; pos < size && nb_msgs < UDP_MAX_BATCH; pos += s->pkt_size) {
+            iov[nb_msgs].iov_base = (uint8_t *)buf + pos;
+            iov[nb_msgs].iov_len  = FFMIN(s->pkt_size, size - pos);
+            msgs[nb_msgs].msg_hdr = (struct msghdr) {
+                .msg_name    = s->is_connected ? NULL : &s->dest_addr,
+                .msg_namelen = s->is_connected ? 0    : s->dest_addr_len,
+                .msg_iov     = &iov[nb_msgs],
+                .msg_iovlen  = 1,
+            };
+            nb_msgs++;
+        }
+
+        ret = sendmmsg(s->udp_fd, msgs, nb_msgs, 0);
+        if (ret < 0)
+            return ff_neterrno();
+        s->nb_calls++;
+        s->nb_datagrams += ret;
+
+        size = 0;
+        for (int i = 0; i < ret; i++)
+            size += msgs[i].msg_len;
+        return size;
+    }
+#endif
+
+    if (!s->is_connected) {
+        ret = sendto (s->udp_fd, buf, size, 0,
+                      (struct sockaddr *) &s->dest_addr,
+                      s->dest_addr_len);
+    } else
+        ret = send(s->udp_fd, buf, size, 0);
+    if (ret < 0)
+        return ff_neterrno();
+
+    s->nb_calls++;
+    s->nb_datagrams += s->gso ? (ret + s->pkt_size - 1) / s->pkt_size : 1;
+    return ret;
+}
+
 #if HAVE_PTHREAD_CANCEL
+/* must be called with the mutex locked */
+static int rx_queue_datagram(URLContext *h, const uint8_t *buf, int len)
+{
+    UDPContext *s = h->priv_data;
+    uint8_t tmp[4];
+
+    s->nb_datagrams++;
+    if (av_fifo_can_write(s->fifo) < len + 4) {
+        /* No Space left */
+        if (s->overrun_nonfatal) {
+            av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                    "Surviving due to overrun_nonfatal option\n");
+            s->nb_overruns++;
+            return 0;
+        } else {
+            av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                    "To avoid, increase fifo_size URL option. "
+                    "To survive in such case, use overrun_nonfatal option\n");
+            return AVERROR(EIO);
+        }
+    }
+    AV_WL32(tmp, len);
+    av_fifo_write(s->fifo, tmp, 4);
+    av_fifo_write(s->fifo, buf, len);
+    return 0;
+}
+
 static void *circular_buffer_task_rx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -514,25 +633,125 @@ static void *circular_buffer_task_rx( void *_URLContext)
             }
             continue;
         }
+        s->nb_calls++;
         if (ff_ip_check_source_lists(&addr, &s->filters))
             continue;
-        AV_WL32(s->tmp, len);
-
-        if (av_fifo_can_write(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
-                continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
+        if ((s->circular_buffer_error = rx_queue_datagram(h, s->tmp + 4, len)) < 0)
+            goto end;
+        pthread_cond_signal(&s->cond);
+    }
+
+end:
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    return NULL;
+}
+
+#if HAVE_RECVMMSG
+/* must be called with the mutex locked */
+static int rx_queue_msg(URLContext *h, struct msghdr *msg, int len)
+{
+    UDPContext *s = h->priv_data;
+    const uint8_t *buf = msg->msg_iov->iov_base;
+    int seg_size = len;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+#ifdef UDP_GRO
+        if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int gso_size;
+            memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+            if (gso_size > 0)
+                seg_size = gso_size;
+        }
+#endif
+#ifdef SO_RXQ_OVFL
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+            memcpy(&s->kernel_drops, CMSG_DATA(cmsg), sizeof(s->kernel_drops));
+#endif
+#ifdef SCM_TIMESTAMPNS
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+            int64_t delay;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            delay = av_gettime() - (ts.tv_sec * INT64_C(1000000) + ts.tv_nsec / 1000);
+            s->nb_delays++;
+            s->delay_sum += delay;
+            s->delay_max  = FFMAX(s->delay_max, delay);
+        }
+#endif
+    }
+
+    if (ff_ip_check_source_lists(msg->msg_name, &s->filters))
+        return 0;
+
+    /* coalesced datagrams are queued separately */
+    while (len > 0) {
+        int size = FFMIN(len, seg_size);
+        int ret  = rx_queue_datagram(h, buf, size);
+        if (ret < 0)
+            return ret;
+        buf += size;
+        len -= size;
+    }
+    return 0;
+}
+
+static void *circular_buffer_task_rx_batch(void *_URLContext)
+{
+    URLContext *h = _URLContext;
+    UDPContext *s = h->priv_data;
+    struct mmsghdr msgs[UDP_MAX_BATCH];
+    struct iovec iov[UDP_MAX_BATCH];
+    struct sockaddr_storage addrs[UDP_MAX_BATCH];
+    UDPControl control[UDP_MAX_BATCH];
+    int old_cancelstate;
+
+    ff_thread_setname("udp-rx");
+
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
+    pthread_mutex_lock(&s->mutex);
+    if (ff_socket_nonblock(s->udp_fd, 0) < 0) {
+        av_log(h, AV_LOG_ERROR, "Failed to set blocking mode");
+        s->circular_buffer_error = AVERROR(EIO);
+        goto end;
+    }
+    while (1) {
+        int nb_msgs;
+
+        for (int i = 0; i < s->batch_size; i++) {
+            iov[i].iov_base = s->rx_buf + i * UDP_MAX_PKT_SIZE;
+            iov[i].iov_len  = UDP_MAX_PKT_SIZE;
+            msgs[i].msg_hdr = (struct msghdr) {
+                .msg_name       = &addrs[i],
+                .msg_namelen    = sizeof(addrs[i]),
+                .msg_iov        = &iov[i],
+                .msg_iovlen     = 1,
+                .msg_control    = control[i].buf,
+                .msg_controllen = sizeof(control[i].buf),
+            };
+        }
+
+        pthread_mutex_unlock(&s->mutex);
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
+        /* wait for the first datagram, then take what is already queued */
+        nb_msgs = recvmmsg(s->udp_fd, msgs, s->batch_size, MSG_WAITFORONE, NULL);
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
+        pthread_mutex_lock(&s->mutex);
+        if (nb_msgs < 0) {
+            if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
+                s->circular_buffer_error = ff_neterrno();
+                goto end;
+            }
+            continue;
+        }
+        s->nb_calls++;
+        for (int i = 0; i < nb_msgs; i++) {
+            int ret = rx_queue_msg(h, &msgs[i].msg_hdr, msgs[i].msg_len);
+            if (ret < 0) {
+                s->circular_buffer_error = ret;
                 goto end;
             }
         }
-        av_fifo_write(s->fifo, s->tmp, len + 4);
         pthread_cond_signal(&s->cond);
     }
 
@@ -541,6 +760,7 @@ end:
     pthread_mutex_unlock(&s->mutex);
     return NULL;
 }
+#endif
 
 static void *circular_buffer_task_tx( void *_URLContext)
 {
@@ -611,17 +831,11 @@ static void *circular_buffer_task_tx( void *_URLContext)
         while (len) {
             int ret;
             av_assert0(len > 0);
-            if (!s->is_connected) {
-                ret = sendto (s->udp_fd, p, len, 0,
-                            (struct sockaddr *) &s->dest_addr,
-                            s->dest_addr_len);
-            } else
-                ret = send(s->udp_fd, p, len, 0);
+            ret = udp_send(s, p, len);
             if (ret >= 0) {
                 len -= ret;
                 p   += ret;
             } else {
-                ret = ff_neterrno();
                 if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
                     pthread_mutex_lock(&s->mutex);
                     s->circular_buffer_error = ret;
@@ -725,6 +939,21 @@ static int udp_open(URLContext *h, const char *uri, int flags)
                        "'circular_buffer_size' option was set but it is not supported "
                        "on this build (pthread support is required)\n");
         }
+        if (av_find_info_tag(buf, sizeof(buf), "batch_size", p)) {
+            s->batch_size = strtol(buf, NULL, 10);
+            if (s->batch_size < 1 || s->batch_size > UDP_MAX_BATCH) {
+                av_log(h, AV_LOG_ERROR, "batch_size(%d) should be in range [1,%d]\n",
+                       s->batch_size, UDP_MAX_BATCH);
+                ret = AVERROR(EINVAL);
+                goto fail;
+            }
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "gso", p))
+            s->gso = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "gro", p))
+            s->gro = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "timestamps", p))
+            s->timestamps = strtol(buf, NULL, 10);
         if (av_find_info_tag(buf, sizeof(buf), "bitrate", p)) {
             s->bitrate = strtoll(buf, NULL, 10);
             if (!HAVE_PTHREAD_CANCEL)
@@ -759,7 +988,19 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     /* handling needed to support options picking from both AVOption and URL */
     s->circular_buffer_size *= 188;
     if (flags & AVIO_FLAG_WRITE) {
-        h->max_packet_size = s->pkt_size;
+        /* batches are written in one go and split into datagrams by
+         * udp_send() or the kernel */
+        if (s->batch_size > 1) {
+            int max_size = s->gso ? UDP_MAX_GSO_SIZE : UDP_MAX_PKT_SIZE;
+            s->batch_size = av_clip(max_size / s->pkt_size, 1, s->batch_size);
+        }
+        if (!HAVE_SENDMMSG && !s->gso && s->batch_size > 1) {
+            av_log(h, AV_LOG_WARNING,
+                   "'batch_size' option was set but it is not supported "
+                   "on this build (sendmmsg() support is required)\n");
+            s->batch_size = 1;
+        }
+        h->max_packet_size = s->pkt_size * s->batch_size;
     } else {
         h->max_packet_size = UDP_MAX_PKT_SIZE;
     }
@@ -911,6 +1152,55 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         /* make the socket non-blocking */
         ff_socket_nonblock(udp_fd, 1);
     }
+
+    if (is_output && s->gso && s->batch_size > 1) {
+#ifdef UDP_SEGMENT
+        if (setsockopt(udp_fd, IPPROTO_UDP, UDP_SEGMENT, &s->pkt_size, sizeof(s->pkt_size)) < 0) {
+            ff_log_net_error(h, AV_LOG_ERROR, "setsockopt(UDP_SEGMENT)");
+            ret = ff_neterrno();
+            goto fail;
+        }
+#else
+        av_log(h, AV_LOG_ERROR, "UDP segmentation offload is not supported on this platform\n");
+        ret = AVERROR(ENOSYS);
+        goto fail;
+#endif
+    }
+
+    if (!is_output && (s->batch_size > 1 || s->gro || s->timestamps)) {
+#if HAVE_RECVMMSG && HAVE_PTHREAD_CANCEL
+        /* batched receiving is done by the circular buffer thread */
+        s->rx_batch = !!s->circular_buffer_size;
+#endif
+        if (!s->rx_batch) {
+            av_log(h, AV_LOG_WARNING,
+                   "'batch_size', 'gro' and 'timestamps' options require "
+                   "recvmmsg() and the circular buffer; ignoring them\n");
+        } else {
+            int one = 1;
+#ifdef SO_RXQ_OVFL
+            if (setsockopt(udp_fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) < 0)
+                ff_log_net_error(h, AV_LOG_DEBUG, "setsockopt(SO_RXQ_OVFL)");
+#endif
+            if (s->gro) {
+#ifdef UDP_GRO
+                if (setsockopt(udp_fd, IPPROTO_UDP, UDP_GRO, &one, sizeof(one)) < 0)
+#endif
+                    av_log(h, AV_LOG_WARNING, "UDP generic receive offload is not available\n");
+            }
+            if (s->timestamps) {
+#ifdef SO_TIMESTAMPNS
+                if (setsockopt(udp_fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) < 0)
+#endif
+                    av_log(h, AV_LOG_WARNING, "Kernel receive timestamps are not available\n");
+            }
+            s->rx_buf = av_malloc(s->batch_size * UDP_MAX_PKT_SIZE);
+            if (!s->rx_buf) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+        }
+    }
     if (s->is_connected) {
         if (connect(udp_fd, (struct sockaddr *) &s->dest_addr, s->dest_addr_len)) {
             ff_log_net_error(h, AV_LOG_ERROR, "connect");
@@ -952,7 +1242,12 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             ret = AVERROR(ret);
             goto cond_fail;
         }
-        ret = pthread_create(&s->circular_buffer_thread, NULL, is_output?circular_buffer_task_tx:circular_buffer_task_rx, h);
+        ret = pthread_create(&s->circular_buffer_thread, NULL,
+                             is_output   ? circular_buffer_task_tx       :
+#if HAVE_RECVMMSG
+                             s->rx_batch ? circular_buffer_task_rx_batch :
+#endif
+                                           circular_buffer_task_rx, h);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_create failed : %s\n", strerror(ret));
             ret = AVERROR(ret);
@@ -973,6 +1268,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep2(&s->fifo);
+    av_freep(&s->rx_buf);
     ff_ip_reset_filters(&s->filters);
     return ret;
 }
@@ -1046,8 +1342,10 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     ret = recvfrom(s->udp_fd, buf, size, 0, (struct sockaddr *)&addr, &addr_len);
     if (ret < 0)
         return ff_neterrno();
+    s->nb_calls++;
     if (ff_ip_check_source_lists(&addr, &s->filters))
         return AVERROR(EINTR);
+    s->nb_datagrams++;
     return ret;
 }
 
@@ -1091,14 +1389,7 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
             return ret;
     }
 
-    if (!s->is_connected) {
-        ret = sendto (s->udp_fd, buf, size, 0,
-                      (struct sockaddr *) &s->dest_addr,
-                      s->dest_addr_len);
-    } else
-        ret = send(s->udp_fd, buf, size, 0);
-
-    return ret < 0 ? ff_neterrno() : ret;
+    return udp_send(s, buf, size);
 }
 
 static int udp_close(URLContext *h)
@@ -1142,7 +1433,19 @@ static int udp_close(URLContext *h)
 #endif
     closesocket(s->udp_fd);
     av_fifo_freep2(&s->fifo);
+    av_freep(&s->rx_buf);
     ff_ip_reset_filters(&s->filters);
+
+    av_log(h, AV_LOG_VERBOSE, "%s %"PRId64" datagrams in %"PRId64" system calls",
+           h->flags & AVIO_FLAG_READ ? "Received" : "Sent",
+           s->nb_datagrams, s->nb_calls);
+    if (h->flags & AVIO_FLAG_READ)
+        av_log(h, AV_LOG_VERBOSE, ", %"PRId64" dropped in the circular buffer, "
+               "%"PRIu32" dropped by the kernel", s->nb_overruns, s->kernel_drops);
+    if (s->nb_delays)
+        av_log(h, AV_LOG_VERBOSE, ", receive delay %.3f ms on average, %.3f ms at most",
+               s->delay_sum / 1000.0 / s->nb_delays, s->delay_max / 1000.0);
+    av_log(h, AV_LOG_VERBOSE, "\n");
     return 0;
 }
 
@@ -16,16 +16,52 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
 #include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
 
+#include "config.h"
+
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#if HAVE_LINUX_MEMPOLICY_H
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include "avassert.h"
 #include "buffer_internal.h"
 #include "common.h"
+#include "error.h"
 #include "mem.h"
 #include "thread.h"
 
+#if HAVE_MMAP && defined(MAP_ANONYMOUS)
+#define POOL_USE_MMAP 1
+#else
+#define POOL_USE_MMAP 0
+#endif
+#if HAVE_LINUX_MEMPOLICY_H && defined(SYS_getcpu) && defined(SYS_mbind)
+#define POOL_USE_NUMA 1
+#else
+#define POOL_USE_NUMA 0
+#endif
+
+/* memory held by all the buffer pools of the process, in bytes */
+static atomic_int_least64_t pool_mem_allocated = 0;
+static atomic_int_least64_t pool_mem_in_use    = 0;
+static atomic_int_least64_t pool_mem_peak      = 0;
+
+#define POOL_HUGEPAGE_SIZE (2 << 20)
+/* smaller buffers are not worth a mapping of their own */
+#define POOL_MAP_MIN_SIZE  (64 << 10)
+
 static AVBufferRef *buffer_create(AVBuffer *buf, uint8_t *data, size_t size,
                                   void (*free)(void *opaque, uint8_t *data),
                                   void *opaque, int flags)
@@ -299,6 +335,70 @@ AVBufferPool *av_buffer_pool_init(size_t size, AVBufferRef* (*alloc)(size_t size
     return pool;
 }
 
+int av_buffer_pool_set_flags(AVBufferPool *pool, int flags)
+{
+    int ret = 0;
+
+    ff_mutex_lock(&pool->mutex);
+    if (pool->pool || atomic_load(&pool->refcount) > 1)
+        ret = AVERROR(EINVAL);
+    else if (!pool->alloc2 &&
+             (pool->alloc == av_buffer_alloc || pool->alloc == av_buffer_allocz))
+        pool->flags = flags;
+    ff_mutex_unlock(&pool->mutex);
+
+    return ret;
+}
+
+/* must be called with the pool locked */
+static void pool_account(AVBufferPool *pool, int allocated, int in_use)
+{
+    const int64_t size = pool->size;
+
+    pool->nb_allocated += allocated;
+    pool->nb_in_use    += in_use;
+
+    if (allocated) {
+        int64_t total = atomic_fetch_add_explicit(&pool_mem_allocated, allocated * size,
+                                                  memory_order_relaxed) + allocated * size;
+        int64_t peak  = atomic_load_explicit(&pool_mem_peak, memory_order_relaxed);
+
+        while (total > peak &&
+               !atomic_compare_exchange_weak_explicit(&pool_mem_peak, &peak, total,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+            ;
+
+        pool->peak_allocated = FFMAX(pool->peak_allocated, pool->nb_allocated);
+    }
+    if (in_use)
+        atomic_fetch_add_explicit(&pool_mem_in_use, in_use * size,
+                                  memory_order_relaxed);
+}
+
+int64_t av_buffer_pool_get_memory(AVBufferPool *pool, int64_t *in_use, int64_t *peak)
+{
+    int64_t allocated;
+
+    if (!pool) {
+        if (in_use)
+            *in_use = atomic_load_explicit(&pool_mem_in_use, memory_order_relaxed);
+        if (peak)
+            *peak   = atomic_load_explicit(&pool_mem_peak, memory_order_relaxed);
+        return atomic_load_explicit(&pool_mem_allocated, memory_order_relaxed);
+    }
+
+    ff_mutex_lock(&pool->mutex);
+    allocated = pool->nb_allocated * pool->size;
+    if (in_use)
+        *in_use = pool->nb_in_use * pool->size;
+    if (peak)
+        *peak   = pool->peak_allocated * pool->size;
+    ff_mutex_unlock(&pool->mutex);
+
+    return allocated;
+}
+
 static void buffer_pool_flush(AVBufferPool *pool)
 {
     while (pool->pool) {
@@ -307,6 +407,7 @@ static void buffer_pool_flush(AVBufferPool *pool)
 
         buf->free(buf->opaque, buf->data);
         av_freep(&buf);
+        pool_account(pool, -1, 0);
     }
 }
 
@@ -350,21 +451,106 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     ff_mutex_lock(&pool->mutex);
     buf->next = pool->pool;
     pool->pool = buf;
+    pool_account(pool, 0, -1);
     ff_mutex_unlock(&pool->mutex);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
 }
 
+static int pool_current_node(void)
+{
+#if POOL_USE_NUMA
+    unsigned cpu, node;
+
+    if (!syscall(SYS_getcpu, &cpu, &node, NULL))
+        return node;
+#endif
+    return -1;
+}
+
+#if POOL_USE_MMAP
+static void pool_unmap_buffer(void *opaque, uint8_t *data)
+{
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+
+/* allocate a buffer in a mapping of its own, so that the page size and the
+ * NUMA policy can be chosen for it */
+static AVBufferRef *pool_map_buffer(AVBufferPool *pool, int node)
+{
+    size_t   map_size = pool->size;
+    uint8_t *data     = MAP_FAILED;
+    AVBufferRef *ret;
+
+    if ((pool->flags & AV_BUFFER_POOL_FLAG_HUGEPAGES) &&
+        pool->size >= POOL_HUGEPAGE_SIZE) {
+        map_size = FFALIGN(pool->size, POOL_HUGEPAGE_SIZE);
+#ifdef MAP_HUGETLB
+        data = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+#ifdef MADV_HUGEPAGE
+        if (data == MAP_FAILED) {
+            /* no reserved huge pages, fall back to transparent ones, which
+             * need the mapping to be aligned to the huge page size */
+            uint8_t *map = mmap(NULL, map_size + POOL_HUGEPAGE_SIZE,
+                                PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (map != MAP_FAILED) {
+                size_t head = FFALIGN((uintptr_t)map, POOL_HUGEPAGE_SIZE) -
+                              (uintptr_t)map;
+                if (head)
+                    munmap(map, head);
+                munmap(map + head + map_size, POOL_HUGEPAGE_SIZE - head);
+                data = map + head;
+                madvise(data, map_size, MADV_HUGEPAGE);
+            }
+        }
+#endif
+    }
+
+    if (data == MAP_FAILED) {
+        map_size = pool->size;
+        data = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED)
+            return NULL;
+    }
+
+#if POOL_USE_NUMA
+    /* the pages are not touched yet, so this decides where they end up */
+    if ((pool->flags & AV_BUFFER_POOL_FLAG_NUMA_LOCAL) &&
+        node >= 0 && node < sizeof(unsigned long) * 8 - 1) {
+        unsigned long nodemask = 1UL << node;
+        syscall(SYS_mbind, data, map_size, MPOL_PREFERRED,
+                &nodemask, sizeof(nodemask) * 8, 0);
+    }
+#endif
+
+    ret = av_buffer_create(data, pool->size, pool_unmap_buffer,
+                           (void *)(uintptr_t)map_size, 0);
+    if (!ret)
+        munmap(data, map_size);
+
+    return ret;
+}
+#endif
+
 /* allocate a new buffer and override its free() callback so that
  * it is returned to the pool on free */
-static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
+static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool, int node)
 {
     BufferPoolEntry *buf;
     AVBufferRef     *ret;
 
     av_assert0(pool->alloc || pool->alloc2);
 
+#if POOL_USE_MMAP
+    if (pool->flags && pool->size >= POOL_MAP_MIN_SIZE)
+        ret = pool_map_buffer(pool, node);
+    else
+#endif
     ret = pool->alloc2 ? pool->alloc2(pool->opaque, pool->size) :
                          pool->alloc(pool->size);
     if (!ret)
@@ -380,31 +566,49 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
     buf->opaque = ret->buffer->opaque;
     buf->free   = ret->buffer->free;
     buf->pool   = pool;
+    buf->node   = node;
 
     ret->buffer->opaque = buf;
     ret->buffer->free   = pool_release_buffer;
 
+    pool_account(pool, 1, 1);
+
     return ret;
 }
 
 AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
 {
     AVBufferRef *ret;
-    BufferPoolEntry *buf;
+    BufferPoolEntry *buf, **pbuf;
+    int node = -1;
+
+    if (pool->flags & AV_BUFFER_POOL_FLAG_NUMA_LOCAL)
+        node = pool_current_node();
 
     ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
+    pbuf = &pool->pool;
+    if (node >= 0) {
+        /* prefer a buffer from the node we are running on */
+        for (BufferPoolEntry **p = pbuf; *p; p = &(*p)->next) {
+            if ((*p)->node == node) {
+                pbuf = p;
+                break;
+            }
+        }
+    }
+    buf = *pbuf;
     if (buf) {
         memset(&buf->buffer, 0, sizeof(buf->buffer));
         ret = buffer_create(&buf->buffer, buf->data, pool->size,
                             pool_release_buffer, buf, 0);
         if (ret) {
-            pool->pool = buf->next;
+            *pbuf = buf->next;
             buf->next = NULL;
             buf->buffer.flags_internal |= BUFFER_FLAG_NO_FREE;
+            pool_account(pool, 0, 1);
         }
     } else {
-        ret = pool_alloc_buffer(pool);
+        ret = pool_alloc_buffer(pool, node);
     }
     ff_mutex_unlock(&pool->mutex);
 
@@ -284,6 +284,39 @@ AVBufferPool *av_buffer_pool_init2(size_t size, void *opaque,
                                    AVBufferRef* (*alloc)(void *opaque, size_t size),
                                    void (*pool_free)(void *opaque));
 
+/**
+ * @defgroup lavu_bufferpool_flags Buffer pool flags
+ * Allocation policies for av_buffer_pool_set_flags().
+ * @{
+ */
+/**
+ * Back large buffers with huge pages: explicitly reserved ones if available,
+ * transparent huge pages otherwise. Buffers smaller than a huge page are not
+ * affected.
+ */
+#define AV_BUFFER_POOL_FLAG_HUGEPAGES  (1 << 0)
+/**
+ * Place new buffers on the NUMA node of the thread allocating them, and
+ * prefer reusing buffers from the node of the calling thread.
+ */
+#define AV_BUFFER_POOL_FLAG_NUMA_LOCAL (1 << 1)
+/**
+ * @}
+ */
+
+/**
+ * Set the allocation policy of a buffer pool.
+ *
+ * The flags only apply to pools using the default allocator,
+ * av_buffer_alloc() or av_buffer_allocz(), and are silently ignored where the
+ * system does not support them.
+ *
+ * @param pool  the pool, which must not have allocated any buffers yet
+ * @param flags a combination of AV_BUFFER_POOL_FLAG_*
+ * @return 0 on success, AVERROR(EINVAL) if the pool already allocated buffers
+ */
+int av_buffer_pool_set_flags(AVBufferPool *pool, int flags);
+
 /**
  * Mark the pool as being available for freeing. It will actually be freed only
  * once all the allocated buffers associated with the pool are released. Thus it
@@ -315,6 +348,23 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool);
  */
 void *av_buffer_pool_buffer_get_opaque(const AVBufferRef *ref);
 
+/**
+ * Get the amount of memory held by a buffer pool, or by all the buffer pools
+ * of the process. Every buffer is accounted for with the size the pool was
+ * created with. This function may be called simultaneously from multiple
+ * threads.
+ *
+ * @param pool   the pool to query, or NULL for the totals over all the pools
+ *               that currently exist
+ * @param in_use if non-NULL, set to the size of the buffers that are currently
+ *               referenced, i.e. obtained with av_buffer_pool_get() and not
+ *               released yet
+ * @param peak   if non-NULL, set to the highest value ever returned for pool
+ * @return size of all the buffers allocated by the pool(s) and not freed yet,
+ *         including the unreferenced ones kept for reuse
+ */
+int64_t av_buffer_pool_get_memory(AVBufferPool *pool, int64_t *in_use, int64_t *peak);
+
 /**
  * @}
  */
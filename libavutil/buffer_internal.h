@@ -78,6 +78,9 @@ typedef struct BufferPoolEntry {
     AVBufferPool *pool;
     struct BufferPoolEntry *next;
 
+    /* NUMA node the data was allocated on, -1 if unknown */
+    int node;
+
     /*
      * An AVBuffer structure to (re)use as AVBuffer for subsequent uses
      * of this BufferPoolEntry.
@@ -105,6 +108,18 @@ struct AVBufferPool {
     AVBufferRef* (*alloc)(size_t size);
     AVBufferRef* (*alloc2)(void *opaque, size_t size);
     void         (*pool_free)(void *opaque);
+
+    /* AV_BUFFER_POOL_FLAG_* */
+    int flags;
+
+    /*
+     * Number of buffers allocated by the pool and not freed yet, of those the
+     * number currently handed out, and the highest nb_allocated ever reached.
+     * Protected by mutex.
+     */
+    size_t nb_allocated;
+    size_t nb_in_use;
+    size_t peak_allocated;
 };
 
 #endif /* AVUTIL_BUFFER_INTERNAL_H */
@@ -0,0 +1,152 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/error.h"
+#include "libavutil/macros.h"
+
+/* larger than a huge page */
+#define BIG_SIZE (3 << 20)
+
+static int nb_custom_allocs;
+
+static void print_memory(const char *what, AVBufferPool *pool)
+{
+    int64_t in_use, peak;
+    int64_t allocated = av_buffer_pool_get_memory(pool, &in_use, &peak);
+
+    printf("%-24s allocated %6"PRId64" in use %6"PRId64" peak %6"PRId64"\n",
+           what, allocated, in_use, peak);
+}
+
+static AVBufferRef *custom_alloc(size_t size)
+{
+    nb_custom_allocs++;
+    return av_buffer_alloc(size);
+}
+
+static int test_flags(int flags)
+{
+    AVBufferPool *pool = av_buffer_pool_init(BIG_SIZE, av_buffer_allocz);
+    AVBufferRef *buf;
+    const uint8_t *data;
+    int zeroed, reused, ret;
+
+    if (!pool)
+        return AVERROR(ENOMEM);
+
+    ret = av_buffer_pool_set_flags(pool, flags);
+    printf("flags %d: set %d", flags, ret);
+
+    buf = av_buffer_pool_get(pool);
+    if (!buf) {
+        av_buffer_pool_uninit(&pool);
+        return AVERROR(ENOMEM);
+    }
+    zeroed = !buf->data[0] && !memcmp(buf->data, buf->data + 1, BIG_SIZE - 1);
+    memset(buf->data, 0xaa, BIG_SIZE);
+    data = buf->data;
+    av_buffer_unref(&buf);
+
+    buf = av_buffer_pool_get(pool);
+    if (!buf) {
+        av_buffer_pool_uninit(&pool);
+        return AVERROR(ENOMEM);
+    }
+    reused = buf->data == data && buf->data[BIG_SIZE - 1] == 0xaa;
+    printf(", zeroed %d, reused %d", zeroed, reused);
+
+    /* too late once the pool allocated buffers */
+    ret = av_buffer_pool_set_flags(pool, flags);
+    printf(", set again %s\n", ret == AVERROR(EINVAL) ? "EINVAL" : "ok");
+
+    av_buffer_unref(&buf);
+    av_buffer_pool_uninit(&pool);
+    return 0;
+}
+
+int main(void)
+{
+    AVBufferRef *bufs[4] = { NULL };
+    AVBufferPool *pool1, *pool2;
+
+    pool1 = av_buffer_pool_init(1000, NULL);
+    pool2 = av_buffer_pool_init(4096, NULL);
+    if (!pool1 || !pool2)
+        return 1;
+    print_memory("empty pool", pool1);
+
+    for (int i = 0; i < 3; i++) {
+        bufs[i] = av_buffer_pool_get(pool1);
+        if (!bufs[i])
+            return 1;
+    }
+    bufs[3] = av_buffer_pool_get(pool2);
+    if (!bufs[3])
+        return 1;
+    print_memory("3 buffers", pool1);
+    print_memory("1 buffer", pool2);
+    print_memory("all pools", NULL);
+
+    av_buffer_unref(&bufs[0]);
+    av_buffer_unref(&bufs[1]);
+    print_memory("1 buffer, 2 kept", pool1);
+
+    bufs[0] = av_buffer_pool_get(pool1);
+    if (!bufs[0])
+        return 1;
+    print_memory("2 buffers, 1 kept", pool1);
+    print_memory("all pools", NULL);
+
+    /* the buffers of an uninitialized pool stay accounted for until they
+     * are released */
+    av_buffer_pool_uninit(&pool1);
+    print_memory("uninit", NULL);
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(bufs); i++)
+        av_buffer_unref(&bufs[i]);
+    print_memory("pool2 released", pool2);
+    av_buffer_pool_uninit(&pool2);
+    print_memory("all pools freed", NULL);
+
+    if (test_flags(0) < 0 ||
+        test_flags(AV_BUFFER_POOL_FLAG_HUGEPAGES) < 0 ||
+        test_flags(AV_BUFFER_POOL_FLAG_NUMA_LOCAL) < 0 ||
+        test_flags(AV_BUFFER_POOL_FLAG_HUGEPAGES | AV_BUFFER_POOL_FLAG_NUMA_LOCAL) < 0)
+        return 1;
+
+    /* the flags are ignored for pools with their own allocator */
+    pool1 = av_buffer_pool_init(BIG_SIZE, custom_alloc);
+    if (!pool1)
+        return 1;
+    printf("custom allocator: set %d",
+           av_buffer_pool_set_flags(pool1, AV_BUFFER_POOL_FLAG_HUGEPAGES));
+    bufs[0] = av_buffer_pool_get(pool1);
+    if (!bufs[0])
+        return 1;
+    printf(", allocations %d\n", nb_custom_allocs);
+    av_buffer_unref(&bufs[0]);
+    av_buffer_pool_uninit(&pool1);
+    print_memory("all pools freed", NULL);
+
+    return 0;
+}
@@ -60,12 +60,7 @@ static SwsPass *pass_add(SwsGraph *graph, void *priv, enum AVPixelFormat fmt,
     pass->height = h;
     pass->input  = input;
     pass->output.fmt = AV_PIX_FMT_NONE;
-
-    ret = pass_alloc_output(input);
-    if (ret < 0) {
-        av_free(pass);
-        return NULL;
-    }
+    pass->slice_align = slice_align;
 
     if (!slice_align) {
         pass->slice_h = pass->height;
@@ -94,6 +89,18 @@ static int pass_append(SwsGraph *graph, void *priv, enum AVPixelFormat fmt,
     return 0;
 }
 
+/* Like pass_append, for passes that only read the lines they output */
+static int pass_append_line_local(SwsGraph *graph, void *priv, enum AVPixelFormat fmt,
+                                  int w, int h, SwsPass **pass, int slice_align,
+                                  sws_filter_run_t run)
+{
+    int ret = pass_append(graph, priv, fmt, w, h, pass, slice_align, run);
+    if (ret < 0)
+        return ret;
+    (*pass)->line_local = 1;
+    return 0;
+}
+
 static int vshift(enum AVPixelFormat fmt, int plane)
 {
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(fmt);
@@ -323,13 +330,13 @@ static int init_legacy_subpass(SwsGraph *graph, SwsContext *sws,
         align = 0; /* disable slice threading */
 
     if (c->src0Alpha && !c->dst0Alpha && isALPHA(sws->dst_format)) {
-        ret = pass_append(graph, c, AV_PIX_FMT_RGBA, src_w, src_h, &input, 1, run_rgb0);
+        ret = pass_append_line_local(graph, c, AV_PIX_FMT_RGBA, src_w, src_h, &input, 1, run_rgb0);
         if (ret < 0)
             return ret;
     }
 
     if (c->srcXYZ && !(c->dstXYZ && unscaled)) {
-        ret = pass_append(graph, c, AV_PIX_FMT_RGB48, src_w, src_h, &input, 1, run_xyz2rgb);
+        ret = pass_append_line_local(graph, c, AV_PIX_FMT_RGB48, src_w, src_h, &input, 1, run_xyz2rgb);
         if (ret < 0)
             return ret;
     }
@@ -340,6 +347,8 @@ static int init_legacy_subpass(SwsGraph *graph, SwsContext *sws,
         return AVERROR(ENOMEM);
     pass->setup = setup_legacy_swscale;
     pass->free = free_legacy_swscale;
+    /* the bayer converters interpolate from the neighbouring lines */
+    pass->line_local = c->convert_unscaled && !isBayer(sws->src_format);
 
     /**
      * For slice threading, we need to create sub contexts, similar to how
@@ -385,7 +394,7 @@ static int init_legacy_subpass(SwsGraph *graph, SwsContext *sws,
     }
 
     if (c->dstXYZ && !(c->srcXYZ && unscaled)) {
-        ret = pass_append(graph, c, AV_PIX_FMT_RGB48, dst_w, dst_h, &pass, 1, run_rgb2xyz);
+        ret = pass_append_line_local(graph, c, AV_PIX_FMT_RGB48, dst_w, dst_h, &pass, 1, run_rgb2xyz);
         if (ret < 0)
             return ret;
     }
@@ -494,17 +503,160 @@ static int init_passes(SwsGraph *graph)
     return 0;
 }
 
+/* Amount of intermediate data a stage should produce per tile */
+#define TILE_BYTES (256 << 10)
+
+static int can_fuse(const SwsStage *stage, const SwsPass *prev, const SwsPass *pass)
+{
+    return pass->line_local && pass->input == prev &&
+           pass->slice_align && prev->slice_align &&
+           pass->height     == stage->height  &&
+           pass->slice_h    == stage->slice_h &&
+           pass->num_slices == stage->num_slices;
+}
+
+static int stage_init_tiles(SwsGraph *graph, SwsStage *stage)
+{
+    const SwsPass *head = graph->passes[stage->first_pass];
+    const int num_tiles = stage->num_passes - 1;
+    size_t line_bytes = 0, tile_size = 0;
+    int align = 1, ret;
+
+    if (!num_tiles) {
+        stage->tile_h = stage->slice_h;
+        return 0;
+    }
+
+    for (int i = 0; i < stage->num_passes; i++) {
+        const SwsPass *pass = graph->passes[stage->first_pass + i];
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pass->format);
+        align = FFMAX(align, pass->slice_align);
+        align = FFMAX(align, 1 << desc->log2_chroma_h);
+        if (i < num_tiles)
+            line_bytes += av_image_get_buffer_size(pass->format, pass->width, 16, 64) / 16;
+    }
+
+    /* A head pass reading more lines than it outputs, i.e. a scaler or a
+     * bayer converter, would redo the work on the lines shared by neighbouring
+     * tiles, or handle the tile edges as image edges, so it gets whole slices */
+    if (head->line_local)
+        stage->tile_h = FFALIGN(FFMAX(TILE_BYTES / FFMAX(line_bytes, 1), 1), align);
+    else
+        stage->tile_h = stage->slice_h;
+    stage->tile_h = FFMIN(stage->tile_h, stage->slice_h);
+
+    stage->tiles = av_calloc(graph->num_threads * num_tiles, sizeof(*stage->tiles));
+    if (!stage->tiles)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < num_tiles; i++) {
+        const SwsPass *pass = graph->passes[stage->first_pass + i];
+        ret = av_image_get_buffer_size(pass->format, pass->width, stage->tile_h, 64);
+        if (ret < 0)
+            return ret;
+        tile_size += FFALIGN(ret, 64);
+    }
+
+    stage->tile_buf = av_malloc_array(graph->num_threads, tile_size);
+    if (!stage->tile_buf)
+        return AVERROR(ENOMEM);
+
+    for (int t = 0; t < graph->num_threads; t++) {
+        uint8_t *buf = stage->tile_buf + t * tile_size;
+        for (int i = 0; i < num_tiles; i++) {
+            const SwsPass *pass = graph->passes[stage->first_pass + i];
+            SwsImg *tile = &stage->tiles[t * num_tiles + i];
+
+            tile->fmt = pass->format;
+            ret = av_image_fill_arrays(tile->data, tile->linesize, buf, pass->format,
+                                       pass->width, stage->tile_h, 64);
+            if (ret < 0)
+                return ret;
+            buf += FFALIGN(ret, 64);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Group the passes into stages, and allocate the buffers for the outputs
+ * consumed by the next stage.
+ */
+static int init_stages(SwsGraph *graph)
+{
+    int ret;
+
+    graph->stages = av_calloc(graph->num_passes, sizeof(*graph->stages));
+    if (!graph->stages)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < graph->num_passes; i++) {
+        const SwsPass *pass = graph->passes[i];
+        SwsStage *stage = &graph->stages[graph->num_stages - 1];
+
+        if (i && can_fuse(stage, graph->passes[i - 1], pass)) {
+            stage->num_passes++;
+            continue;
+        }
+
+        stage = &graph->stages[graph->num_stages++];
+        stage->first_pass = i;
+        stage->num_passes = 1;
+        stage->height     = pass->height;
+        stage->slice_h    = pass->slice_h;
+        stage->num_slices = pass->num_slices;
+    }
+
+    for (int i = 0; i < graph->num_stages; i++) {
+        SwsStage *stage = &graph->stages[i];
+
+        ret = stage_init_tiles(graph, stage);
+        if (ret < 0)
+            return ret;
+
+        if (i + 1 < graph->num_stages) {
+            ret = pass_alloc_output(graph->passes[stage->first_pass + stage->num_passes - 1]);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    return 0;
+}
+
 static void sws_graph_worker(void *priv, int jobnr, int threadnr, int nb_jobs,
                              int nb_threads)
 {
     SwsGraph *graph = priv;
-    const SwsPass *pass = graph->exec.pass;
-    const SwsImg *input  = pass->input ? &pass->input->output : &graph->exec.input;
-    const SwsImg *output = pass->output.fmt != AV_PIX_FMT_NONE ? &pass->output : &graph->exec.output;
-    const int slice_y = jobnr * pass->slice_h;
-    const int slice_h = FFMIN(pass->slice_h, pass->height - slice_y);
-
-    pass->run(output, input, slice_y, slice_h, pass);
+    const SwsStage *stage = graph->exec.stage;
+    const SwsImg *tiles = stage->tiles + threadnr * (stage->num_passes - 1);
+    const int slice_y   = jobnr * stage->slice_h;
+    const int slice_end = FFMIN(slice_y + stage->slice_h, stage->height);
+
+    for (int y = slice_y; y < slice_end; y += stage->tile_h) {
+        const int h = FFMIN(stage->tile_h, slice_end - y);
+
+        for (int i = 0; i < stage->num_passes; i++) {
+            const SwsPass *pass = graph->passes[stage->first_pass + i];
+            const int last = i + 1 == stage->num_passes;
+            SwsImg input, output;
+
+            /* tile buffers only hold lines [y, y + h), so present them to the
+             * pass as if they held the whole image */
+            if (i)
+                input = shift_img(&tiles[i - 1], -y);
+            else
+                input = pass->input ? pass->input->output : graph->exec.input;
+
+            if (!last)
+                output = shift_img(&tiles[i], -y);
+            else
+                output = pass->output.fmt != AV_PIX_FMT_NONE ? pass->output : graph->exec.output;
+
+            pass->run(&output, &input, y, h, pass);
+        }
+    }
 }
 
 int sws_graph_create(SwsContext *ctx, const SwsFormat *dst, const SwsFormat *src,
@@ -537,6 +689,10 @@ int sws_graph_create(SwsContext *ctx, const SwsFormat *dst, const SwsFormat *src
     if (ret < 0)
         goto error;
 
+    ret = init_stages(graph);
+    if (ret < 0)
+        goto error;
+
     *out_graph = graph;
     return 0;
 
@@ -563,6 +719,12 @@ void sws_graph_free(SwsGraph **pgraph)
     }
     av_free(graph->passes);
 
+    for (int i = 0; i < graph->num_stages; i++) {
+        av_free(graph->stages[i].tiles);
+        av_free(graph->stages[i].tile_buf);
+    }
+    av_free(graph->stages);
+
     av_free(graph);
     *pgraph = NULL;
 }
@@ -609,11 +771,15 @@ void sws_graph_run(SwsGraph *graph, uint8_t *const out_data[4],
     memcpy(in->data,      in_data,      sizeof(in->data));
     memcpy(in->linesize,  in_linesize,  sizeof(in->linesize));
 
-    for (int i = 0; i < graph->num_passes; i++) {
-        const SwsPass *pass = graph->passes[i];
-        graph->exec.pass = pass;
-        if (pass->setup)
-            pass->setup(out, in, pass);
-        avpriv_slicethread_execute(graph->slicethread, pass->num_slices, 0);
+    for (int i = 0; i < graph->num_stages; i++) {
+        const SwsStage *stage = &graph->stages[i];
+        for (int j = 0; j < stage->num_passes; j++) {
+            const SwsPass *pass = graph->passes[stage->first_pass + j];
+            if (pass->setup)
+                pass->setup(out, in, pass);
+        }
+
+        graph->exec.stage = stage;
+        avpriv_slicethread_execute(graph->slicethread, stage->num_slices, 0);
     }
 }
@@ -62,6 +62,13 @@ struct SwsPass {
     int width, height; /* new output size */
     int slice_h;       /* filter granularity */
     int num_slices;
+    int slice_align;   /* slice alignment, or 0 if slice threading is disabled */
+
+    /**
+     * Set if `run` only reads the input lines it outputs. Such a pass may be
+     * fused with the pass producing its input, see SwsStage.
+     */
+    int line_local;
 
     /**
      * Filter input. This pass's output will be resolved to form this pass's.
@@ -88,6 +95,30 @@ struct SwsPass {
     void *priv;
 };
 
+/**
+ * A run of consecutive passes that are executed together, one tile of lines
+ * at a time, so that the data handed from one pass to the next stays in cache.
+ * Only the output of the last pass of a stage is stored in a frame-sized
+ * buffer; all the others write into small per-thread tile buffers.
+ */
+typedef struct SwsStage {
+    int first_pass;    /* index into SwsGraph.passes */
+    int num_passes;
+
+    int height;
+    int slice_h;       /* common slice height of all passes in the stage */
+    int num_slices;
+    int tile_h;        /* number of lines processed by each pass in turn,
+                          slice_h unless the first pass is line_local */
+
+    /**
+     * Tile buffers for all passes but the last, num_passes - 1 per thread,
+     * each pointing to the first line of the tile.
+     */
+    SwsImg *tiles;
+    uint8_t *tile_buf;
+} SwsStage;
+
 /**
  * Filter graph, which represents a 'baked' pixel format conversion.
  */
@@ -102,6 +133,10 @@ typedef struct SwsGraph {
     SwsPass **passes;
     int num_passes;
 
+    /** Sequence of stages the passes are grouped into for execution */
+    SwsStage *stages;
+    int num_stages;
+
     /**
      * Cached copy of the public options that were used to construct this
      * SwsGraph. Used only to detect when the graph needs to be reinitialized.
@@ -116,7 +151,7 @@ typedef struct SwsGraph {
 
     /** Temporary execution state inside sws_graph_run */
     struct {
-        const SwsPass *pass; /* current filter pass */
+        const SwsStage *stage; /* current stage */
         SwsImg input;
         SwsImg output;
     } exec;
@@ -0,0 +1,194 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Check that running the passes of a graph fused into tiled stages gives the
+ * same output as running every pass over the whole frame on its own.
+ */
+
+#include <stdio.h>
+
+#include "libavutil/frame.h"
+#include "libavutil/lfg.h"
+
+#include "libswscale/graph.c"
+
+static const struct {
+    enum AVPixelFormat src_fmt, dst_fmt;
+    int src_w, src_h, dst_w, dst_h;
+} tests[] = {
+    { AV_PIX_FMT_XYZ12LE,     AV_PIX_FMT_RGB48LE,     640, 360, 640, 360 },
+    { AV_PIX_FMT_XYZ12LE,     AV_PIX_FMT_YUV444P16LE, 640, 360, 640, 360 },
+    { AV_PIX_FMT_XYZ12LE,     AV_PIX_FMT_YUV420P,     642, 362, 642, 362 },
+    { AV_PIX_FMT_RGB48LE,     AV_PIX_FMT_XYZ12LE,     640, 360, 640, 360 },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_XYZ12LE,     642, 362, 642, 362 },
+    { AV_PIX_FMT_RGB0,        AV_PIX_FMT_YUVA444P,    640, 360, 640, 360 },
+    { AV_PIX_FMT_XYZ12LE,     AV_PIX_FMT_XYZ12LE,     640, 360, 320, 180 },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_XYZ12LE,     320, 180, 640, 360 },
+    { AV_PIX_FMT_BAYER_RGGB8, AV_PIX_FMT_XYZ12LE,     640, 360, 640, 360 },
+};
+
+/* Regroup the passes of a graph into one stage per pass, as before fusion */
+static int unfuse(SwsGraph *graph)
+{
+    int ret;
+
+    for (int i = 0; i < graph->num_stages; i++) {
+        av_freep(&graph->stages[i].tiles);
+        av_freep(&graph->stages[i].tile_buf);
+    }
+
+    for (int i = 0; i < graph->num_passes; i++) {
+        SwsPass *pass = graph->passes[i];
+        SwsStage *stage = &graph->stages[i];
+
+        *stage = (SwsStage) {
+            .first_pass = i,
+            .num_passes = 1,
+            .height     = pass->height,
+            .slice_h    = pass->slice_h,
+            .num_slices = pass->num_slices,
+        };
+
+        ret = stage_init_tiles(graph, stage);
+        if (ret < 0)
+            return ret;
+        if (i + 1 < graph->num_passes) {
+            ret = pass_alloc_output(pass);
+            if (ret < 0)
+                return ret;
+        }
+    }
+    graph->num_stages = graph->num_passes;
+
+    return 0;
+}
+
+static int alloc_frame(AVFrame **pframe, enum AVPixelFormat fmt, int w, int h)
+{
+    AVFrame *frame = av_frame_alloc();
+    if (!frame)
+        return AVERROR(ENOMEM);
+    *pframe = frame;
+
+    frame->format = fmt;
+    frame->width  = w;
+    frame->height = h;
+    if (!(av_pix_fmt_desc_get(fmt)->flags & AV_PIX_FMT_FLAG_RGB) &&
+        !(av_pix_fmt_desc_get(fmt)->flags & AV_PIX_FMT_FLAG_XYZ))
+        frame->color_range = AVCOL_RANGE_MPEG;
+    return av_frame_get_buffer(frame, 0);
+}
+
+static int frames_equal(const AVFrame *a, const AVFrame *b)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(a->format);
+
+    for (int p = 0; p < 4 && a->data[p]; p++) {
+        const int shift = p == 1 || p == 2 ? desc->log2_chroma_h : 0;
+        const int h = AV_CEIL_RSHIFT(a->height, shift);
+        const int bytes = av_image_get_linesize(a->format, a->width, p);
+
+        for (int y = 0; y < h; y++)
+            if (memcmp(a->data[p] + y * a->linesize[p],
+                       b->data[p] + y * b->linesize[p], bytes))
+                return 0;
+    }
+
+    return 1;
+}
+
+static int run_test(int idx, int threads, AVLFG *lfg)
+{
+    SwsContext *ctx = sws_alloc_context();
+    SwsGraph *graph[2] = { NULL };
+    AVFrame *src = NULL, *dst[2] = { NULL };
+    SwsFormat src_fmt, dst_fmt;
+    int ret, num_stages = 0, num_tiled = 0;
+
+    if (!ctx)
+        return AVERROR(ENOMEM);
+    ctx->flags   = SWS_BILINEAR | SWS_BITEXACT | SWS_ACCURATE_RND;
+    ctx->threads = threads;
+
+    if ((ret = alloc_frame(&src,    tests[idx].src_fmt, tests[idx].src_w, tests[idx].src_h)) < 0 ||
+        (ret = alloc_frame(&dst[0], tests[idx].dst_fmt, tests[idx].dst_w, tests[idx].dst_h)) < 0 ||
+        (ret = alloc_frame(&dst[1], tests[idx].dst_fmt, tests[idx].dst_w, tests[idx].dst_h)) < 0)
+        goto end;
+
+    for (int p = 0; p < 4 && src->buf[p]; p++)
+        for (size_t i = 0; i < src->buf[p]->size; i++)
+            src->buf[p]->data[i] = av_lfg_get(lfg);
+
+    src_fmt = ff_fmt_from_frame(src, FIELD_TOP);
+    dst_fmt = ff_fmt_from_frame(dst[0], FIELD_TOP);
+
+    for (int i = 0; i < 2; i++) {
+        ret = sws_graph_create(ctx, &dst_fmt, &src_fmt, FIELD_TOP, &graph[i]);
+        if (ret < 0)
+            goto end;
+    }
+    num_stages = graph[0]->num_stages;
+    for (int i = 0; i < num_stages; i++)
+        num_tiled += graph[0]->stages[i].tile_h < graph[0]->stages[i].slice_h;
+    ret = unfuse(graph[1]);
+    if (ret < 0)
+        goto end;
+
+    for (int i = 0; i < 2; i++)
+        sws_graph_run(graph[i], dst[i]->data, dst[i]->linesize,
+                      (const uint8_t **) src->data, src->linesize);
+
+    printf("%s %dx%d -> %s %dx%d, threads %d: passes %d, stages %d, tiled %d, %s\n",
+           av_get_pix_fmt_name(tests[idx].src_fmt), tests[idx].src_w, tests[idx].src_h,
+           av_get_pix_fmt_name(tests[idx].dst_fmt), tests[idx].dst_w, tests[idx].dst_h,
+           threads, graph[0]->num_passes, num_stages, num_tiled,
+           frames_equal(dst[0], dst[1]) ? "identical" : "DIFFERENT");
+    ret = frames_equal(dst[0], dst[1]) ? 0 : AVERROR_BUG;
+
+end:
+    for (int i = 0; i < 2; i++) {
+        sws_graph_free(&graph[i]);
+        av_frame_free(&dst[i]);
+    }
+    av_frame_free(&src);
+    sws_free_context(&ctx);
+    return ret;
+}
+
+int main(void)
+{
+    static const int threads[] = { 1, 4 };
+    AVLFG lfg;
+    int ret = 0;
+
+    av_lfg_init(&lfg, 0xdeadbeef);
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(tests); i++) {
+        for (int j = 0; j < FF_ARRAY_ELEMS(threads); j++) {
+            int err = run_test(i, threads[j], &lfg);
+            if (err < 0 && err != AVERROR_BUG) {
+                fprintf(stderr, "Test %d failed: %s\n", i, av_err2str(err));
+                return 1;
+            }
+            ret |= err < 0;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,191 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * Test of the mmap option of the mov demuxer: the packets must be the same as
+ * without it, their padding must be zeroed, the large ones must reference a
+ * mapping of the file, and writing to them must not modify the file.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libavutil/dict.h"
+#include "libavutil/mem.h"
+#include "libavcodec/packet.h"
+#include "libavformat/avformat.h"
+
+#define NB_FRAMES  10
+#define WIDTH      320
+#define HEIGHT     240
+#define FRAME_SIZE (WIDTH * HEIGHT * 2)
+
+static int write_file(const char *filename)
+{
+    AVFormatContext *oc = NULL;
+    AVPacket *pkt = NULL;
+    AVStream *st;
+    int ret;
+
+    ret = avformat_alloc_output_context2(&oc, NULL, "mov", filename);
+    if (ret < 0)
+        return ret;
+    oc->flags |= AVFMT_FLAG_BITEXACT;
+
+    st = avformat_new_stream(oc, NULL);
+    if (!st) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    st->time_base            = (AVRational){ 1, 25 };
+    st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    st->codecpar->codec_id   = AV_CODEC_ID_RAWVIDEO;
+    st->codecpar->format     = AV_PIX_FMT_UYVY422;
+    st->codecpar->width      = WIDTH;
+    st->codecpar->height     = HEIGHT;
+
+    if ((ret = avio_open(&oc->pb, filename, AVIO_FLAG_WRITE)) < 0 ||
+        (ret = avformat_write_header(oc, NULL)) < 0)
+        goto end;
+
+    pkt = av_packet_alloc();
+    if (!pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (int i = 0; i < NB_FRAMES; i++) {
+        if ((ret = av_new_packet(pkt, FRAME_SIZE)) < 0)
+            goto end;
+        for (int j = 0; j < FRAME_SIZE; j++)
+            pkt->data[j] = 1 + (i * 7 + j) % 251;
+        pkt->pts = pkt->dts = i;
+        pkt->flags |= AV_PKT_FLAG_KEY;
+        if ((ret = av_interleaved_write_frame(oc, pkt)) < 0)
+            goto end;
+    }
+    ret = av_write_trailer(oc);
+
+end:
+    av_packet_free(&pkt);
+    if (oc)
+        avio_closep(&oc->pb);
+    avformat_free_context(oc);
+    return ret;
+}
+
+/* Whether the packet data is at its offset in a page aligned buffer, as it is
+ * in a mapping of the file and not in a copy. */
+static int is_mapped(const AVPacket *pkt)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    return !((uintptr_t)pkt->buf->data % page_size) &&
+           pkt->data - pkt->buf->data == pkt->pos % page_size;
+}
+
+static int open_input(AVFormatContext **ic, const char *filename, int mmap)
+{
+    AVDictionary *opts = NULL;
+    int ret;
+
+    av_dict_set_int(&opts, "mmap", mmap, 0);
+    ret = avformat_open_input(ic, filename, NULL, &opts);
+    av_dict_free(&opts);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const uint8_t zero_padding[AV_INPUT_BUFFER_PADDING_SIZE] = { 0 };
+    AVFormatContext *ic_mmap = NULL, *ic_read = NULL;
+    AVPacket *pkt_mmap = NULL, *pkt_read = NULL;
+    int nb_packets = 0, nb_mapped = 0, ret;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <file>\n", argv[0]);
+        return 1;
+    }
+
+    if ((ret = write_file(argv[1])) < 0) {
+        fprintf(stderr, "Could not write %s\n", argv[1]);
+        return 1;
+    }
+
+    pkt_mmap = av_packet_alloc();
+    pkt_read = av_packet_alloc();
+    if (!pkt_mmap || !pkt_read ||
+        open_input(&ic_mmap, argv[1], 1) < 0 ||
+        open_input(&ic_read, argv[1], 0) < 0) {
+        fprintf(stderr, "Could not open %s\n", argv[1]);
+        ret = 1;
+        goto end;
+    }
+
+    while (1) {
+        int ret_mmap = av_read_frame(ic_mmap, pkt_mmap);
+        int ret_read = av_read_frame(ic_read, pkt_read);
+
+        if (ret_mmap < 0 || ret_read < 0) {
+            ret = ret_mmap != AVERROR_EOF || ret_read != AVERROR_EOF;
+            if (ret)
+                fprintf(stderr, "Unexpected errors %d and %d\n", ret_mmap, ret_read);
+            break;
+        }
+
+        if (pkt_mmap->size != pkt_read->size ||
+            memcmp(pkt_mmap->data, pkt_read->data, pkt_read->size)) {
+            fprintf(stderr, "Packet %d differs\n", nb_packets);
+            ret = 1;
+            break;
+        }
+        if (memcmp(pkt_mmap->data + pkt_mmap->size, zero_padding, sizeof(zero_padding))) {
+            fprintf(stderr, "Padding of packet %d is not zeroed\n", nb_packets);
+            ret = 1;
+            break;
+        }
+
+        if (is_mapped(pkt_mmap)) {
+            printf("packet %d references a mapping\n", nb_packets);
+            nb_mapped++;
+        }
+        nb_packets++;
+
+        /* The page holding the end of the packet also holds the start of the
+         * next one, which must not change. */
+        if (av_packet_make_writable(pkt_mmap) < 0) {
+            ret = 1;
+            break;
+        }
+        memset(pkt_mmap->data, 0, pkt_mmap->size);
+
+        av_packet_unref(pkt_mmap);
+        av_packet_unref(pkt_read);
+    }
+
+    printf("%d packets, %d referencing a mapping\n", nb_packets, nb_mapped);
+
+end:
+    av_packet_free(&pkt_mmap);
+    av_packet_free(&pkt_read);
+    avformat_close_input(&ic_mmap);
+    avformat_close_input(&ic_read);
+    return ret;
+}
@@ -0,0 +1,96 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavfilter/ebur128dsp.h"
+#include "libavutil/mem_internal.h"
+#include "checkasm.h"
+
+#define CHANNELS 6
+#define LEN      256
+
+static void randomize_buffer(double *buf, int len)
+{
+    for (int i = 0; i < len; i += 2) {
+        double bmg[2];
+
+        av_bmg_get(&checkasm_lfg, bmg);
+        buf[i]     = bmg[0];
+        buf[i + 1] = bmg[1];
+    }
+}
+
+static void check_filter(void)
+{
+    /* coefficients of the K-weighting filter at 48 kHz */
+    static const double a[4] = { -3.68070674801639,  5.08023918811617,
+                                 -3.11888109627015,  0.71818914218946 };
+    static const double b[5] = {  1.53512485958697, -5.76194590858032,
+                                  8.11691004925205, -5.08848181952619,
+                                  1.19839281085285 };
+    LOCAL_ALIGNED_32(double, coeffs, [9], [4]);
+    LOCAL_ALIGNED_32(double, src,    [LEN * CHANNELS]);
+    LOCAL_ALIGNED_32(double, dst0,   [LEN * CHANNELS]);
+    LOCAL_ALIGNED_32(double, dst1,   [LEN * CHANNELS]);
+    LOCAL_ALIGNED_32(double, v0,     [4 * CHANNELS]);
+    LOCAL_ALIGNED_32(double, v1,     [4 * CHANNELS]);
+    /* the first channel is not filtered, which checks for unaligned access */
+    const int offset = 1;
+
+    declare_func(void, double *dst, const double *src, ptrdiff_t stride,
+                 double *v, ptrdiff_t v_stride,
+                 const double (*coeffs)[4], int nb_frames);
+
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            coeffs[i][j]     = a[i];
+            coeffs[i + 4][j] = b[i];
+        }
+        coeffs[8][i] = b[4];
+    }
+
+    randomize_buffer(src, LEN * CHANNELS);
+    randomize_buffer(v0, 4 * CHANNELS);
+    memcpy(v1, v0, sizeof(*v0) * 4 * CHANNELS);
+    memset(dst0, 0, sizeof(*dst0) * LEN * CHANNELS);
+    memset(dst1, 0, sizeof(*dst1) * LEN * CHANNELS);
+
+    call_ref(dst0 + offset, src + offset, CHANNELS, v0 + offset, CHANNELS,
+             (const double (*)[4])coeffs, LEN);
+    call_new(dst1 + offset, src + offset, CHANNELS, v1 + offset, CHANNELS,
+             (const double (*)[4])coeffs, LEN);
+    if (!double_near_abs_eps_array(dst0, dst1, 1e-12, LEN * CHANNELS) ||
+        !double_near_abs_eps_array(v0, v1, 1e-12, 4 * CHANNELS))
+        fail();
+    bench_new(dst1 + offset, src + offset, CHANNELS, v1 + offset, CHANNELS,
+              (const double (*)[4])coeffs, LEN);
+}
+
+void checkasm_check_loudnorm(void)
+{
+    EBUR128DSPContext dsp;
+
+    ff_ebur128_dsp_init(&dsp);
+
+    if (check_func(dsp.filter_x2, "ebur128_filter_x2"))
+        check_filter();
+    if (check_func(dsp.filter_x4, "ebur128_filter_x4"))
+        check_filter();
+    report("ebur128_filter");
+}
@@ -0,0 +1,98 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+
+#include "libavutil/mem_internal.h"
+
+#include "libavcodec/opus/pvq.h"
+
+#include "checkasm.h"
+
+#define randomize_float(buf, len)                               \
+    do {                                                        \
+        for (int i = 0; i < len; i++) {                         \
+            float f = (float)rnd() / (UINT_MAX >> 5) - 16.0f;   \
+            buf[i] = f;                                         \
+        }                                                       \
+    } while (0)
+
+/* largest band of a 20 ms frame */
+#define MAX_N 176
+
+/* The SIMD versions do not place the pulses exactly like the C version, so
+ * only check that the result is a valid quantization of the input. */
+static int check_pulses(const float *X, const int *y, float y_norm, int N, int K)
+{
+    int pulses = 0, norm = 0;
+
+    for (int i = 0; i < N; i++) {
+        if (y[i] && X[i] && (y[i] < 0) != (X[i] < 0))
+            return 0;
+        pulses += abs(y[i]);
+        norm   += y[i] * y[i];
+    }
+
+    return pulses == K && y_norm == norm;
+}
+
+static void test_pvq_search(int N, int K)
+{
+    /* the SIMD versions read and write whole vectors past N */
+    LOCAL_ALIGNED_32(float, X,  [FFALIGN(MAX_N, 8)]);
+    LOCAL_ALIGNED_32(int,   y0, [FFALIGN(MAX_N, 8)]);
+    LOCAL_ALIGNED_32(int,   y1, [FFALIGN(MAX_N, 8)]);
+    float norm0, norm1;
+
+    declare_func_float(float, float *X, int *y, int K, int N);
+
+    randomize_float(X, FFALIGN(MAX_N, 8));
+
+    norm0 = call_ref(X, y0, K, N);
+    norm1 = call_new(X, y1, K, N);
+
+    if (!check_pulses(X, y0, norm0, N, K) ||
+        !check_pulses(X, y1, norm1, N, K))
+        fail();
+    bench_new(X, y1, K, N);
+}
+
+void checkasm_check_celt_pvq(void)
+{
+    static const int sizes[][2] = {
+        /* N, K */
+        {   4,   1 },
+        {  16,   8 },
+        {  48,  24 },
+        { 176,  12 },
+        { 176, 128 },
+    };
+    CeltPVQ *pvq;
+
+    if (ff_celt_pvq_init(&pvq, 1) < 0)
+        return;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(sizes); i++) {
+        const int N = sizes[i][0], K = sizes[i][1];
+        if (check_func(pvq->pvq_search, "pvq_search_%d_%d", N, K))
+            test_pvq_search(N, K);
+    }
+    report("pvq_search");
+
+    ff_celt_pvq_uninit(&pvq);
+}
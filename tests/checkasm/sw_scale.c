@@ -23,6 +23,7 @@
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mem.h"
 #include "libavutil/mem_internal.h"
+#include "libavutil/pixdesc.h"
 
 #include "libswscale/swscale.h"
 #include "libswscale/swscale_internal.h"
@@ -265,14 +266,32 @@ static void check_hscale(void)
 #define FILTER_SIZES 6
     static const int filter_sizes[FILTER_SIZES] = { 4, 8, 12, 16, 32, 40 };
 
-#define HSCALE_PAIRS 2
+#define HSCALE_PAIRS 12
     static const int hscale_pairs[HSCALE_PAIRS][2] = {
-        { 8, 14 },
-        { 8, 18 },
+        {  8, 14 },
+        {  8, 18 },
+        {  9, 14 },
+        {  9, 18 },
+        { 10, 14 },
+        { 10, 18 },
+        { 12, 14 },
+        { 12, 18 },
+        { 14, 14 },
+        { 14, 18 },
+        { 16, 14 },
+        { 16, 18 },
+    };
+    static const enum AVPixelFormat hscale_formats[] = {
+        [8]  = AV_PIX_FMT_YUV420P,
+        [9]  = AV_PIX_FMT_YUV420P9LE,
+        [10] = AV_PIX_FMT_YUV420P10LE,
+        [12] = AV_PIX_FMT_YUV420P12LE,
+        [14] = AV_PIX_FMT_YUV420P14LE,
+        [16] = AV_PIX_FMT_YUV420P16LE,
     };
 
 #define LARGEST_INPUT_SIZE 512
-    static const int input_sizes[] = {8, 24, 128, 144, 256, 512};
+    static const int input_sizes[] = {8, 20, 24, 128, 144, 256, 512};
 
     int i, j, fsi, hpi, width, dstWi;
     SwsContext *sws;
@@ -280,6 +299,7 @@ static void check_hscale(void)
 
     // padded
     LOCAL_ALIGNED_32(uint8_t, src, [FFALIGN(SRC_PIXELS + MAX_FILTER_WIDTH - 1, 4)]);
+    LOCAL_ALIGNED_32(uint16_t, src16, [FFALIGN(SRC_PIXELS + MAX_FILTER_WIDTH - 1, 4)]);
     LOCAL_ALIGNED_32(uint32_t, dst0, [SRC_PIXELS]);
     LOCAL_ALIGNED_32(uint32_t, dst1, [SRC_PIXELS]);
 
@@ -303,10 +323,18 @@ static void check_hscale(void)
     randomize_buffers(src, SRC_PIXELS + MAX_FILTER_WIDTH - 1);
 
     for (hpi = 0; hpi < HSCALE_PAIRS; hpi++) {
+        const int src_bits = hscale_pairs[hpi][0];
+        const uint8_t *line = src_bits > 8 ? (const uint8_t *)src16 : src;
+
+        randomize_buffers((uint8_t *)src16, 2 * (SRC_PIXELS + MAX_FILTER_WIDTH - 1));
+        for (i = 0; i < SRC_PIXELS + MAX_FILTER_WIDTH - 1; i++)
+            src16[i] &= (1 << src_bits) - 1;
+
         for (fsi = 0; fsi < FILTER_SIZES; fsi++) {
             for (dstWi = 0; dstWi < FF_ARRAY_ELEMS(input_sizes); dstWi++) {
                 width = filter_sizes[fsi];
 
+                sws->src_format = hscale_formats[src_bits];
                 c->srcBpc = hscale_pairs[hpi][0];
                 c->dstBpc = hscale_pairs[hpi][1];
                 c->hLumFilterSize = c->hChrFilterSize = width;
@@ -331,7 +359,11 @@ static void check_hscale(void)
                     for (j = 0; j < width; j++) {
                         filter[i * width + j] = -((1 << 14) / (width - 1));
                     }
-                    filter[i * width + (rnd() % width)] = ((1 << 15) - 1);
+                    // The 16-bit input functions rely on the coefficients
+                    // summing to exactly 1 << 14.
+                    filter[i * width + (rnd() % width)] = src_bits == 16 ?
+                        (1 << 14) + (width - 1) * ((1 << 14) / (width - 1)) :
+                        ((1 << 15) - 1);
                 }
 
                 for (i = 0; i < MAX_FILTER_WIDTH; i++) {
@@ -350,11 +382,11 @@ static void check_hscale(void)
                     memset(dst0, 0, SRC_PIXELS * sizeof(dst0[0]));
                     memset(dst1, 0, SRC_PIXELS * sizeof(dst1[0]));
 
-                    call_ref(NULL, dst0, sws->dst_w, src, filter, filterPos, width);
-                    call_new(NULL, dst1, sws->dst_w, src, filterAvx2, filterPosAvx, width);
+                    call_ref(c, dst0, sws->dst_w, line, filter, filterPos, width);
+                    call_new(c, dst1, sws->dst_w, line, filterAvx2, filterPosAvx, width);
                     if (memcmp(dst0, dst1, sws->dst_w * sizeof(dst0[0])))
                         fail();
-                    bench_new(NULL, dst0, sws->dst_w, src, filter, filterPosAvx, width);
+                    bench_new(c, dst0, sws->dst_w, line, filter, filterPosAvx, width);
                 }
             }
         }
@@ -362,6 +394,221 @@ static void check_hscale(void)
     sws_freeContext(sws);
 }
 
+static const enum AVPixelFormat hbd_formats[] = {
+    AV_PIX_FMT_YUV420P9LE,  AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_YUV420P12LE,
+    AV_PIX_FMT_YUV420P14LE, AV_PIX_FMT_YUV420P16LE,
+    AV_PIX_FMT_P010LE,      AV_PIX_FMT_P012LE,      AV_PIX_FMT_P016LE,
+};
+
+#define HBD_LARGEST_FILTER 16
+#define HBD_LARGEST_INPUT_SIZE 512
+static const int hbd_input_sizes[] = {5, 8, 24, 33, 127, 144, 256, 512};
+
+static SwsContext *init_hbd_context(enum AVPixelFormat dst_format)
+{
+    SwsContext *sws = sws_alloc_context();
+    if (!sws)
+        return NULL;
+
+    sws->src_w = sws->dst_w = HBD_LARGEST_INPUT_SIZE;
+    sws->src_h = sws->dst_h = 2;
+    sws->src_format = AV_PIX_FMT_YUV420P;
+    sws->dst_format = dst_format;
+    if (sws_init_context(sws, NULL, NULL) < 0) {
+        sws_freeContext(sws);
+        return NULL;
+    }
+    ff_sws_init_scale(sws_internal(sws));
+    return sws;
+}
+
+/* Intermediates are 15 bits in int16_t, or 19 bits in int32_t for 16-bit
+ * output; leave some headroom to exercise the clipping. */
+static void randomize_intermediates(int32_t *buf, int size, int wide)
+{
+    if (wide) {
+        for (int i = 0; i < size; i++)
+            buf[i] = (int32_t)(rnd() & 0xfffff) - 0x80000;
+    } else {
+        randomize_buffers((uint8_t *)buf, size * sizeof(*buf));
+    }
+}
+
+/* Same properties as the coefficients in check_yuv2yuvX(). */
+static void init_vfilter(int16_t *filter, int filter_size)
+{
+    if (filter_size == 1) {
+        filter[0] = 1 << 12;
+        return;
+    }
+    for (int i = 0; i < filter_size; i++)
+        filter[i] = -((1 << 12) / (filter_size - 1));
+    filter[rnd() % filter_size] = (1 << 13) - 1;
+}
+
+static void check_yuv2yuv1_hbd(void)
+{
+    LOCAL_ALIGNED_32(int32_t, src, [HBD_LARGEST_INPUT_SIZE + 32]);
+    LOCAL_ALIGNED_32(uint16_t, dst0, [HBD_LARGEST_INPUT_SIZE + 32]);
+    LOCAL_ALIGNED_32(uint16_t, dst1, [HBD_LARGEST_INPUT_SIZE + 32]);
+    LOCAL_ALIGNED_8(uint8_t, dither, [8]);
+
+    declare_func(void, const int16_t *src, uint8_t *dest,
+                 int dstW, const uint8_t *dither, int offset);
+
+    randomize_buffers(dither, 8);
+    for (int fi = 0; fi < FF_ARRAY_ELEMS(hbd_formats); fi++) {
+        const char *name = av_get_pix_fmt_name(hbd_formats[fi]);
+        SwsContext *sws = init_hbd_context(hbd_formats[fi]);
+        SwsInternal *c;
+        if (!sws) {
+            fail();
+            continue;
+        }
+        c = sws_internal(sws);
+        randomize_intermediates(src, HBD_LARGEST_INPUT_SIZE + 32, c->dstBpc == 16);
+
+        for (int isi = 0; isi < FF_ARRAY_ELEMS(hbd_input_sizes); isi++) {
+            const int dstW = hbd_input_sizes[isi];
+            if (check_func(c->yuv2plane1, "yuv2yuv1_%s_%d", name, dstW)) {
+                memset(dst0, 0, (HBD_LARGEST_INPUT_SIZE + 32) * sizeof(dst0[0]));
+                memset(dst1, 0, (HBD_LARGEST_INPUT_SIZE + 32) * sizeof(dst1[0]));
+
+                call_ref((const int16_t *)src, (uint8_t *)dst0, dstW, dither, 0);
+                call_new((const int16_t *)src, (uint8_t *)dst1, dstW, dither, 0);
+                if (memcmp(dst0, dst1, dstW * sizeof(dst0[0]))) {
+                    fail();
+                    printf("failed: yuv2yuv1_%s_%d\n", name, dstW);
+                    show_differences((uint8_t *)dst0, (uint8_t *)dst1, dstW * sizeof(dst0[0]));
+                }
+                if (dstW == HBD_LARGEST_INPUT_SIZE)
+                    bench_new((const int16_t *)src, (uint8_t *)dst1, dstW, dither, 0);
+            }
+        }
+        sws_freeContext(sws);
+    }
+}
+
+static void check_yuv2yuvX_hbd(void)
+{
+    static const int filter_sizes[] = {2, 4, 8, 16};
+    const int16_t *src[HBD_LARGEST_FILTER];
+    LOCAL_ALIGNED_32(int32_t, src_pixels, [HBD_LARGEST_FILTER * (HBD_LARGEST_INPUT_SIZE + 32)]);
+    LOCAL_ALIGNED_32(int16_t, filter, [HBD_LARGEST_FILTER]);
+    LOCAL_ALIGNED_32(uint16_t, dst0, [HBD_LARGEST_INPUT_SIZE + 32]);
+    LOCAL_ALIGNED_32(uint16_t, dst1, [HBD_LARGEST_INPUT_SIZE + 32]);
+    LOCAL_ALIGNED_8(uint8_t, dither, [8]);
+
+    declare_func(void, const int16_t *filter, int filterSize,
+                 const int16_t **src, uint8_t *dest, int dstW,
+                 const uint8_t *dither, int offset);
+
+    randomize_buffers(dither, 8);
+    for (int i = 0; i < HBD_LARGEST_FILTER; i++)
+        src[i] = (const int16_t *)&src_pixels[i * (HBD_LARGEST_INPUT_SIZE + 32)];
+
+    for (int fi = 0; fi < FF_ARRAY_ELEMS(hbd_formats); fi++) {
+        const char *name = av_get_pix_fmt_name(hbd_formats[fi]);
+        SwsContext *sws = init_hbd_context(hbd_formats[fi]);
+        SwsInternal *c;
+        if (!sws) {
+            fail();
+            continue;
+        }
+        c = sws_internal(sws);
+        randomize_intermediates(src_pixels, HBD_LARGEST_FILTER * (HBD_LARGEST_INPUT_SIZE + 32),
+                                c->dstBpc == 16);
+
+        for (int fsi = 0; fsi < FF_ARRAY_ELEMS(filter_sizes); fsi++) {
+            const int filter_size = filter_sizes[fsi];
+            init_vfilter(filter, filter_size);
+
+            for (int isi = 0; isi < FF_ARRAY_ELEMS(hbd_input_sizes); isi++) {
+                const int dstW = hbd_input_sizes[isi];
+                if (check_func(c->yuv2planeX, "yuv2yuvX_%s_%d_%d", name, filter_size, dstW)) {
+                    memset(dst0, 0, (HBD_LARGEST_INPUT_SIZE + 32) * sizeof(dst0[0]));
+                    memset(dst1, 0, (HBD_LARGEST_INPUT_SIZE + 32) * sizeof(dst1[0]));
+
+                    call_ref(filter, filter_size, src, (uint8_t *)dst0, dstW, dither, 0);
+                    call_new(filter, filter_size, src, (uint8_t *)dst1, dstW, dither, 0);
+                    if (memcmp(dst0, dst1, dstW * sizeof(dst0[0]))) {
+                        fail();
+                        printf("failed: yuv2yuvX_%s_%d_%d\n", name, filter_size, dstW);
+                        show_differences((uint8_t *)dst0, (uint8_t *)dst1, dstW * sizeof(dst0[0]));
+                    }
+                    if (dstW == HBD_LARGEST_INPUT_SIZE)
+                        bench_new(filter, filter_size, src, (uint8_t *)dst1, dstW, dither, 0);
+                }
+            }
+        }
+        sws_freeContext(sws);
+    }
+}
+
+static void check_yuv2nv12cX_hbd(void)
+{
+    static const int filter_sizes[] = {1, 2, 3, 4, 8, 16};
+    const int16_t *u[HBD_LARGEST_FILTER], *v[HBD_LARGEST_FILTER];
+    LOCAL_ALIGNED_32(int32_t, src_pixels, [2 * HBD_LARGEST_FILTER * (HBD_LARGEST_INPUT_SIZE + 32)]);
+    LOCAL_ALIGNED_32(int16_t, filter, [HBD_LARGEST_FILTER]);
+    LOCAL_ALIGNED_32(uint16_t, dst0, [2 * (HBD_LARGEST_INPUT_SIZE + 32)]);
+    LOCAL_ALIGNED_32(uint16_t, dst1, [2 * (HBD_LARGEST_INPUT_SIZE + 32)]);
+    LOCAL_ALIGNED_8(uint8_t, dither, [8]);
+
+    declare_func(void, enum AVPixelFormat dstFormat, const uint8_t *chrDither,
+                 const int16_t *chrFilter, int chrFilterSize,
+                 const int16_t **chrUSrc, const int16_t **chrVSrc,
+                 uint8_t *dest, int dstW);
+
+    randomize_buffers(dither, 8);
+    for (int i = 0; i < HBD_LARGEST_FILTER; i++) {
+        u[i] = (const int16_t *)&src_pixels[(2 * i)     * (HBD_LARGEST_INPUT_SIZE + 32)];
+        v[i] = (const int16_t *)&src_pixels[(2 * i + 1) * (HBD_LARGEST_INPUT_SIZE + 32)];
+    }
+
+    for (int fi = 0; fi < FF_ARRAY_ELEMS(hbd_formats); fi++) {
+        const enum AVPixelFormat format = hbd_formats[fi];
+        const char *name = av_get_pix_fmt_name(format);
+        SwsContext *sws;
+        SwsInternal *c;
+
+        if (!isSemiPlanarYUV(format))
+            continue;
+        sws = init_hbd_context(format);
+        if (!sws) {
+            fail();
+            continue;
+        }
+        c = sws_internal(sws);
+        randomize_intermediates(src_pixels, 2 * HBD_LARGEST_FILTER * (HBD_LARGEST_INPUT_SIZE + 32),
+                                c->dstBpc == 16);
+
+        for (int fsi = 0; fsi < FF_ARRAY_ELEMS(filter_sizes); fsi++) {
+            const int filter_size = filter_sizes[fsi];
+            init_vfilter(filter, filter_size);
+
+            for (int isi = 0; isi < FF_ARRAY_ELEMS(hbd_input_sizes); isi++) {
+                const int dstW = hbd_input_sizes[isi];
+                if (check_func(c->yuv2nv12cX, "yuv2nv12cX_%s_%d_%d", name, filter_size, dstW)) {
+                    memset(dst0, 0, 2 * (HBD_LARGEST_INPUT_SIZE + 32) * sizeof(dst0[0]));
+                    memset(dst1, 0, 2 * (HBD_LARGEST_INPUT_SIZE + 32) * sizeof(dst1[0]));
+
+                    call_ref(format, dither, filter, filter_size, u, v, (uint8_t *)dst0, dstW);
+                    call_new(format, dither, filter, filter_size, u, v, (uint8_t *)dst1, dstW);
+                    if (memcmp(dst0, dst1, 2 * dstW * sizeof(dst0[0]))) {
+                        fail();
+                        printf("failed: yuv2nv12cX_%s_%d_%d\n", name, filter_size, dstW);
+                        show_differences((uint8_t *)dst0, (uint8_t *)dst1, 2 * dstW * sizeof(dst0[0]));
+                    }
+                    if (dstW == HBD_LARGEST_INPUT_SIZE)
+                        bench_new(format, dither, filter, filter_size, u, v, (uint8_t *)dst1, dstW);
+                }
+            }
+        }
+        sws_freeContext(sws);
+    }
+}
+
 void checkasm_check_sw_scale(void)
 {
     check_hscale();
@@ -372,4 +619,10 @@ void checkasm_check_sw_scale(void)
     check_yuv2yuvX(0);
     check_yuv2yuvX(1);
     report("yuv2yuvX");
+    check_yuv2yuv1_hbd();
+    report("yuv2yuv1_hbd");
+    check_yuv2yuvX_hbd();
+    report("yuv2yuvX_hbd");
+    check_yuv2nv12cX_hbd();
+    report("yuv2nv12cX_hbd");
 }
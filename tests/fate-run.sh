@@ -659,6 +659,68 @@ venc_data(){
     run tools/venc_data_dump${EXECSUF} ${file} ${stream} ${frames} ${threads} ${thread_type}
 }
 
+seek_print_cache(){
+    for size in 0 16777216; do
+        echo "cache size $size"
+        run tools/seek_print${EXECSUF} -m $size "$@"
+    done
+}
+
+max_memory_raises(){
+    ffmpeg -v verbose "$@" -f null - 2>&1 | awk '/raising it/ { n++ } END { print "memory limit raised " n + 0 " times" }'
+}
+
+loudnorm_measure(){
+    src=$1
+    for args in "1 0" "1 1" "4 1"; do
+        set -- $args
+        echo "filter_threads $1, measure_only $2"
+        ffmpeg -auto_conversion_filters -filter_threads $1 -f lavfi -i "$src" \
+            -af loudnorm=measure_only=$2:print_format=json -f null - 2>&1 | grep '"input_'
+    done
+}
+
+file_prefetch(){
+    src=$1
+    shift
+    for opts in "" "-prefetch 4 -prefetch_size 4096" "-prefetch 4 -prefetch_size 4096 -direct 1"; do
+        echo "${opts:-no prefetch}"
+        ffmpeg $opts "$@" -i file:$src -c copy -f md5 - 2>/dev/null
+    done
+}
+
+hls_serve(){
+    ffmpeg -v quiet -f data -i $1 -map 0 -c copy -f data -listen 1 -listen_timeout 10000 \
+        http://127.0.0.1:$2/$(basename $1)
+}
+
+hls_prefetch(){
+    src=$1
+    playlist=$outdir/$test.m3u8
+    port=$((20000 + $$ % 2000 * 16))
+    for prefetch in 0 2; do
+        echo "prefetch $prefetch"
+        n=0
+        while read -r line; do
+            case $line in
+            *.ts)
+                n=$((n + 1))
+                hls_serve $(dirname $src)/$line $((port + n)) &
+                echo "http://127.0.0.1:$((port + n))/$line" ;;
+            *)
+                echo "$line" ;;
+            esac
+        done < $src > $playlist
+        hls_serve $playlist $port &
+        sleep 1
+        ffmpeg -prefetch $prefetch -i http://127.0.0.1:$port/$(basename $playlist) \
+            -c copy -fflags +bitexact -f framecrc -
+        wait
+        port=$((port + n + 1))
+    done
+    rm -f $playlist
+}
+
 null(){
     :
 }
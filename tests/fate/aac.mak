@@ -166,6 +166,16 @@ fate-aac-aref-encode: CMP_TARGET = 596
 fate-aac-aref-encode: SIZE_TOLERANCE = 2464
 fate-aac-aref-encode: FUZZ = 89
 
+FATE_AAC_ENCODE += fate-aac-aref-encode-threads
+fate-aac-aref-encode-threads: ./tests/data/asynth-44100-4.wav
+fate-aac-aref-encode-threads: CMD = enc_dec_pcm adts wav s16le $(REF) -c:a aac -threads 4 -aac_coder fast -aac_is 0 -aac_pns 0 -aac_ms 0 -aac_tns 0 -b:a 1024k -fflags +bitexact -flags +bitexact
+fate-aac-aref-encode-threads: CMP = stddev
+fate-aac-aref-encode-threads: REF = ./tests/data/asynth-44100-4.wav
+fate-aac-aref-encode-threads: CMP_SHIFT = -8192
+fate-aac-aref-encode-threads: CMP_TARGET = 593
+fate-aac-aref-encode-threads: SIZE_TOLERANCE = 4928
+fate-aac-aref-encode-threads: FUZZ = 89
+
 FATE_AAC_ENCODE += fate-aac-ln-encode
 fate-aac-ln-encode: CMD = enc_dec_pcm adts wav s16le $(TARGET_SAMPLES)/audio-reference/luckynight_2ch_44kHz_s16.wav -c:a aac -aac_coder fast -aac_is 0 -aac_pns 0 -aac_ms 0 -aac_tns 0 -b:a 512k -fflags +bitexact -flags +bitexact
 fate-aac-ln-encode: CMP = stddev
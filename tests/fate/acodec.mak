@@ -129,10 +129,13 @@ fate-acodec-dca2: CMP_SHIFT = -2048
 fate-acodec-dca2: CMP_TARGET = 534
 fate-acodec-dca2: SIZE_TOLERANCE = 1632
 
-FATE_ACODEC-$(call ENCDEC, FLAC, FLAC) += fate-acodec-flac fate-acodec-flac-exact-rice
+FATE_ACODEC-$(call ENCDEC, FLAC, FLAC) += fate-acodec-flac fate-acodec-flac-exact-rice fate-acodec-flac-threads
 fate-acodec-flac: FMT = flac
 fate-acodec-flac: CODEC = flac -compression_level 2
 
+fate-acodec-flac-threads: FMT = flac
+fate-acodec-flac-threads: CODEC = flac -compression_level 2 -threads 4
+
 fate-acodec-flac-exact-rice: FMT = flac
 fate-acodec-flac-exact-rice: CODEC = flac -compression_level 2 -exact_rice_parameters 1
 
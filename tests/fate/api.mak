@@ -22,6 +22,10 @@ fate-lavf-flv: KEEP_FILES ?= 1
 fate-api-seek: CMD = run $(APITESTSDIR)/api-seek-test$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.flv 0 720
 fate-api-seek: CMP = null
 
+FATE_API_LIBAVFORMAT-$(call ALLYES, MOV_DEMUXER MOV_MUXER FILE_PROTOCOL) += $(if $(HAVE_MMAP),fate-api-mov-mmap)
+fate-api-mov-mmap: $(APITESTSDIR)/api-mov-mmap-test$(EXESUF)
+fate-api-mov-mmap: CMD = run $(APITESTSDIR)/api-mov-mmap-test$(EXESUF) $(TARGET_PATH)/tests/data/fate/api-mov-mmap.mov
+
 FATE_API-$(HAVE_THREADS) += fate-api-threadmessage
 fate-api-threadmessage: $(APITESTSDIR)/api-threadmessage-test$(EXESUF)
 fate-api-threadmessage: CMD = run $(APITESTSDIR)/api-threadmessage-test$(EXESUF) 3 10 30 50 2 20 40
@@ -16,6 +16,36 @@ fate-ffmpeg-filter_colorkey: CMD = framecrc -auto_conversion_filters -idct simpl
 FATE_FFMPEG-$(call FILTERFRAMECRC, COLOR) += fate-ffmpeg-lavfi
 fate-ffmpeg-lavfi: CMD = framecrc -lavfi color=d=1:r=5 -fflags +bitexact
 
+# slice-threaded filtering on the shared worker pool
+FATE_FFMPEG-$(call FILTERFRAMECRC, TESTSRC2 FORMAT AVGBLUR GBLUR UNSHARP) += fate-ffmpeg-pool_threads
+fate-ffmpeg-pool_threads: CMD = framecrc -pool_threads 3 -filter_complex "testsrc2=s=320x240:r=5:d=1,format=yuv420p,avgblur,gblur,unsharp" -fflags +bitexact
+
+# single-entry queues between all the components
+FATE_FFMPEG-$(call FILTERFRAMECRC, TESTSRC2 SCALE) += fate-ffmpeg-low_latency
+fate-ffmpeg-low_latency: CMD = framecrc -low_latency -filter_complex "testsrc2=s=320x240:r=5:d=1,scale=160:120:flags=bitexact,split[a][b]" -map "[a]" -map "[b]" -fflags +bitexact
+
+# single-entry queues with an input file, a decoder and an encoder
+FATE_FFMPEG-$(call FILTERDEMDEC, TESTSRC2, , WRAPPED_AVFRAME, LAVFI_INDEV MPEG4_ENCODER) += fate-ffmpeg-low_latency-input
+fate-ffmpeg-low_latency-input: CMD = framecrc -low_latency -f lavfi -i testsrc2=s=320x240:r=25:d=2 -c:v mpeg4 -qscale 10 -threads 1 -fflags +bitexact -flags +bitexact
+
+# a limit small enough for the sources to stall and raise it
+FATE_FFMPEG-$(call FILTERDEMDEC, TESTSRC2 PAD, , WRAPPED_AVFRAME, LAVFI_INDEV MPEG4_ENCODER) += fate-ffmpeg-max_memory
+fate-ffmpeg-max_memory: CMD = framecrc -max_memory 1M -f lavfi -i testsrc2=s=320x240:r=25:d=2 -vf pad=640:480 -c:v mpeg4 -qscale 10 -threads 1 -fflags +bitexact -flags +bitexact
+
+# a filter much slower than the source must not raise the limit
+FATE_FFMPEG-$(call FILTERDEMDEC, TESTSRC2 REALTIME, , WRAPPED_AVFRAME, LAVFI_INDEV NULL_MUXER) += fate-ffmpeg-max_memory-slow
+fate-ffmpeg-max_memory-slow: CMD = max_memory_raises -max_memory 400K -f lavfi -i testsrc2=s=320x240:r=25:d=0.4 -vf realtime=speed=0.25
+
+# demuxing, decoding, filtering and encoding with single-entry queues
+# The file size is not a multiple of the block size, so the last block is short
+FATE_FFMPEG-$(call DEMMUX, RAWVIDEO, MD5) += fate-ffmpeg-file-prefetch
+fate-ffmpeg-file-prefetch: tests/data/vsynth1.yuv
+fate-ffmpeg-file-prefetch: CMD = file_prefetch $(TARGET_PATH)/tests/data/vsynth1.yuv -f rawvideo -s 352x288 -pix_fmt yuv420p
+
+FATE_FFMPEG-$(call DEMDEC, RAWVIDEO, RAWVIDEO, MPEG4_ENCODER FRAMECRC_MUXER PIPE_PROTOCOL) += fate-ffmpeg-low_latency-decode
+fate-ffmpeg-low_latency-decode: tests/data/vsynth1.yuv
+fate-ffmpeg-low_latency-decode: CMD = framecrc -low_latency -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -frames:v 20 -c:v mpeg4 -qscale 10 -threads 1 -fflags +bitexact -flags +bitexact
+
 FATE_FFMPEG-$(call ENCDEC2, MPEG4, RAWVIDEO, AVI, RAWVIDEO_DEMUXER FRAMECRC_MUXER) += fate-force_key_frames
 fate-force_key_frames: tests/data/vsynth1.yuv
 fate-force_key_frames: CMD = enc_dec \
@@ -249,6 +279,14 @@ fate-ffmpeg-filter-in-eof: CMD = framecrc
     -filter_complex "[0][1]concat" -c:v rawvideo
 FATE_FFMPEG-$(call FRAMECRC, RAWVIDEO, RAWVIDEO, CONCAT_FILTER) += fate-ffmpeg-filter-in-eof
 
+# Test a decoder feeding several filtergraphs, one of which finishes early.
+fate-ffmpeg-dec-fanout: tests/data/vsynth1.yuv
+fate-ffmpeg-dec-fanout: CMD = framecrc                                                     \
+    -f rawvideo -s 352x288 -pix_fmt yuv420p -t 1 -i $(TARGET_PATH)/tests/data/vsynth1.yuv  \
+    -map 0:v -map 0:v -map 0:v -filter:v:0 hflip -filter:v:1 vflip -frames:v:2 5          \
+    -c:v rawvideo
+FATE_FFMPEG-$(call FRAMECRC, RAWVIDEO, RAWVIDEO, HFLIP_FILTER VFLIP_FILTER) += fate-ffmpeg-dec-fanout
+
 # Test termination on streamcopy with -t as an output option.
 fate-ffmpeg-streamcopy-t: tests/data/vsynth1.yuv
 fate-ffmpeg-streamcopy-t: CMP = null
@@ -425,6 +425,12 @@ fate-filter-crazychannels: tests/data/filtergraphs/crazychannels
 fate-filter-crazychannels: CMD = framecrc -auto_conversion_filters -/filter_complex $(TARGET_PATH)/tests/data/filtergraphs/crazychannels
 FATE_AFILTER-$(call FILTERFRAMECRC, ARESAMPLE SINE JOIN ATRIM CHANNELMAP CHANNELSPLIT) += fate-filter-crazychannels
 
+# the input measurement must be the same with and without measure_only,
+# and with several threads
+FATE_AFILTER-$(call ALLYES, LAVFI_INDEV AEVALSRC_FILTER LOUDNORM_FILTER ARESAMPLE_FILTER NULL_MUXER) += fate-filter-loudnorm-measure
+fate-filter-loudnorm-measure: SRC = aevalsrc=0.1*sin(2*PI*(200+100*sin(t/3))*t)*(1+0.5*sin(t))|0.2*sin(2*PI*300*t)*between(mod(t\,10)\,2\,7):s=48000:d=45
+fate-filter-loudnorm-measure: CMD = loudnorm_measure "$(SRC)"
+
 FATE_AFILTER-yes += fate-filter-formats
 fate-filter-formats: libavfilter/tests/formats$(EXESUF)
 fate-filter-formats: CMD = run libavfilter/tests/formats$(EXESUF)
@@ -109,6 +109,20 @@ FATE_HLSENC_PROBE-$(call ALLYES, HLS_DEMUXER EAC3_DEMUXER) += fate-hls-fmp4_ac3
 fate-hls-fmp4_ac3: tests/data/hls_fmp4_ac3.m3u8
 fate-hls-fmp4_ac3: CMD = probeaudiostream $(TARGET_PATH)/tests/data/now_ac3.mp4
 
+tests/data/hls_prefetch.m3u8: TAG = GEN
+tests/data/hls_prefetch.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=5" -f hls -hls_time 1 -map 0 \
+        -hls_list_size 0 -codec:a mp2fixed -hls_segment_filename $(TARGET_PATH)/tests/data/hls_prefetch_%d.ts \
+        $(TARGET_PATH)/tests/data/hls_prefetch.m3u8 2>/dev/null
+
+# Serve the playlist and every segment with a separate -listen 1 HTTP server
+# and compare the packets read with and without prefetching.
+FATE_FFMPEG-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER \
+                           DATA_DEMUXER DATA_MUXER FRAMECRC_MUXER HTTP_PROTOCOL) += fate-hls-prefetch
+fate-hls-prefetch: tests/data/hls_prefetch.m3u8
+fate-hls-prefetch: CMD = hls_prefetch $(TARGET_PATH)/tests/data/hls_prefetch.m3u8
+
 FATE_SAMPLES_FFMPEG += $(FATE_HLSENC-yes)
 FATE_SAMPLES_FFMPEG_FFPROBE += $(FATE_HLSENC_PROBE-yes)
 fate-hlsenc: $(FATE_HLSENC-yes) $(FATE_HLSENC_PROBE-yes)
@@ -6,6 +6,10 @@ FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/tests/noproxy$(EXESUF)
 fate-noproxy: CMD = run libavformat/tests/noproxy$(EXESUF)
 
+FATE_LIBAVFORMAT-$(call ALLYES, HTTP_PROTOCOL TCP_PROTOCOL) += fate-httppool
+fate-httppool: libavformat/tests/httppool$(EXESUF)
+fate-httppool: CMD = run libavformat/tests/httppool$(EXESUF)
+
 FATE_LIBAVFORMAT-$(CONFIG_FFRTMPCRYPT_PROTOCOL) += fate-rtmpdh
 fate-rtmpdh: libavformat/tests/rtmpdh$(EXESUF)
 fate-rtmpdh: CMD = run libavformat/tests/rtmpdh$(EXESUF)
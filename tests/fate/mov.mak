@@ -219,6 +219,12 @@ FATE_MOV_FFMPEG-$(call TRANSCODE, PCM_S16LE, MOV, WAV_DEMUXER PAN_FILTER) \
 fate-mov-mp4-pcm-float: tests/data/asynth-44100-1.wav
 fate-mov-mp4-pcm-float: CMD = transcode wav $(TARGET_PATH)/tests/data/asynth-44100-1.wav mp4 "-af aresample,pan=FR+FL+FR|c0=c0|c1=c0|c2=c0 -c:a pcm_f32le" "-map 0 -c copy -frames:a 0"
 
+# Test stream copy from a memory-mapped file
+FATE_MOV_FFMPEG-$(call TRANSCODE, RAWVIDEO, MOV, RAWVIDEO_DEMUXER FILE_PROTOCOL) \
+                          += fate-mov-mmap-remux
+fate-mov-mmap-remux: tests/data/vsynth1.yuv
+fate-mov-mmap-remux: CMD = transcode rawvideo $(TARGET_PATH)/tests/data/vsynth1.yuv mov "-c:v rawvideo -frames:v 10" "-map 0 -c copy" "" "" "-mmap 1" "-s 352x288 -pix_fmt uyvy422"
+
 fate-mov-pcm-remux: tests/data/asynth-44100-1.wav
 fate-mov-pcm-remux: CMD = md5 -i $(TARGET_PATH)/tests/data/asynth-44100-1.wav -map 0 -c copy -fflags +bitexact -f mp4
 fate-mov-pcm-remux: CMP = oneline
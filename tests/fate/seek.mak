@@ -208,3 +208,18 @@ fate-seek-%: REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%=%)
 FATE_AVCONV += $(FATE_SEEK)
 FATE_SAMPLES_AVCONV += $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
 fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
+
+tests/data/seek_print.mov: TAG = GEN
+tests/data/seek_print.mov: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin -f lavfi -i testsrc=s=64x48:r=25:d=2 \
+        -c:v qtrle -g 12 -video_track_timescale 25 -fflags +bitexact -y $(TARGET_PATH)/$@ 2>/dev/null
+
+# Seek back and forth within and across GOPs, without and with the GOP cache
+# of seek_print: the frames must be the same.
+FATE_SEEK_PRINT-$(call ALLYES, MOV_MUXER MOV_DEMUXER QTRLE_ENCODER QTRLE_DECODER \
+                               TESTSRC_FILTER LAVFI_INDEV FILE_PROTOCOL) += fate-seek-print-cache
+fate-seek-print-cache: tests/data/seek_print.mov tools/seek_print$(EXESUF)
+fate-seek-print-cache: CMD = seek_print_cache $(TARGET_PATH)/tests/data/seek_print.mov \
+    frame:0:20 frame:0:15 frame:0:13 frame:0:5 frame:0:20 frame:0:49 frame:0:0 frame:0:14
+
+FATE_FFMPEG += $(FATE_SEEK_PRINT-yes)
@@ -349,6 +349,14 @@ fate-vsynth%-msrle:              CODEC   = msrle
 FATE_VCODEC_SCALE-$(call ENCDEC, PNG, AVI) += mpng
 fate-vsynth%-mpng:               CODEC   = png
 
+FATE_FFMPEG-$(call ENCDEC2, PNG, RAWVIDEO, AVI, RAWVIDEO_DEMUXER FRAMECRC_MUXER SCALE_FILTER) += fate-png-slice-threads
+fate-png-slice-threads: tests/data/vsynth1.yuv
+fate-png-slice-threads: CMD = enc_dec \
+  "rawvideo -s 352x288 -pix_fmt yuv420p" tests/data/vsynth1.yuv \
+  avi "-c png -thread_type slice -threads 4" \
+  rawvideo "-pix_fmt yuv420p -color_range mpeg" "-thread_type slice -threads 4"
+fate-png-slice-threads: CMP_UNIT = 1
+
 FATE_VCODEC_SCALE-$(call ENCDEC, MSVIDEO1, AVI) += msvideo1
 
 FATE_VCODEC_SCALE-$(call ENCDEC, PRORES, MOV) += prores prores_int prores_444 prores_444_int prores_ks
@@ -0,0 +1,280 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* cache of decoded GOPs for tools seeking repeatedly in the same file */
+
+#include <string.h>
+
+#include "frame_cache.h"
+
+#include "libavformat/avformat.h"
+
+#include "libavcodec/avcodec.h"
+
+#include "libavutil/error.h"
+#include "libavutil/frame.h"
+#include "libavutil/mem.h"
+
+/**
+ * Decoded frames from a key frame up to the last frame that was needed.
+ * Frames are in presentation order, as output by the decoder.
+ */
+typedef struct CachedGOP {
+    int stream;
+    int64_t start_pts;
+    int64_t end_pts;
+    AVFrame **frames;
+    int nb_frames;
+    size_t size;
+    unsigned last_use;
+} CachedGOP;
+
+static size_t frame_size(const AVFrame *frame)
+{
+    size_t size = 0;
+    for (int i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
+        size += frame->buf[i]->size;
+    return size;
+}
+
+static void gop_free(CachedGOP *gop)
+{
+    for (int i = 0; i < gop->nb_frames; i++)
+        av_frame_free(&gop->frames[i]);
+    av_freep(&gop->frames);
+    gop->nb_frames = 0;
+    gop->size = 0;
+}
+
+static int gop_add_frame(CachedGOP *gop, const AVFrame *frame)
+{
+    AVFrame **frames;
+    AVFrame *ref = av_frame_clone(frame);
+    if (!ref)
+        return AVERROR(ENOMEM);
+    frames = av_realloc_array(gop->frames, gop->nb_frames + 1, sizeof(*frames));
+    if (!frames) {
+        av_frame_free(&ref);
+        return AVERROR(ENOMEM);
+    }
+    gop->frames = frames;
+    gop->frames[gop->nb_frames++] = ref;
+    gop->end_pts = frame->pts;
+    gop->size += frame_size(frame);
+    return 0;
+}
+
+static void cache_remove(FrameCache *fc, int idx)
+{
+    fc->size -= fc->gops[idx].size;
+    gop_free(&fc->gops[idx]);
+    fc->gops[idx] = fc->gops[--fc->nb_gops];
+}
+
+/* Takes ownership of the frames of gop. */
+static int cache_insert(FrameCache *fc, CachedGOP *gop)
+{
+    CachedGOP *gops;
+
+    if (!gop->nb_frames)
+        return 0;
+    if (gop->size > fc->max_size) {
+        gop_free(gop);
+        return 0;
+    }
+    for (int i = fc->nb_gops - 1; i >= 0; i--)
+        if (fc->gops[i].stream == gop->stream &&
+            fc->gops[i].start_pts == gop->start_pts)
+            cache_remove(fc, i);
+    while (fc->nb_gops && fc->size + gop->size > fc->max_size) {
+        int lru = 0;
+        for (int i = 1; i < fc->nb_gops; i++)
+            if (fc->gops[i].last_use < fc->gops[lru].last_use)
+                lru = i;
+        cache_remove(fc, lru);
+    }
+
+    gops = av_realloc_array(fc->gops, fc->nb_gops + 1, sizeof(*gops));
+    if (!gops) {
+        gop_free(gop);
+        return AVERROR(ENOMEM);
+    }
+    fc->gops = gops;
+    gop->last_use = ++fc->clock;
+    fc->gops[fc->nb_gops++] = *gop;
+    fc->size += gop->size;
+    return 0;
+}
+
+/* Return the last frame with pts <= ts from the cache, if it is known. */
+static const AVFrame *cache_lookup(FrameCache *fc, int stream, int64_t ts)
+{
+    for (int i = 0; i < fc->nb_gops; i++) {
+        CachedGOP *gop = &fc->gops[i];
+        const AVFrame *found = NULL;
+
+        if (gop->stream != stream || ts < gop->start_pts || ts > gop->end_pts)
+            continue;
+        for (int j = 0; j < gop->nb_frames; j++)
+            if (gop->frames[j]->pts <= ts &&
+                (!found || gop->frames[j]->pts > found->pts))
+                found = gop->frames[j];
+        if (!found)
+            continue;
+        gop->last_use = ++fc->clock;
+        return found;
+    }
+    return NULL;
+}
+
+static int open_decoder(FrameCache *fc, int stream)
+{
+    AVStream *st = fc->demuxer->streams[stream];
+    const AVCodec *codec;
+    int ret;
+
+    if (fc->dec[stream])
+        return 0;
+    codec = avcodec_find_decoder(st->codecpar->codec_id);
+    if (!codec)
+        return AVERROR_DECODER_NOT_FOUND;
+    fc->dec[stream] = avcodec_alloc_context3(codec);
+    if (!fc->dec[stream])
+        return AVERROR(ENOMEM);
+    ret = avcodec_parameters_to_context(fc->dec[stream], st->codecpar);
+    if (ret < 0)
+        return ret;
+    fc->dec[stream]->pkt_timebase = st->time_base;
+    return avcodec_open2(fc->dec[stream], codec, NULL);
+}
+
+int fc_get_frame(FrameCache *fc, int stream, int64_t ts, AVFrame *out, int *cached)
+{
+    AVCodecContext *dec;
+    CachedGOP gop = { .stream = stream };
+    int found = 0, eof = 0, first = 1, ret;
+    const AVFrame *hit;
+
+    if (stream < 0 || stream >= fc->demuxer->nb_streams)
+        return AVERROR(EINVAL);
+
+    if ((hit = cache_lookup(fc, stream, ts))) {
+        fc->hits++;
+        *cached = 1;
+        return av_frame_ref(out, hit);
+    }
+    fc->misses++;
+    *cached = 0;
+
+    if ((ret = open_decoder(fc, stream)) < 0)
+        return ret;
+    dec = fc->dec[stream];
+
+    ret = avformat_seek_file(fc->demuxer, stream, INT64_MIN, ts, ts, 0);
+    if (ret < 0)
+        return ret;
+    avcodec_flush_buffers(dec);
+
+    while (!found) {
+        if (!eof) {
+            ret = av_read_frame(fc->demuxer, fc->pkt);
+            if (ret == AVERROR_EOF) {
+                eof = 1;
+                ret = avcodec_send_packet(dec, NULL);
+            } else if (ret >= 0) {
+                if (fc->pkt->stream_index == stream)
+                    ret = avcodec_send_packet(dec, fc->pkt);
+                av_packet_unref(fc->pkt);
+            }
+            if (ret < 0)
+                break;
+        }
+
+        while (!found) {
+            ret = avcodec_receive_frame(dec, fc->frame);
+            if (ret == AVERROR(EAGAIN) && !eof)
+                break;
+            if (ret == AVERROR_EOF) {
+                found = 1;
+                break;
+            }
+            if (ret < 0)
+                goto end;
+            fc->decoded++;
+            fc->frame->pts = fc->frame->best_effort_timestamp;
+
+            /* Not every decoder flags its key frames, but the first frame
+             * after the seek is one. */
+            if (first || fc->frame->flags & AV_FRAME_FLAG_KEY) {
+                if ((ret = cache_insert(fc, &gop)) < 0)
+                    goto end;
+                gop = (CachedGOP){ .stream = stream, .start_pts = fc->frame->pts };
+                first = 0;
+            }
+            if (fc->max_size && (ret = gop_add_frame(&gop, fc->frame)) < 0)
+                goto end;
+
+            /* The frame shown at ts is only known once the next one is. */
+            if (fc->frame->pts > ts && out->buf[0]) {
+                found = 1;
+            } else {
+                av_frame_unref(out);
+                av_frame_move_ref(out, fc->frame);
+            }
+            av_frame_unref(fc->frame);
+        }
+    }
+    ret = found && out->buf[0] ? 0 : ret < 0 ? ret : AVERROR_EOF;
+
+end:
+    if (ret >= 0)
+        ret = cache_insert(fc, &gop);
+    else
+        gop_free(&gop);
+    return ret;
+}
+
+int fc_init(FrameCache *fc, AVFormatContext *demuxer, size_t max_size)
+{
+    memset(fc, 0, sizeof(*fc));
+    fc->demuxer  = demuxer;
+    fc->max_size = max_size;
+
+    fc->dec   = av_calloc(demuxer->nb_streams, sizeof(*fc->dec));
+    fc->pkt   = av_packet_alloc();
+    fc->frame = av_frame_alloc();
+    if (!fc->dec || !fc->pkt || !fc->frame) {
+        fc_uninit(fc);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+void fc_uninit(FrameCache *fc)
+{
+    while (fc->nb_gops)
+        cache_remove(fc, fc->nb_gops - 1);
+    av_freep(&fc->gops);
+    if (fc->dec) {
+        for (int i = 0; i < fc->demuxer->nb_streams; i++)
+            avcodec_free_context(&fc->dec[i]);
+        av_freep(&fc->dec);
+    }
+    av_packet_free(&fc->pkt);
+    av_frame_free(&fc->frame);
+}
@@ -0,0 +1,64 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* cache of decoded GOPs for tools seeking repeatedly in the same file */
+
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libavformat/avformat.h"
+
+#include "libavcodec/avcodec.h"
+#include "libavcodec/packet.h"
+
+#include "libavutil/frame.h"
+
+struct CachedGOP;
+
+typedef struct FrameCache {
+    AVFormatContext *demuxer;
+    /* decoded frames kept at most, in bytes; 0 disables the cache */
+    size_t           max_size;
+
+    size_t           size;
+    uint64_t         hits, misses, decoded;
+
+    AVCodecContext **dec;
+    AVPacket        *pkt;
+    AVFrame         *frame;
+    struct CachedGOP *gops;
+    int              nb_gops;
+    unsigned         clock;
+} FrameCache;
+
+int fc_init(FrameCache *fc, AVFormatContext *demuxer, size_t max_size);
+void fc_uninit(FrameCache *fc);
+
+/**
+ * Get the frame shown at ts in stream, from the cache or by seeking to the
+ * previous key frame and decoding from there. The decoded GOPs are added to
+ * the cache.
+ *
+ * @param cached set to 1 if the frame was taken from the cache
+ */
+int fc_get_frame(FrameCache *fc, int stream, int64_t ts, AVFrame *out, int *cached);
+
+#endif /* FRAME_CACHE_H */
@@ -23,7 +23,16 @@
 #include <unistd.h>             /* getopt */
 #endif
 
+#include "frame_cache.h"
+
+#include "libavcodec/avcodec.h"
 #include "libavformat/avformat.h"
+#include "libavutil/adler32.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
 #include "libavutil/timestamp.h"
 
 #if !HAVE_GETOPT
@@ -33,24 +42,54 @@
 static void usage(int ret)
 {
     fprintf(ret ? stderr : stdout,
-            "Usage: seek_print file [command ...]\n"
+            "Usage: seek_print [-m cache_size] file [command ...]\n"
+            "Options:\n"
+            "    -m    decoded frame cache size in bytes (0 = disabled)\n"
             "Commands:\n"
             "    read\n"
             "    seek:stream:min_ts:ts:max_ts:flags\n"
+            "    frame:stream:ts\n"
+            "        decode the frame shown at ts\n"
+            "    bench:stream:min_ts:max_ts:count\n"
+            "        decode count frames at random timestamps in the range\n"
+            "        and print the cache statistics\n"
             );
     exit(ret);
 }
 
+static uint32_t frame_checksum(const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    uint32_t crc = 0;
+
+    if (!frame->width || !desc)
+        return 0;
+    for (int p = 0; p < 4 && frame->data[p]; p++) {
+        int h = p == 1 || p == 2 ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h)
+                                 : frame->height;
+        int w = av_image_get_linesize(frame->format, frame->width, p);
+        for (int y = 0; y < h; y++)
+            crc = av_adler32_update(crc, frame->data[p] + y * frame->linesize[p], w);
+    }
+    return crc;
+}
+
 int main(int argc, char **argv)
 {
-    int opt, ret, stream, flags;
+    int opt, ret, stream, flags, count;
     const char *filename;
     AVFormatContext *avf = NULL;
     int64_t min_ts, max_ts, ts;
     AVPacket packet;
+    size_t cache_size = 0;
+    FrameCache fc;
+    AVFrame *frame;
 
-    while ((opt = getopt(argc, argv, "h")) != -1) {
+    while ((opt = getopt(argc, argv, "hm:")) != -1) {
         switch (opt) {
+        case 'm':
+            cache_size = strtoull(optarg, NULL, 0);
+            break;
         case 'h':
             usage(0);
         default:
@@ -75,6 +114,12 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    frame = av_frame_alloc();
+    if (!frame || (ret = fc_init(&fc, avf, cache_size)) < 0) {
+        fprintf(stderr, "%s\n", av_err2str(frame ? ret : AVERROR(ENOMEM)));
+        return 1;
+    }
+
     for (; argc; argc--, argv++) {
         if (!strcmp(*argv, "read")) {
             ret = av_read_frame(avf, &packet);
@@ -92,12 +137,50 @@ int main(int argc, char **argv)
                    &stream, &min_ts, &ts, &max_ts, &flags) == 5) {
             ret = avformat_seek_file(avf, stream, min_ts, ts, max_ts, flags);
             printf("seek: %d (%s)\n", ret, av_err2str(ret));
+        } else if (sscanf(*argv, "frame:%i:%"SCNi64, &stream, &ts) == 2) {
+            int cached;
+            ret = fc_get_frame(&fc, stream, ts, frame, &cached);
+            if (ret < 0) {
+                printf("frame: %d (%s)\n", ret, av_err2str(ret));
+            } else {
+                AVRational *tb = &avf->streams[stream]->time_base;
+                printf("frame: %d stream=%d ts=%s pts=%s (%s) cached=%d checksum=0x%08"PRIx32"\n",
+                       ret, stream, av_ts2str(ts),
+                       av_ts2str(frame->pts), av_ts2timestr(frame->pts, tb),
+                       cached, frame_checksum(frame));
+            }
+            av_frame_unref(frame);
+        } else if (sscanf(*argv, "bench:%i:%"SCNi64":%"SCNi64":%i",
+                          &stream, &min_ts, &max_ts, &count) == 4) {
+            uint64_t hits = fc.hits, misses = fc.misses, decoded = fc.decoded;
+            int64_t start = av_gettime_relative();
+            AVLFG lfg;
+            int cached;
+
+            av_lfg_init(&lfg, 0x5eec);
+            ret = 0;
+            for (int i = 0; i < count && ret >= 0; i++) {
+                ts = min_ts + av_lfg_get(&lfg) % (uint64_t)(max_ts - min_ts + 1);
+                ret = fc_get_frame(&fc, stream, ts, frame, &cached);
+                av_frame_unref(frame);
+            }
+            hits    = fc.hits    - hits;
+            misses  = fc.misses  - misses;
+            decoded = fc.decoded - decoded;
+            printf("bench: %d (%s) lookups=%"PRIu64" hits=%"PRIu64" (%.1f%%) "
+                   "decoded=%"PRIu64" cache=%zu time=%.3fs\n",
+                   ret, av_err2str(ret), hits + misses, hits,
+                   hits + misses ? 100.0 * hits / (hits + misses) : 0.0,
+                   decoded, fc.size,
+                   (av_gettime_relative() - start) / 1000000.0);
         } else {
             fprintf(stderr, "'%s': unknown command\n", *argv);
             return 1;
         }
     }
 
+    av_frame_free(&frame);
+    fc_uninit(&fc);
     avformat_close_input(&avf);
 
     return 0;